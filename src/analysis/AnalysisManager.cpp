@@ -4,8 +4,10 @@
 #include "DomainTemplates.h"
 #include "../ui/OccView.h"
 #include "../ui/AnalysisLegendOverlay.h"
+#include "../cad/PartRegistry.h"
 
 #include <BRepPrimAPI_MakeBox.hxx>
+#include <algorithm>
 
 AnalysisManager::AnalysisManager()
     : m_backend(std::make_unique<BackendFEA_CalculiX>()) {}
@@ -13,9 +15,33 @@ AnalysisManager::AnalysisManager()
 void AnalysisManager::setModel(const TopoDS_Shape &shape, const QString &partId) {
     m_shape = shape;
     m_partId = partId;
+    m_partsGeneration = 0;
     m_backend->setModel(shape);
 }
 
+bool AnalysisManager::setModel(const PartRegistry &registry, const QString &partId) {
+    const PartRegistry::Entry *entry = registry.find(partId);
+    if (!entry) return false;
+    setModel(entry->shape.get(), partId);
+    m_partsGeneration = registry.generation();
+    return true;
+}
+
+void AnalysisManager::syncParts(const PartRegistry &registry) {
+    if (m_partsGeneration == 0) return;
+    const PartRegistry::Changes changes = registry.changesSince(m_partsGeneration);
+    m_partsGeneration = changes.generation;
+    if (std::find(changes.changed.begin(), changes.changed.end(), m_partId) != changes.changed.end()) {
+        const std::uint64_t generation = m_partsGeneration;
+        setModel(registry.find(m_partId)->shape.get(), m_partId);
+        m_partsGeneration = generation;
+        m_resultStale = true;
+    } else if (std::find(changes.removed.begin(), changes.removed.end(), m_partId) != changes.removed.end()) {
+        setModel(TopoDS_Shape(), m_partId);
+        m_resultStale = true;
+    }
+}
+
 void AnalysisManager::setAnalysisCase(const AnalysisCase &analysisCase) {
     m_case = analysisCase;
     m_backend->setCase(analysisCase);
@@ -41,6 +67,7 @@ AnalysisManager::Result AnalysisManager::runCase() {
     r.minTemperature = backendResult.minTemperature;
     r.maxTemperature = backendResult.maxTemperature;
     m_lastResult = r;
+    m_resultStale = false;
     return r;
 }
 
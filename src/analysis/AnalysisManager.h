@@ -5,9 +5,11 @@
 
 #include <TopoDS_Shape.hxx>
 #include <QString>
+#include <cstdint>
 #include <memory>
 
 class BackendFEA_CalculiX;
+class PartRegistry;
 class OccView;
 class AnalysisLegendOverlay;
 
@@ -24,6 +26,11 @@ public:
 
     AnalysisManager();
     void setModel(const TopoDS_Shape &shape, const QString &partId = QStringLiteral("active"));
+    // Binds the model to a registry part, so syncParts() can follow later edits to it.
+    bool setModel(const PartRegistry &registry, const QString &partId);
+    // Reloads a registry-bound model whose part changed; the last result then becomes stale.
+    void syncParts(const PartRegistry &registry);
+    bool resultStale() const { return m_resultStale; }
     void setAnalysisCase(const AnalysisCase &analysisCase);
     void attachView(OccView *view, AnalysisLegendOverlay *legend = nullptr);
 
@@ -41,5 +48,7 @@ private:
     OccView *m_view{nullptr};
     AnalysisLegendOverlay *m_legend{nullptr};
     Result m_lastResult;
+    bool m_resultStale{false};
+    std::uint64_t m_partsGeneration{0};  // 0 while the model is not bound to a registry
 };
 
@@ -1,12 +1,16 @@
 #include "DomainTemplates.h"
+#include "../cad/TessellationService.h"
 
 #include <TopExp_Explorer.hxx>
 #include <TopAbs.hxx>
+#include <TopoDS.hxx>
 #include <BRepPrimAPI_MakeBox.hxx>
 #include <BRepBndLib.hxx>
+#include <BRep_Tool.hxx>
 #include <Bnd_Box.hxx>
+#include <Poly_Triangulation.hxx>
 #include <gp_Vec.hxx>
-#include <algorithm>
+#include <cmath>
 
 AnalysisCase DomainTemplates::defaultCase(DomainTemplateKind kind, const TopoDS_Shape &shape) const {
     AnalysisCase c;
@@ -64,11 +68,21 @@ int DomainTemplates::generateCoarseMesh(const TopoDS_Shape &shape) {
     if (shape.IsNull()) {
         return 0;
     }
-    int faces = 0;
-    for (TopExp_Explorer exp(shape, TopAbs_FACE); exp.More(); exp.Next()) {
-        ++faces;
+    // Coarse surface mesh, shared through the tessellation cache with the viewers.
+    Bnd_Box box;
+    BRepBndLib::Add(shape, box);
+    const double diagonal = box.IsVoid() ? 1.0 : std::sqrt(box.SquareExtent());
+    const TopoDS_Shape meshed = TessellationService::instance().tessellate(shape, {diagonal * 0.02, 0.5, false});
+    if (meshed.IsNull()) {
+        return 0;
+    }
+    int triangles = 0;
+    for (TopExp_Explorer exp(meshed, TopAbs_FACE); exp.More(); exp.Next()) {
+        TopLoc_Location location;
+        const Handle(Poly_Triangulation) mesh = BRep_Tool::Triangulation(TopoDS::Face(exp.Current()), location);
+        triangles += mesh.IsNull() ? 0 : mesh->NbTriangles();
     }
-    return std::max(32, faces * 32);
+    return triangles;
 }
 
 AnalysisCase DomainTemplates::cubeCompressionCase(TopoDS_Shape &shape) const {
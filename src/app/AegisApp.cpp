@@ -1,5 +1,8 @@
 #include "AegisApp.h"
+#include "../cad/FeatureOps.h"
+#include "../cad/ShapeCache.h"
 #include "../ui/ModernStyle.h"
+#include "../utils/Settings.h"
 #include <QFont>
 #include <QIcon>
 
@@ -13,6 +16,15 @@ AegisApp::AegisApp(int &argc, char **argv) : QApplication(argc, argv) {
     m_style = std::make_unique<ModernStyle>();
     m_style->applyTo(*this);
     setupPalette();
+
+    const Settings settings;
+    FeatureOps::setExecutionPolicy(FeatureOps::loadExecutionPolicy(settings));
+    const QString cacheMegabytes = QString::fromStdString(settings.value("shapeCache/capacityMB"));
+    bool ok = false;
+    const qulonglong megabytes = cacheMegabytes.toULongLong(&ok);
+    if (ok) {
+        ShapeCache::instance().setCapacity(static_cast<std::size_t>(megabytes) * 1024 * 1024);
+    }
 }
 
 AegisApp::~AegisApp() = default;
@@ -9,6 +9,8 @@
 #include "../ui/PythonConsoleDock.h"
 #include "../ui/LogConsoleDock.h"
 #include "../cad/StepIgesIO.h"
+#include "../cad/BatchImporter.h"
+#include "../assembly/AssemblyDocument.h"
 #include "../cad/GltfExporter.h"
 #include "../cad/PartRegistry.h"
 #include "../analysis/AnalysisManager.h"
@@ -21,6 +23,9 @@
 #include <QToolBar>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QEventLoop>
+#include <QFutureWatcher>
+#include <QProgressDialog>
 #include <QMessageBox>
 #include <QStatusBar>
 #include <QDockWidget>
@@ -111,6 +116,11 @@ void MainWindow::setupToolbar() {
 }
 
 void MainWindow::setupMenus() {
+    auto *importMenu = menuBar()->addMenu(tr("Import"));
+    importMenu->addAction(tr("STEP/IGES..."), this, &MainWindow::openStepFile);
+    m_healImports = importMenu->addAction(tr("Heal imported geometry"));
+    m_healImports->setCheckable(true);
+
     auto *analysisMenu = menuBar()->addMenu(tr("Analysis"));
     analysisMenu->addAction(tr("Submit CalculiX job"), this, &MainWindow::submitCalculixJob);
 
@@ -122,21 +132,81 @@ void MainWindow::setupMenus() {
 }
 
 void MainWindow::openStepFile() {
-    const QString file = QFileDialog::getOpenFileName(this, tr("Open STEP/IGES"), QString(), tr("STEP/IGES (*.stp *.step *.igs *.iges)"));
-    if (file.isEmpty()) return;
-
-    Logging::info(tr("Importing geometry from %1").arg(QFileInfo(file).fileName()));
-    auto shape = m_io->importFile(file);
-    if (shape.IsNull()) {
-        QMessageBox::warning(this, tr("Import failed"), tr("No geometry could be loaded."));
-        Logging::error(tr("Import failed for %1").arg(file));
+    const QStringList files = QFileDialog::getOpenFileNames(this, tr("Open STEP/IGES"), QString(), tr("STEP/IGES (*.stp *.step *.igs *.iges)"));
+    if (files.isEmpty()) return;
+    // Healing needs whole files, so it goes through the batch importer even for one file.
+    if (files.size() > 1 || m_healImports->isChecked()) {
+        importFiles(files);
         return;
     }
+    streamFile(files.first());
+}
 
-    m_partRegistry->addPart(file, shape);
-    m_view->displayShape(shape);
-    statusBar()->showMessage(tr("Loaded %1").arg(QFileInfo(file).fileName()), 3000);
-    Logging::info(tr("Loaded geometry: %1").arg(QFileInfo(file).fileName()));
+void MainWindow::streamFile(const QString &file) {
+    const QString fileName = QFileInfo(file).fileName();
+    Logging::info(tr("Importing geometry from %1").arg(fileName));
+    // Roots are added to the registry as the worker finishes them, so the viewer fills in
+    // while the rest of the model is still being transferred.
+    auto *watcher = new QFutureWatcher<StepIgesIO::ImportedRoot>(this);
+    connect(watcher, &QFutureWatcherBase::resultReadyAt, this, [this, watcher, fileName](int index) {
+        const StepIgesIO::ImportedRoot root = watcher->resultAt(index);
+        m_partRegistry->addPart(root.name, root.shape);
+        syncParts();
+        statusBar()->showMessage(tr("Loading %1: %2 of %3").arg(fileName).arg(root.index + 1).arg(root.count));
+    });
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, file, fileName]() {
+        watcher->deleteLater();
+        if (watcher->future().resultCount() == 0) {
+            QMessageBox::warning(this, tr("Import failed"), tr("No geometry could be loaded."));
+            Logging::error(tr("Import failed for %1").arg(file));
+            return;
+        }
+        statusBar()->showMessage(tr("Loaded %1").arg(fileName), 3000);
+        Logging::info(tr("Loaded geometry: %1").arg(fileName));
+    });
+    watcher->setFuture(m_io->importStreaming(file));
+}
+
+void MainWindow::importFiles(const QStringList &files) {
+    Logging::info(tr("Importing %1 files").arg(files.size()));
+    BatchImporter importer;
+    if (m_healImports->isChecked()) {
+        importer.setHealing(ShapeHealing::Options());
+    }
+    QProgressDialog dialog(tr("Importing geometry..."), tr("Cancel"), 0, files.size(), this);
+    dialog.setWindowModality(Qt::WindowModal);
+    dialog.setMinimumDuration(0);
+
+    std::vector<std::pair<QString, TopoDS_Shape>> imported;
+    int failed = 0;
+    QFutureWatcher<BatchImporter::Result> watcher;
+    QEventLoop loop;
+    connect(&watcher, &QFutureWatcherBase::progressValueChanged, &dialog, &QProgressDialog::setValue);
+    connect(&watcher, &QFutureWatcherBase::resultReadyAt, this, [&](int index) {
+        const BatchImporter::Result result = watcher.resultAt(index);
+        if (result.ok) {
+            imported.emplace_back(result.path, result.shape);
+            if (result.healing.pieces > 0) {
+                Logging::info(result.healing.summary());
+            }
+        } else if (!dialog.wasCanceled()) {
+            ++failed;
+            Logging::error(tr("Import failed for %1").arg(result.path));
+        }
+    });
+    connect(&watcher, &QFutureWatcherBase::finished, &loop, &QEventLoop::quit);
+    connect(&dialog, &QProgressDialog::canceled, this, [&importer]() { importer.cancel(); });
+    watcher.setFuture(importer.start(files));
+    loop.exec();
+
+    if (!imported.empty()) {
+        m_partRegistry->addParts(imported);
+        syncParts();
+    }
+    statusBar()->showMessage(tr("Loaded %1 of %2 files").arg(imported.size()).arg(files.size()), 3000);
+    if (failed > 0) {
+        QMessageBox::warning(this, tr("Import failed"), tr("%1 file(s) could not be loaded.").arg(failed));
+    }
 }
 
 void MainWindow::exportStepFile() {
@@ -144,14 +214,30 @@ void MainWindow::exportStepFile() {
     if (file.isEmpty()) return;
 
     Logging::info(tr("Exporting STEP to %1").arg(QFileInfo(file).fileName()));
-    auto shape = m_partRegistry->activeShape();
-    if (shape.IsNull()) {
-        QMessageBox::warning(this, tr("Nothing to export"), tr("No geometry in the workspace."));
-        Logging::warn(tr("Export aborted: no active shape"));
-        return;
+    bool ok = false;
+    if (m_partRegistry->parts().size() > 1) {
+        // Multi-part workspaces go out as one product per part, carrying registry materials.
+        AssemblyDocument assembly;
+        for (const auto &entry : m_partRegistry->parts()) {
+            if (!entry.visible) continue;
+            AssemblyNode node;
+            node.id = entry.id;
+            node.parentId = QStringLiteral("root");
+            node.name = entry.name;
+            assembly.addNode(node);
+        }
+        ok = m_io->exportAssembly(file, assembly, m_partRegistry.get());
+    } else {
+        auto shape = m_partRegistry->activeShape();
+        if (shape.IsNull()) {
+            QMessageBox::warning(this, tr("Nothing to export"), tr("No geometry in the workspace."));
+            Logging::warn(tr("Export aborted: no active shape"));
+            return;
+        }
+        ok = m_io->exportStep(file, shape);
     }
 
-    if (!m_io->exportStep(file, shape)) {
+    if (!ok) {
         QMessageBox::warning(this, tr("Export failed"), tr("The STEP file could not be written."));
         Logging::error(tr("STEP export failed for %1").arg(file));
     } else {
@@ -161,7 +247,7 @@ void MainWindow::exportStepFile() {
 }
 
 void MainWindow::exportGltfFile() {
-    const QString file = QFileDialog::getSaveFileName(this, tr("Export glTF"), QString(), tr("glTF (*.gltf)"));
+    const QString file = QFileDialog::getSaveFileName(this, tr("Export glTF"), QString(), tr("glTF (*.gltf);;Binary glTF (*.glb)"));
     if (file.isEmpty()) return;
 
     Logging::info(tr("Exporting glTF to %1").arg(QFileInfo(file).fileName()));
@@ -221,7 +307,9 @@ void MainWindow::runAnalysis() {
     }
 
     Logging::info(tr("Running analysis on active shape"));
-    m_analysis->setModel(shape);
+    if (!m_analysis->setModel(*m_partRegistry, m_partRegistry->activeId())) {
+        m_analysis->setModel(shape);
+    }
     DomainTemplates templates;
     m_analysis->setAnalysisCase(templates.defaultCase(DomainTemplateKind::Car, shape));
     auto result = m_analysis->runCase();
@@ -241,7 +329,7 @@ void MainWindow::regenerateFromReverse(const TopoDS_Shape &shape) {
     }
     const QString id = m_partRegistry->addPart(tr("ReverseModel"), shape);
     m_partRegistry->setMaterial(id, QStringLiteral("Aluminum 6061"));
-    m_view->displayShape(shape);
+    syncParts();
     statusBar()->showMessage(tr("Generated geometry from prompt"), 2000);
     Logging::info(tr("Reverse engineering produced geometry: %1").arg(id));
 }
@@ -266,7 +354,7 @@ void MainWindow::loadSamplePart() {
     auto shape = m_io->importFile(samplePath);
     if (!shape.IsNull()) {
         m_partRegistry->addPart("Sample Cube", shape);
-        m_view->displayShape(shape);
+        syncParts();
         statusBar()->showMessage(tr("Loaded sample model"), 2000);
         Logging::info(tr("Loaded bundled sample model"));
     }
@@ -277,7 +365,8 @@ void MainWindow::saveProject() {
     if (file.isEmpty()) return;
 
     ProjectSnapshot snapshot;
-    snapshot.shape = m_partRegistry->activeShape();
+    snapshot.parts = m_partRegistry->parts();
+    snapshot.activeId = m_partRegistry->activeId();
     if (m_aiDock) {
         snapshot.chatHistory = m_aiDock->history();
     }
@@ -297,10 +386,12 @@ void MainWindow::loadProject() {
 
     Logging::info(tr("Loading project from %1").arg(QFileInfo(file).fileName()));
     auto snapshot = m_projectIO->loadProject(file);
-    if (!snapshot.shape.IsNull()) {
+    if (!snapshot.parts.empty()) {
+        m_partRegistry->assign(std::move(snapshot.parts), snapshot.activeId);
+    } else if (!snapshot.shape.IsNull()) {
         m_partRegistry->addPart(QFileInfo(file).fileName(), snapshot.shape);
-        m_view->displayShape(snapshot.shape);
     }
+    syncParts();
     if (m_aiDock && !snapshot.chatHistory.isEmpty()) {
         m_aiDock->setHistory(snapshot.chatHistory);
     }
@@ -308,17 +399,22 @@ void MainWindow::loadProject() {
     Logging::info(tr("Project load finished"));
 }
 
+void MainWindow::syncParts() {
+    m_view->syncParts(*m_partRegistry);
+    m_analysis->syncParts(*m_partRegistry);
+}
+
 std::vector<AegisAIEngine::PartInsight> MainWindow::buildInsights() {
     std::vector<AegisAIEngine::PartInsight> insights;
-    const auto parts = m_partRegistry->parts();
+    const auto &parts = m_partRegistry->parts();
     for (const auto &entry : parts) {
-        if (entry.shape.IsNull()) continue;
+        if (entry.shape.isNull()) continue;
         AegisAIEngine::PartInsight insight;
         insight.id = entry.id;
         insight.name = entry.name;
         insight.material = entry.material;
         GProp_GProps props;
-        BRepGProp::Volume(entry.shape, props);
+        BRepGProp::Volume(entry.shape.get(), props);
         insight.volume = props.Mass();
         insight.mass = insight.volume * entry.density;
         insight.peakStress = m_analysis->lastResult().maxStress;
@@ -3,9 +3,11 @@
 #include "../ai/AegisAIEngine.h"
 
 #include <QMainWindow>
+#include <QStringList>
 #include <TopoDS_Shape.hxx>
 #include <memory>
 
+class QAction;
 class OccView;
 class AnalysisLegendOverlay;
 class AegisAssistantDock;
@@ -46,6 +48,12 @@ private:
     void setupToolbar();
     void setupMenus();
     void loadSamplePart();
+    // Imports one file root by root, showing each part as soon as it is transferred.
+    void streamFile(const QString &file);
+    // Imports several files in parallel behind a cancellable progress dialog.
+    void importFiles(const QStringList &files);
+    // Pushes registry changes to the viewer and the analysis manager.
+    void syncParts();
     std::vector<AegisAIEngine::PartInsight> buildInsights();
 
     OccView *m_view{nullptr};
@@ -56,6 +64,7 @@ private:
     ReverseEngineerDock *m_reverseDock{nullptr};
     CamDock *m_camDock{nullptr};
     PythonConsoleDock *m_pythonDock{nullptr};
+    QAction *m_healImports{nullptr};
 
     std::unique_ptr<AnalysisManager> m_analysis;
     std::unique_ptr<AegisAIEngine> m_aiEngine;
@@ -1,120 +1,22 @@
 #include "ProjectIO.h"
 #include "../assembly/AssemblyDocument.h"
-
-#include <BRep_Builder.hxx>
-#include <BRepTools.hxx>
-#include "../cad/StepIgesIO.h"
-#include "../assembly/AssemblyDocument.h"
+#include "../cad/ShapeArchive.h"
 
 #include <QFile>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QSaveFile>
 #include <unordered_map>
-#include <sstream>
-
-ProjectIO::ProjectIO() = default;
-
-static QString serializeShape(const TopoDS_Shape &shape) {
-    if (shape.IsNull()) return {};
-
-    std::ostringstream stream;
-    BRepTools::Write(shape, stream);
-    const std::string data = stream.str();
-    QByteArray bytes(data.data(), static_cast<int>(data.size()));
-    return QString::fromLatin1(bytes.toBase64());
-}
 
-static TopoDS_Shape deserializeShape(const QString &encoded) {
-    if (encoded.isEmpty()) return TopoDS_Shape();
-    QByteArray bytes = QByteArray::fromBase64(encoded.toLatin1());
-    std::string buffer(bytes.constData(), bytes.size());
-    std::istringstream stream(buffer);
-    TopoDS_Shape shape;
-    BRep_Builder builder;
-    if (BRepTools::Read(shape, stream, builder)) {
-        return shape;
-    }
-    return TopoDS_Shape();
-}
+namespace {
+// Chunk names of the .aegisproj container; parts are stored as shapes named kPartPrefix + id.
+const QString kChatChunk = QStringLiteral("chat");
+const QString kAssemblyChunk = QStringLiteral("assembly");
+const QString kPartPrefix = QStringLiteral("part/");
+constexpr int kProjectVersion = 2;
 
-bool ProjectIO::saveProject(const QString &filePath, const ProjectSnapshot &snapshot) {
-    QJsonObject root;
-    root["shape"] = serializeShape(snapshot.shape);
-    QJsonArray history;
-    for (const auto &line : snapshot.chatHistory) {
-        history.append(line);
-    }
-    root["chatHistory"] = history;
-
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly)) {
-        return false;
-    }
-    file.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
-    return true;
-}
-
-ProjectSnapshot ProjectIO::loadProject(const QString &filePath) const {
-    ProjectSnapshot snapshot;
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        return snapshot;
-    }
-    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
-    if (!doc.isObject()) {
-        return snapshot;
-    }
-    QJsonObject obj = doc.object();
-    snapshot.shape = deserializeShape(obj.value("shape").toString());
-    QJsonArray history = obj.value("chatHistory").toArray();
-    for (const auto &line : history) {
-        snapshot.chatHistory.push_back(line.toString());
-    }
-    return snapshot;
-}
-
-ProjectSnapshot ProjectIO::loadProject(const QString &filePath) const {
-    ProjectSnapshot snapshot;
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        return snapshot;
-    }
-    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
-    if (!doc.isObject()) {
-        return snapshot;
-    }
-    QJsonObject obj = doc.object();
-    snapshot.shape = deserializeShape(obj.value("shape").toString());
-    QJsonArray history = obj.value("chatHistory").toArray();
-    for (const auto &line : history) {
-        snapshot.chatHistory.push_back(line.toString());
-    }
-    return snapshot;
-}
-
-}
-
-ProjectSnapshot ProjectIO::loadProject(const QString &filePath) const {
-    ProjectSnapshot snapshot;
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        return snapshot;
-    }
-    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
-    if (!doc.isObject()) {
-        return snapshot;
-    }
-    QJsonObject obj = doc.object();
-    snapshot.shape = deserializeShape(obj.value("shape").toString());
-    QJsonArray history = obj.value("chatHistory").toArray();
-    for (const auto &line : history) {
-        snapshot.chatHistory.push_back(line.toString());
-    }
-    return snapshot;
-}
-
-bool ProjectIO::saveAssembly(const QString &filePath, const AssemblyDocument &assembly) const {
+QJsonObject assemblyToJson(const AssemblyDocument &assembly) {
     QJsonObject root;
     QJsonArray nodes;
     for (const auto &kv : assembly.nodes()) {
@@ -122,6 +24,9 @@ bool ProjectIO::saveAssembly(const QString &filePath, const AssemblyDocument &as
         QJsonObject obj;
         obj["id"] = node.id;
         obj["parent"] = node.parentId;
+        if (!node.name.isEmpty()) {
+            obj["name"] = node.name;
+        }
         obj["partPath"] = node.partPath;
         obj["isReferenceAssembly"] = node.isReferenceAssembly;
         QJsonArray trsf;
@@ -148,26 +53,11 @@ bool ProjectIO::saveAssembly(const QString &filePath, const AssemblyDocument &as
         mates.append(obj);
     }
     root["mates"] = mates;
-
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly)) {
-        return false;
-    }
-    file.write(QJsonDocument(root).toJson());
-    return true;
+    return root;
 }
 
-std::shared_ptr<AssemblyDocument> ProjectIO::loadAssembly(const QString &filePath) const {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        return nullptr;
-    }
+std::shared_ptr<AssemblyDocument> assemblyFromJson(const QJsonObject &root) {
     auto doc = std::make_shared<AssemblyDocument>();
-    QJsonDocument json = QJsonDocument::fromJson(file.readAll());
-    if (!json.isObject()) {
-        return doc;
-    }
-    QJsonObject root = json.object();
     std::unordered_map<QString, AssemblyNode> nodes;
     QJsonArray nodeArray = root.value("nodes").toArray();
     for (const auto &value : nodeArray) {
@@ -175,6 +65,7 @@ std::shared_ptr<AssemblyDocument> ProjectIO::loadAssembly(const QString &filePat
         AssemblyNode node;
         node.id = obj.value("id").toString();
         node.parentId = obj.value("parent").toString();
+        node.name = obj.value("name").toString();
         node.partPath = obj.value("partPath").toString();
         node.isReferenceAssembly = obj.value("isReferenceAssembly").toBool();
         QJsonArray trsf = obj.value("trsf").toArray();
@@ -208,47 +99,91 @@ std::shared_ptr<AssemblyDocument> ProjectIO::loadAssembly(const QString &filePat
     doc->reset(nodes, mates);
     return doc;
 }
+}
 
-bool ProjectIO::saveAssembly(const QString &filePath, const AssemblyDocument &assembly) const {
-    QJsonObject root;
-    QJsonArray nodes;
-    for (const auto &kv : assembly.nodes()) {
-        const AssemblyNode &node = kv.second;
-        QJsonObject obj;
-        obj["id"] = node.id;
-        obj["parent"] = node.parentId;
-        obj["partPath"] = node.partPath;
-        obj["isReferenceAssembly"] = node.isReferenceAssembly;
-        QJsonArray trsf;
-        for (int r = 1; r <= 3; ++r) {
-            for (int c = 1; c <= 4; ++c) {
-                trsf.append(node.localTransform.Value(r, c));
+ProjectIO::ProjectIO() = default;
+
+// A project is a ShapeArchive: one named shape per part, the chat history and the assembly
+// graph as separate chunks, and the active part id in the index header. Files written
+// before the container were indented JSON with one base64 ASCII BREP shape.
+bool ProjectIO::saveProject(const QString &filePath, const ProjectSnapshot &snapshot) {
+    // Written beside the target and renamed over it, so parts still mapped from the old file
+    // stay readable while they are copied. The mapping is released before the rename.
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    ShapeArchiveWriter writer(file);
+    QString activeId = snapshot.activeId;
+    if (snapshot.parts.empty() && !snapshot.shape.IsNull()) {
+        PartRegistry::Entry entry;
+        entry.id = QStringLiteral("main");
+        entry.name = entry.id;
+        activeId = entry.id;
+        writer.add(snapshot.shape, PartRegistry::entryToJson(entry), kPartPrefix + entry.id);
+    }
+    for (const auto &entry : snapshot.parts) {
+        writer.add(entry.shape, PartRegistry::entryToJson(entry), kPartPrefix + entry.id);
+    }
+
+    QJsonArray history;
+    for (const auto &line : snapshot.chatHistory) {
+        history.append(line);
+    }
+    writer.addChunk(kChatChunk, QJsonDocument(history).toJson(QJsonDocument::Compact));
+    if (snapshot.assembly) {
+        writer.addChunk(kAssemblyChunk, QJsonDocument(assemblyToJson(*snapshot.assembly)).toJson(QJsonDocument::Compact));
+    }
+
+    QJsonObject header;
+    header["format"] = QStringLiteral("aegisproj");
+    header["version"] = kProjectVersion;
+    header["activeId"] = activeId;
+    if (!writer.finish(header)) return false;
+    ShapeArchiveReader::releaseMapping(filePath);
+    return file.commit();
+}
+
+ProjectSnapshot ProjectIO::loadProject(const QString &filePath) const {
+    ProjectSnapshot snapshot;
+    ProjectReader reader;
+    if (reader.open(filePath)) {
+        snapshot.parts = reader.parts();
+        snapshot.activeId = reader.activeId();
+        snapshot.chatHistory = reader.chatHistory();
+        snapshot.assembly = reader.assembly();
+        for (const auto &entry : snapshot.parts) {
+            if (entry.id == snapshot.activeId) {
+                snapshot.shape = entry.shape.get();
             }
         }
-        obj["trsf"] = trsf;
-        nodes.append(obj);
+        return snapshot;
     }
-    root["nodes"] = nodes;
 
-    QJsonArray mates;
-    for (const auto &mate : assembly.mates()) {
-        QJsonObject obj;
-        obj["id"] = mate.id;
-        obj["a"] = mate.a;
-        obj["b"] = mate.b;
-        obj["type"] = jointTypeToString(mate.type);
-        obj["suppressed"] = mate.suppressed;
-        obj["limitMin"] = mate.limitMin;
-        obj["limitMax"] = mate.limitMax;
-        mates.append(obj);
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly) || ShapeArchive::isArchive(file)) {
+        return snapshot;
     }
-    root["mates"] = mates;
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    if (!doc.isObject()) {
+        return snapshot;
+    }
+    QJsonObject obj = doc.object();
+    snapshot.shape = LazyShape::fromBytes(QByteArray::fromBase64(obj.value("shape").toString().toLatin1()),
+                                          LazyShape::Encoding::AsciiBrep).get();
+    QJsonArray history = obj.value("chatHistory").toArray();
+    for (const auto &line : history) {
+        snapshot.chatHistory.push_back(line.toString());
+    }
+    return snapshot;
+}
 
+bool ProjectIO::saveAssembly(const QString &filePath, const AssemblyDocument &assembly) const {
     QFile file(filePath);
     if (!file.open(QIODevice::WriteOnly)) {
         return false;
     }
-    file.write(QJsonDocument(root).toJson());
+    file.write(QJsonDocument(assemblyToJson(assembly)).toJson());
     return true;
 }
 
@@ -257,50 +192,74 @@ std::shared_ptr<AssemblyDocument> ProjectIO::loadAssembly(const QString &filePat
     if (!file.open(QIODevice::ReadOnly)) {
         return nullptr;
     }
-    auto doc = std::make_shared<AssemblyDocument>();
     QJsonDocument json = QJsonDocument::fromJson(file.readAll());
     if (!json.isObject()) {
-        return doc;
+        return std::make_shared<AssemblyDocument>();
     }
-    QJsonObject root = json.object();
-    std::unordered_map<QString, AssemblyNode> nodes;
-    QJsonArray nodeArray = root.value("nodes").toArray();
-    for (const auto &value : nodeArray) {
-        QJsonObject obj = value.toObject();
-        AssemblyNode node;
-        node.id = obj.value("id").toString();
-        node.parentId = obj.value("parent").toString();
-        node.partPath = obj.value("partPath").toString();
-        node.isReferenceAssembly = obj.value("isReferenceAssembly").toBool();
-        QJsonArray trsf = obj.value("trsf").toArray();
-        if (trsf.size() >= 12) {
-            gp_Trsf t;
-            int idx = 0;
-            for (int r = 1; r <= 3; ++r) {
-                for (int c = 1; c <= 4; ++c) {
-                    t.SetValue(r, c, trsf[idx++].toDouble());
-                }
-            }
-            node.localTransform = t;
+    return assemblyFromJson(json.object());
+}
+
+bool ProjectReader::open(const QString &filePath) {
+    {
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly) || !ShapeArchive::isArchive(file)) {
+            return false;
         }
-        nodes[node.id] = node;
     }
+    return m_archive.open(filePath) && m_archive.header().value("format").toString() == QStringLiteral("aegisproj");
+}
 
-    std::vector<MateConstraint> mates;
-    QJsonArray mateArray = root.value("mates").toArray();
-    for (const auto &value : mateArray) {
-        QJsonObject obj = value.toObject();
-        MateConstraint mate;
-        mate.id = obj.value("id").toString();
-        mate.a = obj.value("a").toString();
-        mate.b = obj.value("b").toString();
-        mate.type = jointTypeFromString(obj.value("type").toString());
-        mate.suppressed = obj.value("suppressed").toBool();
-        mate.limitMin = obj.value("limitMin").toDouble();
-        mate.limitMax = obj.value("limitMax").toDouble();
-        mates.push_back(mate);
+QString ProjectReader::activeId() const {
+    return m_archive.header().value("activeId").toString();
+}
+
+QStringList ProjectReader::partIds() const {
+    QStringList ids;
+    for (const auto &entry : m_archive.entries()) {
+        if (!entry.raw && entry.name.startsWith(kPartPrefix)) {
+            ids.push_back(entry.name.mid(kPartPrefix.size()));
+        }
     }
-    doc->reset(nodes, mates);
-    return doc;
+    return ids;
+}
+
+std::optional<PartRegistry::Entry> ProjectReader::part(const QString &id) const {
+    const int index = m_archive.find(kPartPrefix + id);
+    if (index < 0 || m_archive.entries()[index].raw) {
+        return std::nullopt;
+    }
+    PartRegistry::Entry entry = PartRegistry::entryFromJson(m_archive.entries()[index].meta);
+    entry.id = id;
+    entry.shape = m_archive.shape(static_cast<std::size_t>(index));
+    return entry;
+}
+
+std::vector<PartRegistry::Entry> ProjectReader::parts() const {
+    std::vector<PartRegistry::Entry> parts;
+    for (std::size_t i = 0; i < m_archive.entries().size(); ++i) {
+        const auto &stored = m_archive.entries()[i];
+        if (stored.raw || !stored.name.startsWith(kPartPrefix)) continue;
+        PartRegistry::Entry entry = PartRegistry::entryFromJson(stored.meta);
+        entry.id = stored.name.mid(kPartPrefix.size());
+        entry.shape = m_archive.shape(i);
+        parts.push_back(std::move(entry));
+    }
+    return parts;
 }
 
+QStringList ProjectReader::chatHistory() const {
+    QStringList history;
+    for (const auto &line : QJsonDocument::fromJson(m_archive.chunk(kChatChunk)).array()) {
+        history.push_back(line.toString());
+    }
+    return history;
+}
+
+std::shared_ptr<AssemblyDocument> ProjectReader::assembly() const {
+    const QByteArray data = m_archive.chunk(kAssemblyChunk);
+    if (data.isEmpty()) {
+        return nullptr;
+    }
+    const QJsonDocument json = QJsonDocument::fromJson(data);
+    return json.isObject() ? assemblyFromJson(json.object()) : nullptr;
+}
@@ -1,19 +1,24 @@
 #pragma once
 
+#include "../cad/PartRegistry.h"
+#include "../cad/ShapeArchive.h"
+
 #include <QString>
 #include <TopoDS_Shape.hxx>
 #include <QStringList>
 #include <memory>
+#include <optional>
+#include <vector>
 
 class AssemblyDocument;
 
 struct ProjectSnapshot {
-    TopoDS_Shape shape;
+    TopoDS_Shape shape;  // active part; saved as the only part when `parts` is empty
     QStringList chatHistory;
+    std::vector<PartRegistry::Entry> parts;  // shapes load lazily
+    QString activeId;
+    std::shared_ptr<AssemblyDocument> assembly;
 };
-#include <memory>
-
-class AssemblyDocument;
 
 class ProjectIO {
 public:
@@ -21,10 +26,25 @@ public:
 
     bool saveProject(const QString &filePath, const ProjectSnapshot &snapshot);
     ProjectSnapshot loadProject(const QString &filePath) const;
-    bool saveProject(const QString &filePath, const TopoDS_Shape &shape);
-    TopoDS_Shape loadProject(const QString &filePath) const;
 
     bool saveAssembly(const QString &filePath, const AssemblyDocument &assembly) const;
     std::shared_ptr<AssemblyDocument> loadAssembly(const QString &filePath) const;
 };
 
+// Random access into a saved .aegisproj. open() maps the file and reads only the table of
+// contents; each part, the chat history and the assembly graph are read when asked for.
+class ProjectReader {
+public:
+    bool open(const QString &filePath);
+
+    QString activeId() const;
+    QStringList partIds() const;
+    std::optional<PartRegistry::Entry> part(const QString &id) const;
+    std::vector<PartRegistry::Entry> parts() const;
+    QStringList chatHistory() const;
+    // Null when the project was saved without one.
+    std::shared_ptr<AssemblyDocument> assembly() const;
+
+private:
+    ShapeArchiveReader m_archive;
+};
@@ -15,6 +15,7 @@
 struct AssemblyNode {
     QString id;
     QString parentId;
+    QString name;            //!< Display name, e.g. the product name of an imported STEP occurrence
     QString partPath;        //!< Optional reference to a .aegispart file on disk
     TopoDS_Shape shape;      //!< Resolved shape when the part is loaded
     gp_Trsf localTransform;  //!< Local frame relative to parent
@@ -0,0 +1,127 @@
+#include "BatchImporter.h"
+#include "StepIgesIO.h"
+#include "XcafDocumentPool.h"
+#include "../utils/Logging.h"
+
+#include <BRep_Builder.hxx>
+#include <Message_ProgressIndicator.hxx>
+#include <QtConcurrent>
+#include <TDF_LabelSequence.hxx>
+#include <TopoDS_Compound.hxx>
+#include <XCAFDoc_Editor.hxx>
+#include <XCAFDoc_ShapeTool.hxx>
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+struct BatchImporter::State {
+    bool cancelled() {
+        if (cancelRequested) return true;
+        std::lock_guard<std::mutex> lock(futureMutex);
+        return future.isCanceled();
+    }
+
+    XcafDocumentPool::Lease merged;
+    std::mutex mergeMutex;  // guards merged
+    std::atomic<bool> cancelRequested{false};
+    std::mutex futureMutex;
+    QFuture<Result> future;
+};
+
+namespace {
+// Turns cancellation of the batch into a user break inside the OCCT transfer.
+class CancelProgress : public Message_ProgressIndicator {
+public:
+    explicit CancelProgress(std::function<bool()> cancelled) : m_cancelled(std::move(cancelled)) {}
+
+    Standard_Boolean UserBreak() override { return m_cancelled(); }
+
+    void Show(const Message_ProgressScope &, const Standard_Boolean) override {}
+
+private:
+    std::function<bool()> m_cancelled;
+};
+}
+
+BatchImporter::BatchImporter() : m_state(std::make_shared<State>()) {
+    m_state->merged = XcafDocumentPool::instance().acquire();
+}
+
+Handle(TDocStd_Document) BatchImporter::document() const {
+    return m_state->merged.document();
+}
+
+void BatchImporter::cancel() {
+    m_state->cancelRequested = true;
+    std::lock_guard<std::mutex> lock(m_state->futureMutex);
+    m_state->future.cancel();
+}
+
+QFuture<BatchImporter::Result> BatchImporter::start(const QStringList &paths) {
+    std::shared_ptr<State> state = m_state;
+    state->cancelRequested = false;
+
+    const std::optional<ShapeHealing::Options> healing = m_healing;
+    std::function<Result(const QString &)> import = [state, healing](const QString &path) {
+        Result result;
+        result.path = path;
+        if (state->cancelled()) return result;
+
+        XcafDocumentPool::Lease local = XcafDocumentPool::instance().acquire();
+        Handle(CancelProgress) progress = new CancelProgress([state]() { return state->cancelled(); });
+        if (!StepIgesIO().readInto(path, local.document(), progress->Start())) {
+            if (!state->cancelled()) {
+                Logging::warn(QStringLiteral("Batch import failed for %1").arg(path));
+            }
+            return result;
+        }
+        if (state->cancelled()) return result;
+
+        TDF_LabelSequence roots;
+        local.shapeTool()->GetFreeShapes(roots);
+        if (roots.IsEmpty()) {
+            Logging::warn(QStringLiteral("No geometry in %1").arg(path));
+            return result;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(state->mergeMutex);
+            Handle(XCAFDoc_ShapeTool) target = state->merged.shapeTool();
+            TDF_LabelSequence before;
+            target->GetFreeShapes(before);
+            if (!XCAFDoc_Editor::Extract(roots, state->merged.document()->Main())) {
+                Logging::warn(QStringLiteral("Could not merge %1 into the batch document").arg(path));
+                return result;
+            }
+            TDF_LabelSequence after;
+            target->GetFreeShapes(after);
+
+            // Extract appends new free shapes, so this file's roots are the tail of the list.
+            BRep_Builder builder;
+            TopoDS_Compound compound;
+            builder.MakeCompound(compound);
+            for (Standard_Integer i = before.Length() + 1; i <= after.Length(); ++i) {
+                builder.Add(compound, target->GetShape(after.Value(i)));
+                ++result.roots;
+            }
+            result.shape = compound;
+            result.ok = result.roots > 0;
+        }
+        if (healing && result.ok) {
+            result.healing.source = path;
+            result.shape = ShapeHealing(*healing).heal(result.shape, &result.healing);
+        }
+        return result;
+    };
+
+    QFuture<Result> future = QtConcurrent::mapped(paths, import);
+    std::lock_guard<std::mutex> lock(state->futureMutex);
+    state->future = future;
+    return future;
+}
+
+std::vector<BatchImporter::Result> BatchImporter::run(const QStringList &paths) {
+    QFuture<Result> future = start(paths);
+    const QList<Result> results = future.results();
+    return std::vector<Result>(results.begin(), results.end());
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ShapeHealing.h"
+
+#include <QFuture>
+#include <QString>
+#include <QStringList>
+#include <TDocStd_Document.hxx>
+#include <TopoDS_Shape.hxx>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Imports many STEP/IGES files on the thread pool into one XCAF document. Every file is
+// read and transferred into a private document by its own worker; only the final copy of
+// its labels (names, colours, materials) into the shared document is serialized.
+class BatchImporter {
+public:
+    struct Result {
+        QString path;
+        TopoDS_Shape shape;  // compound of the file's roots as they sit in document()
+        int roots{0};
+        bool ok{false};
+        ShapeHealing::Report healing;  // empty unless healing is enabled
+    };
+
+    BatchImporter();
+
+    // Results are reported as each file finishes, and progress counts finished files.
+    // Files merge in completion order. Cancelling the future (or cancel()) skips files that
+    // have not started and breaks transfers that are under way.
+    QFuture<Result> start(const QStringList &paths);
+    std::vector<Result> run(const QStringList &paths);
+    void cancel();
+
+    // Heals each file's shape on its worker, outside the merge lock, before it is reported.
+    // Labels in document() keep the topology as read.
+    void setHealing(const std::optional<ShapeHealing::Options> &options) { m_healing = options; }
+
+    // Accumulates the roots of every file imported by this instance. The document is leased
+    // from XcafDocumentPool and goes back to it with the importer.
+    Handle(TDocStd_Document) document() const;
+
+private:
+    struct State;
+    std::shared_ptr<State> m_state;
+    std::optional<ShapeHealing::Options> m_healing;
+};
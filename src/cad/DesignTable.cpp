@@ -0,0 +1,227 @@
+#include "DesignTable.h"
+#include "StepIgesIO.h"
+#include "../utils/Logging.h"
+
+#include <BRepTools.hxx>
+#include <QDir>
+#include <QFile>
+#include <QRegularExpression>
+#include <QtConcurrent>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace {
+const QString kFeaturePrefix = QStringLiteral("feature.");
+
+// The STEP translator keeps process-wide state, so concurrent variants write one at a time.
+std::mutex &stepWriterMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+int featureIndex(const QString &column) {
+    if (!column.startsWith(kFeaturePrefix)) return -1;
+    bool ok = false;
+    const int index = column.mid(kFeaturePrefix.size()).toInt(&ok);
+    return ok && index >= 0 ? index : -1;
+}
+
+QString fileNameFor(const QString &variant) {
+    QString name = variant;
+    name.replace(QRegularExpression(QStringLiteral("[^A-Za-z0-9_.-]")), QStringLiteral("_"));
+    return name;
+}
+
+struct Assignment {
+    int column{0};
+    int node{-1};       // history node, or -1 for a sketch dimension
+    QString dimension;
+};
+
+// Everything the workers share; read-only once start() returns.
+struct RunPlan {
+    Sketch2D sketch;
+    FeatureTree history;
+    TopoDS_Shape profile;
+    std::vector<Assignment> varying;
+    bool sketchVaries{false};
+    QString outputDir;
+    DesignTableRunner::Format format{DesignTableRunner::Format::Step};
+};
+
+void applyFeatureValue(FeatureTree &tree, int node, double value) {
+    FeatureTree::Node updated = tree.nodes()[node];
+    updated.value = value;
+    tree.update(node, updated);
+}
+}
+
+bool DesignTable::load(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        Logging::warn(QStringLiteral("Cannot open design table: %1").arg(path));
+        return false;
+    }
+    return parse(QString::fromUtf8(file.readAll()));
+}
+
+bool DesignTable::parse(const QString &csv) {
+    m_parameters.clear();
+    m_variants.clear();
+
+    QStringList header;
+    bool hasName = false;
+    int row = 0;
+    for (const QString &rawLine : csv.split(QLatin1Char('\n'))) {
+        const QString line = rawLine.trimmed();
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#'))) continue;
+        QStringList cells = line.split(QLatin1Char(','));
+        for (QString &cell : cells) {
+            cell = cell.trimmed();
+        }
+
+        if (header.isEmpty()) {
+            header = cells;
+            hasName = header.first().compare(QStringLiteral("name"), Qt::CaseInsensitive) == 0;
+            m_parameters = header.mid(hasName ? 1 : 0);
+            if (m_parameters.isEmpty()) {
+                Logging::warn(QStringLiteral("Design table has no parameter columns"));
+                return false;
+            }
+            continue;
+        }
+
+        ++row;
+        if (cells.size() != header.size()) {
+            Logging::warn(QStringLiteral("Design table row %1 has %2 cells, expected %3").arg(row).arg(cells.size()).arg(header.size()));
+            continue;
+        }
+        Variant variant;
+        variant.name = hasName && !cells.first().isEmpty() ? cells.first() : QStringLiteral("variant_%1").arg(row);
+        bool valid = true;
+        for (int c = hasName ? 1 : 0; c < cells.size() && valid; ++c) {
+            variant.values.push_back(cells[c].toDouble(&valid));
+        }
+        if (!valid) {
+            Logging::warn(QStringLiteral("Design table row %1 has a non-numeric value").arg(row));
+            continue;
+        }
+        m_variants.push_back(std::move(variant));
+    }
+    return !m_variants.empty();
+}
+
+DesignTableRunner::DesignTableRunner(const Sketch2D &sketch, const FeatureTree &history)
+    : m_sketch(sketch), m_history(history) {}
+
+QFuture<DesignTableRunner::Result> DesignTableRunner::start(const DesignTable &table, const QString &outputDir, Format format) {
+    auto plan = std::make_shared<RunPlan>();
+    plan->sketch = m_sketch;
+    plan->history = m_history;
+    plan->outputDir = outputDir;
+    plan->format = format;
+    if (!outputDir.isEmpty()) {
+        QDir().mkpath(outputDir);
+    }
+
+    // Columns that hold one value for the whole table are baked into the shared base;
+    // only the varying ones are applied per variant.
+    const auto &variants = table.variants();
+    const QStringList &parameters = table.parameters();
+    std::size_t firstVaryingNode = plan->history.nodes().size();
+    for (int c = 0; c < parameters.size(); ++c) {
+        Assignment assignment{c, featureIndex(parameters[c]), QString()};
+        if (assignment.node < 0) {
+            assignment.dimension = parameters[c];
+            if (!plan->sketch.hasDimension(assignment.dimension)) {
+                Logging::warn(QStringLiteral("Design table column %1 matches no sketch dimension").arg(parameters[c]));
+                continue;
+            }
+        } else if (assignment.node >= static_cast<int>(plan->history.nodes().size())) {
+            Logging::warn(QStringLiteral("Design table column %1 is past the end of the history").arg(parameters[c]));
+            continue;
+        }
+
+        bool varies = false;
+        for (const auto &variant : variants) {
+            varies = varies || variant.values[c] != variants.front().values[c];
+        }
+        if (varies) {
+            plan->varying.push_back(assignment);
+            if (assignment.node < 0) {
+                plan->sketchVaries = true;
+            } else {
+                firstVaryingNode = std::min(firstVaryingNode, static_cast<std::size_t>(assignment.node));
+            }
+        } else if (!variants.empty()) {
+            if (assignment.node < 0) {
+                plan->sketch.updateDimension(assignment.dimension, variants.front().values[c]);
+            } else {
+                applyFeatureValue(plan->history, assignment.node, variants.front().values[c]);
+            }
+        }
+    }
+
+    plan->sketch.solve();
+    plan->profile = plan->sketch.toFace();
+    plan->history.setProfile(plan->profile);
+    m_sharedPrefix = plan->sketchVaries || variants.empty() ? 0 : firstVaryingNode;
+    if (m_sharedPrefix > 0) {
+        FeatureTree prefix;
+        prefix.setProfile(plan->profile);
+        for (std::size_t i = 0; i < m_sharedPrefix; ++i) {
+            prefix.push(plan->history.nodes()[i]);
+        }
+        prefix.replay();
+        plan->history.adoptCache(prefix);
+    }
+
+    std::function<Result(const DesignTable::Variant &)> regenerate = [plan](const DesignTable::Variant &variant) {
+        Result result;
+        result.name = variant.name;
+        FeatureTree tree(plan->history);
+        if (plan->sketchVaries) {
+            Sketch2D sketch(plan->sketch);
+            for (const auto &assignment : plan->varying) {
+                if (assignment.node < 0) {
+                    sketch.updateDimension(assignment.dimension, variant.values[assignment.column]);
+                }
+            }
+            tree.setProfile(sketch.toFace());
+        }
+        for (const auto &assignment : plan->varying) {
+            if (assignment.node >= 0) {
+                applyFeatureValue(tree, assignment.node, variant.values[assignment.column]);
+            }
+        }
+
+        result.shape = tree.replay();
+        result.ok = !result.shape.IsNull();
+        if (!result.ok) {
+            Logging::warn(QStringLiteral("Design table variant %1 failed to regenerate").arg(variant.name));
+            return result;
+        }
+        if (plan->outputDir.isEmpty()) return result;
+
+        const bool step = plan->format == Format::Step;
+        result.path = QDir(plan->outputDir).filePath(fileNameFor(variant.name) + (step ? QStringLiteral(".step") : QStringLiteral(".brep")));
+        if (step) {
+            std::lock_guard<std::mutex> lock(stepWriterMutex());
+            result.ok = StepIgesIO().exportStep(result.path, result.shape);
+        } else {
+            result.ok = BRepTools::Write(result.shape, result.path.toStdString().c_str());
+            if (!result.ok) {
+                Logging::warn(QStringLiteral("Failed to write BREP file: %1").arg(result.path));
+            }
+        }
+        return result;
+    };
+    return QtConcurrent::mapped(variants, regenerate);
+}
+
+std::vector<DesignTableRunner::Result> DesignTableRunner::run(const DesignTable &table, const QString &outputDir, Format format) {
+    QFuture<Result> future = start(table, outputDir, format);
+    const QList<Result> results = future.results();
+    return std::vector<Result>(results.begin(), results.end());
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "SketchEngine.h"
+
+#include <QFuture>
+#include <QString>
+#include <QStringList>
+#include <TopoDS_Shape.hxx>
+#include <cstddef>
+#include <vector>
+
+// Rows of parameter values for a product family, read from CSV. The header names the
+// columns: an optional leading `name` column, `feature.N` for the value of history node N,
+// and anything else for a sketch dimension id.
+class DesignTable {
+public:
+    struct Variant {
+        QString name;
+        std::vector<double> values;  // one per parameter column
+    };
+
+    bool load(const QString &path);
+    bool parse(const QString &csv);
+
+    const QStringList &parameters() const { return m_parameters; }
+    const std::vector<Variant> &variants() const { return m_variants; }
+
+private:
+    QStringList m_parameters;
+    std::vector<Variant> m_variants;
+};
+
+// Regenerates one sketch/history pair for every row of a design table on the thread pool.
+// Each worker owns copies of the sketch and the tree; history nodes before the first varying
+// parameter are computed once up front and their cached results are shared by all copies.
+class DesignTableRunner {
+public:
+    enum class Format { Step, Brep };
+
+    struct Result {
+        QString name;
+        TopoDS_Shape shape;
+        QString path;  // empty when no output directory was given
+        bool ok{false};
+    };
+
+    DesignTableRunner(const Sketch2D &sketch, const FeatureTree &history);
+
+    // Results are reported as each variant finishes; files are written by the worker that
+    // produced them. Cancelling the future stops variants that have not started.
+    QFuture<Result> start(const DesignTable &table, const QString &outputDir = QString(), Format format = Format::Step);
+    std::vector<Result> run(const DesignTable &table, const QString &outputDir = QString(), Format format = Format::Step);
+
+    // Number of leading history nodes shared by every variant of the last start().
+    std::size_t sharedPrefix() const { return m_sharedPrefix; }
+
+private:
+    Sketch2D m_sketch;
+    FeatureTree m_history;
+    std::size_t m_sharedPrefix{0};
+};
@@ -0,0 +1,122 @@
+#include "EdgeIndex.h"
+
+#include <BRepAdaptor_Curve.hxx>
+#include <BRepBndLib.hxx>
+#include <BRep_Tool.hxx>
+#include <Precision.hxx>
+#include <TopAbs_ShapeEnum.hxx>
+#include <TopExp.hxx>
+#include <TopoDS.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <list>
+#include <mutex>
+
+namespace {
+constexpr std::size_t kCachedIndices = 8;
+
+std::mutex &cacheMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::list<std::shared_ptr<const EdgeIndex>> &recentIndices() {
+    static std::list<std::shared_ptr<const EdgeIndex>> indices;
+    return indices;
+}
+}
+
+EdgeIndex::EdgeIndex(const TopoDS_Shape &shape) : m_shape(shape) {
+    if (shape.IsNull()) return;
+    TopExp::MapShapes(shape, TopAbs_EDGE, m_edges);
+    TopExp::MapShapesAndAncestors(shape, TopAbs_EDGE, TopAbs_FACE, m_edgeFaces);
+    BRepBndLib::Add(shape, m_bounds, false);
+}
+
+TopoDS_Edge EdgeIndex::edge(int edge) const {
+    if (!contains(edge)) return TopoDS_Edge();
+    return TopoDS::Edge(m_edges.FindKey(edge + 1));
+}
+
+int EdgeIndex::indexOf(const TopoDS_Edge &edge) const {
+    return m_edges.FindIndex(edge) - 1;
+}
+
+TopoDS_Face EdgeIndex::adjacentFace(int edge) const {
+    if (!contains(edge)) return TopoDS_Face();
+    const TopoDS_Shape &key = m_edges.FindKey(edge + 1);
+    const int ancestry = m_edgeFaces.FindIndex(key);
+    if (ancestry == 0 || m_edgeFaces.FindFromIndex(ancestry).IsEmpty()) return TopoDS_Face();
+    return TopoDS::Face(m_edgeFaces.FindFromIndex(ancestry).First());
+}
+
+bool EdgeIndex::isFilletable(int edge) const {
+    if (!contains(edge)) return false;
+    if (BRep_Tool::Degenerated(TopoDS::Edge(m_edges.FindKey(edge + 1)))) return false;
+    return !adjacentFace(edge).IsNull();
+}
+
+EdgeIndex::Reference EdgeIndex::reference(int edge) const {
+    Reference reference;
+    if (!isFilletable(edge) || m_bounds.IsVoid()) return reference;
+    const BRepAdaptor_Curve curve(TopoDS::Edge(m_edges.FindKey(edge + 1)));
+    gp_Vec derivative;
+    curve.D1(0.5 * (curve.FirstParameter() + curve.LastParameter()), reference.midpoint, derivative);
+    if (derivative.Magnitude() <= gp::Resolution()) return reference;
+    reference.curveType = static_cast<int>(curve.GetType());
+    reference.tangent = gp_Dir(derivative);
+    const gp_XYZ low = m_bounds.CornerMin().XYZ();
+    const gp_XYZ extent = m_bounds.CornerMax().XYZ() - low;
+    const gp_XYZ offset = reference.midpoint.XYZ() - low;
+    const auto ratio = [](double value, double size) { return size > Precision::Confusion() ? value / size : 0.0; };
+    reference.relative = gp_XYZ(ratio(offset.X(), extent.X()), ratio(offset.Y(), extent.Y()), ratio(offset.Z(), extent.Z()));
+    reference.valid = true;
+    return reference;
+}
+
+int EdgeIndex::resolve(const Reference &reference) const {
+    if (!reference.valid) return -1;
+    int best = -1;
+    double bestScore = std::numeric_limits<double>::max();
+    for (int e = 0; e < edgeCount(); ++e) {
+        const Reference candidate = this->reference(e);
+        if (!candidate.valid || candidate.curveType != reference.curveType) continue;
+        // Edges run either way, so only the tangent's line matters.
+        const double turn = 1.0 - std::abs(candidate.tangent.Dot(reference.tangent));
+        if (candidate.midpoint.Distance(reference.midpoint) <= Precision::Confusion() && turn <= Precision::Angular()) {
+            return e;
+        }
+        const double score = (candidate.relative - reference.relative).Modulus() + turn;
+        if (score < bestScore) {
+            bestScore = score;
+            best = e;
+        }
+    }
+    return best;
+}
+
+std::shared_ptr<const EdgeIndex> EdgeIndex::forShape(const TopoDS_Shape &shape) {
+    const auto sameShape = [&shape](const std::shared_ptr<const EdgeIndex> &index) { return index->shape().IsEqual(shape); };
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex());
+        auto &indices = recentIndices();
+        auto found = std::find_if(indices.begin(), indices.end(), sameShape);
+        if (found != indices.end()) {
+            indices.splice(indices.begin(), indices, found);
+            return indices.front();
+        }
+    }
+
+    // Build outside the lock; large imported parts take a while to map.
+    auto built = std::make_shared<const EdgeIndex>(shape);
+    std::lock_guard<std::mutex> lock(cacheMutex());
+    auto &indices = recentIndices();
+    indices.remove_if(sameShape);
+    indices.push_front(built);
+    if (indices.size() > kCachedIndices) {
+        indices.pop_back();
+    }
+    return built;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Bnd_Box.hxx>
+#include <TopTools_IndexedDataMapOfShapeListOfShape.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+#include <TopoDS_Edge.hxx>
+#include <TopoDS_Face.hxx>
+#include <TopoDS_Shape.hxx>
+#include <gp_Dir.hxx>
+#include <gp_Pnt.hxx>
+#include <gp_XYZ.hxx>
+#include <memory>
+
+// Deduplicated edge list and edge->face ancestry of one shape. Edge numbers are
+// 0-based positions in the indexed map and stay stable for the same TopoDS_Shape only;
+// use a Reference to find the same edge again after the shape was rebuilt.
+class EdgeIndex {
+public:
+    // Geometry of an edge: curve type, midpoint and tangent there, and the midpoint relative
+    // to the shape's bounding box so the edge can still be found after a resize.
+    struct Reference {
+        bool valid{false};
+        int curveType{0};
+        gp_Pnt midpoint;
+        gp_Dir tangent;
+        gp_XYZ relative;
+    };
+
+    explicit EdgeIndex(const TopoDS_Shape &shape);
+
+    const TopoDS_Shape &shape() const { return m_shape; }
+    int edgeCount() const { return m_edges.Extent(); }
+    bool contains(int edge) const { return edge >= 0 && edge < m_edges.Extent(); }
+    TopoDS_Edge edge(int edge) const;
+    int indexOf(const TopoDS_Edge &edge) const;
+
+    // First face bordering the edge, or a null face for free edges.
+    TopoDS_Face adjacentFace(int edge) const;
+    // Non-degenerated edges that border at least one face.
+    bool isFilletable(int edge) const;
+
+    Reference reference(int edge) const;
+    // Filletable edge with the same curve type closest to `reference`: an edge at the same
+    // place wins outright, otherwise the nearest in box-relative position and direction.
+    // Returns -1 when no edge of that curve type exists.
+    int resolve(const Reference &reference) const;
+
+    // Cached per shape so successive fillet/chamfer calls on the same input share one index.
+    static std::shared_ptr<const EdgeIndex> forShape(const TopoDS_Shape &shape);
+
+private:
+    TopoDS_Shape m_shape;
+    TopTools_IndexedMapOfShape m_edges;
+    TopTools_IndexedDataMapOfShapeListOfShape m_edgeFaces;
+    Bnd_Box m_bounds;
+};
@@ -1,12 +1,19 @@
 #include "FeatureOps.h"
+#include "EdgeIndex.h"
+#include "PersistentNaming.h"
+#include "ShapeCache.h"
+#include "../utils/Settings.h"
 
-#include <BOPAlgo_Builder.hxx>
+#include <BOPAlgo_Options.hxx>
+#include <BRepAlgoAPI_BooleanOperation.hxx>
 #include <BRepAlgoAPI_Cut.hxx>
 #include <BRepAlgoAPI_Fuse.hxx>
+#include <BRepBuilderAPI_Copy.hxx>
 #include <BRepBuilderAPI_MakeFace.hxx>
+#include <BRepFilletAPI_MakeChamfer.hxx>
+#include <BRepMesh_IncrementalMesh.hxx>
 #include <BRepFilletAPI_MakeFillet.hxx>
 #include <BRepOffsetAPI_DraftAngle.hxx>
-#include <BRepOffsetAPI_MakeChamfer.hxx>
 #include <BRepOffsetAPI_MakeOffset.hxx>
 #include <BRepOffsetAPI_MakeThickSolidByJoin.hxx>
 #include <BRepPrimAPI_MakeBox.hxx>
@@ -14,59 +21,163 @@
 #include <BRepPrimAPI_MakePrism.hxx>
 #include <BRepPrimAPI_MakeRevol.hxx>
 #include <GProp_GProps.hxx>
+#include <OSD_ThreadPool.hxx>
+#include <QThread>
+#include <QThreadPool>
 #include <ShapeAnalysis_FreeBounds.hxx>
+#include <Standard_ProgramError.hxx>
 #include <gp.hxx>
-#include <TNaming_Builder.hxx>
-#include <TDF_Label.hxx>
 #include <TopAbs_ShapeEnum.hxx>
 #include <TopExp.hxx>
 #include <TopExp_Explorer.hxx>
+#include <TopTools_ListIteratorOfListOfShape.hxx>
 #include <TopTools_ListOfShape.hxx>
 #include <TopTools_IndexedMapOfShape.hxx>
 #include <TopoDS.hxx>
 #include <gp_Pln.hxx>
 #include <cmath>
+#include <mutex>
+#include <optional>
+#include <string>
 
 namespace FeatureOps {
 namespace {
-void annotateWithPersistentNames(const TopoDS_Shape &original, const TopoDS_Shape &result) {
-    TopTools_IndexedMapOfShape originalMap;
-    TopTools_IndexedMapOfShape resultMap;
-    TopExp::MapShapes(original, originalMap);
-    TopExp::MapShapes(result, resultMap);
-
-    TDF_Label dummyLabel;
-    TNaming_Builder builder(dummyLabel);
-    for (int i = 1; i <= resultMap.Extent(); ++i) {
-        const TopoDS_Shape &sub = resultMap(i);
-        builder.Generated(sub);
+std::mutex &policyMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+ExecutionPolicy &currentPolicy() {
+    static ExecutionPolicy policy;
+    return policy;
+}
+
+// Size still owed to OCCT's default pool; Init() throws while the pool has running jobs.
+std::optional<int> &pendingPoolSize() {
+    static std::optional<int> threads;
+    return threads;
+}
+
+// Called with policyMutex() held. A busy pool keeps its size until a later call finds it idle.
+void applyPoolSize() {
+    std::optional<int> &pending = pendingPoolSize();
+    if (!pending) return;
+    const Handle(OSD_ThreadPool) &pool = OSD_ThreadPool::DefaultPool();
+    if (pool->IsInUse()) return;
+    try {
+        pool->Init(*pending);
+        pending.reset();
+    } catch (const Standard_ProgramError &) {
+        // Another thread started a job between the check and Init().
+    }
+}
+
+bool parseBool(const std::string &text, bool fallback) {
+    if (text == "true" || text == "1") return true;
+    if (text == "false" || text == "0") return false;
+    return fallback;
+}
+
+void configureBoolean(BRepAlgoAPI_BooleanOperation &op, const BooleanOptions &options) {
+    op.SetRunParallel(options.runParallel);
+    op.SetUseOBB(options.useOBB);
+    if (options.fuzzyValue > 0.0) {
+        op.SetFuzzyValue(options.fuzzyValue);
+    }
+}
+
+TopTools_ListOfShape toList(const std::vector<TopoDS_Shape> &shapes) {
+    TopTools_ListOfShape list;
+    for (const auto &shape : shapes) {
+        if (!shape.IsNull()) {
+            list.Append(shape);
+        }
+    }
+    return list;
+}
+}
+
+void setExecutionPolicy(const ExecutionPolicy &policy) {
+    {
+        std::lock_guard<std::mutex> lock(policyMutex());
+        currentPolicy() = policy;
+        pendingPoolSize() = policy.threads > 0 ? policy.threads : -1;
+        applyPoolSize();
     }
+    BOPAlgo_Options::SetParallelMode(policy.parallelBooleans);
+    QThreadPool::globalInstance()->setMaxThreadCount(policy.threads > 0 ? policy.threads : QThread::idealThreadCount());
+}
 
-    // Use BOPAlgo_Builder images to keep a quick association for downstream consumers.
-    BOPAlgo_Builder mapBuilder;
-    mapBuilder.AddArgument(original);
-    mapBuilder.Perform();
-    const TopTools_IndexedDataMapOfShapeListOfShape &images = mapBuilder.Images();
-    (void)images;
+ExecutionPolicy executionPolicy() {
+    std::lock_guard<std::mutex> lock(policyMutex());
+    applyPoolSize();
+    return currentPolicy();
 }
+
+ExecutionPolicy loadExecutionPolicy(const Settings &settings) {
+    ExecutionPolicy policy;
+    try {
+        policy.threads = std::stoi(settings.value("featureOps/threads", "0"));
+        policy.fuzzyValue = std::stod(settings.value("featureOps/fuzzyValue", "0"));
+    } catch (const std::exception &) {
+        policy.threads = 0;
+        policy.fuzzyValue = 0.0;
+    }
+    policy.parallelBooleans = parseBool(settings.value("featureOps/parallelBooleans"), policy.parallelBooleans);
+    policy.parallelMeshing = parseBool(settings.value("featureOps/parallelMeshing"), policy.parallelMeshing);
+    policy.useOBB = parseBool(settings.value("featureOps/useOBB"), policy.useOBB);
+    return policy;
+}
+
+void saveExecutionPolicy(Settings &settings, const ExecutionPolicy &policy) {
+    settings.setValue("featureOps/threads", std::to_string(policy.threads));
+    settings.setValue("featureOps/parallelBooleans", policy.parallelBooleans ? "true" : "false");
+    settings.setValue("featureOps/parallelMeshing", policy.parallelMeshing ? "true" : "false");
+    settings.setValue("featureOps/useOBB", policy.useOBB ? "true" : "false");
+    settings.setValue("featureOps/fuzzyValue", std::to_string(policy.fuzzyValue));
+}
+
+BooleanOptions booleanOptions() {
+    const ExecutionPolicy policy = executionPolicy();
+    BooleanOptions options;
+    options.runParallel = policy.parallelBooleans;
+    options.useOBB = policy.useOBB;
+    options.fuzzyValue = policy.fuzzyValue;
+    return options;
+}
+
+TopoDS_Shape mesh(const TopoDS_Shape &shape, double linearDeflection, double angularDeflection) {
+    if (shape.IsNull() || linearDeflection <= 0.0) return TopoDS_Shape();
+    // New topology over the same geometry: the triangulation lands on the copy's faces.
+    const TopoDS_Shape copy = BRepBuilderAPI_Copy(shape, Standard_False, Standard_False).Shape();
+    BRepMesh_IncrementalMesh mesher(copy, linearDeflection, Standard_False, angularDeflection,
+                                    executionPolicy().parallelMeshing);
+    return mesher.IsDone() ? copy : TopoDS_Shape();
 }
 
 TopoDS_Shape makeBox(double size) {
-    return BRepPrimAPI_MakeBox(size, size, size).Shape();
+    return ShapeCache::instance().getOrCompute(ShapeCache::Key("box").param(size),
+                                               [&]() { return BRepPrimAPI_MakeBox(size, size, size).Shape(); });
 }
 
 TopoDS_Shape makeCylinder(double radius, double height) {
-    return BRepPrimAPI_MakeCylinder(radius, height).Shape();
+    return ShapeCache::instance().getOrCompute(ShapeCache::Key("cylinder").param(radius).param(height),
+                                               [&]() { return BRepPrimAPI_MakeCylinder(radius, height).Shape(); });
 }
 
 TopoDS_Shape hollowOut(const TopoDS_Shape &shape, double offset) {
-    try {
-        BRepOffsetAPI_MakeThickSolid hollow(shape, TopTools_ListOfShape(), offset);
-        annotateWithPersistentNames(shape, hollow.Shape());
-        return hollow.Shape();
-    } catch (...) {
-        return shape;
-    }
+    const TopoDS_Shape hollowed = ShapeCache::instance().getOrCompute(ShapeCache::Key("hollow").shape(shape).param(offset), [&]() {
+        try {
+            BRepOffsetAPI_MakeThickSolid hollow(shape, TopTools_ListOfShape(), offset);
+            if (!hollow.IsDone()) return TopoDS_Shape();
+            PersistentNaming::record("hollow", shape, hollow);
+            return hollow.Shape();
+        } catch (...) {
+            return TopoDS_Shape();
+        }
+    });
+    // A failed offset leaves the part as it was; null results are not cached, so it is retried.
+    return hollowed.IsNull() ? shape : hollowed;
 }
 
 TopoDS_Shape extrude(const TopoDS_Shape &profile, double height, const gp_Vec &direction) {
@@ -77,66 +188,202 @@ TopoDS_Shape extrude(const TopoDS_Shape &profile, double height, const gp_Vec &d
     vec.Normalize();
     vec *= height;
 
-    TopoDS_Shape prism = BRepPrimAPI_MakePrism(profile, vec).Shape();
-    annotateWithPersistentNames(profile, prism);
-    return prism;
+    const ShapeCache::Key key = ShapeCache::Key("extrude").shape(profile).param(vec.X()).param(vec.Y()).param(vec.Z());
+    return ShapeCache::instance().getOrCompute(key, [&]() {
+        BRepPrimAPI_MakePrism prism(profile, vec);
+        PersistentNaming::record("extrude", profile, prism);
+        return prism.Shape();
+    });
 }
 
-TopoDS_Shape cut(const TopoDS_Shape &base, const TopoDS_Shape &tool) {
-    BRepAlgoAPI_Cut cutter(base, tool);
-    cutter.Build();
-    annotateWithPersistentNames(base, cutter.Shape());
-    return cutter.Shape();
+TopoDS_Shape cut(const TopoDS_Shape &base, const TopoDS_Shape &tool, const Message_ProgressRange &range) {
+    const BooleanOptions options = booleanOptions();
+    const ShapeCache::Key key = ShapeCache::Key("cut").shape(base).shape(tool).param(options.fuzzyValue);
+    return ShapeCache::instance().getOrCompute(key, [&]() {
+        TopTools_ListOfShape arguments;
+        arguments.Append(base);
+        TopTools_ListOfShape tools;
+        tools.Append(tool);
+        BRepAlgoAPI_Cut cutter;
+        cutter.SetArguments(arguments);
+        cutter.SetTools(tools);
+        configureBoolean(cutter, options);
+        cutter.Build(range);
+        if (!cutter.IsDone()) return TopoDS_Shape();
+        arguments.Append(tool);
+        PersistentNaming::record("cut", arguments, cutter);
+        return cutter.Shape();
+    });
 }
 
-TopoDS_Shape revolve(const TopoDS_Shape &profile, const gp_Ax1 &axis, double angle) {
-    TopoDS_Shape revolved = BRepPrimAPI_MakeRevol(profile, axis, angle).Shape();
-    annotateWithPersistentNames(profile, revolved);
-    return revolved;
+TopoDS_Shape cutMany(const TopoDS_Shape &base, const std::vector<TopoDS_Shape> &tools, const BooleanOptions &options,
+                     const Message_ProgressRange &range) {
+    TopTools_ListOfShape toolList = toList(tools);
+    if (base.IsNull() || toolList.IsEmpty()) return base;
+
+    ShapeCache::Key key("cut");
+    key.shape(base).param(options.fuzzyValue);
+    for (const auto &tool : tools) {
+        if (!tool.IsNull()) key.shape(tool);
+    }
+    return ShapeCache::instance().getOrCompute(key, [&]() {
+        TopTools_ListOfShape arguments;
+        arguments.Append(base);
+        BRepAlgoAPI_Cut cutter;
+        cutter.SetArguments(arguments);
+        cutter.SetTools(toolList);
+        configureBoolean(cutter, options);
+        cutter.Build(range);
+        if (!cutter.IsDone()) return TopoDS_Shape();
+
+        arguments.Append(toolList);
+        PersistentNaming::record("cut", arguments, cutter);
+        return cutter.Shape();
+    });
 }
 
-TopoDS_Shape fillet(const TopoDS_Shape &shape, double radius) {
-    BRepFilletAPI_MakeFillet filletMaker(shape);
-    for (TopExp_Explorer it(shape, TopAbs_EDGE); it.More(); it.Next()) {
-        filletMaker.Add(radius, TopoDS::Edge(it.Current()));
+TopoDS_Shape fuseMany(const std::vector<TopoDS_Shape> &shapes, const BooleanOptions &options, const Message_ProgressRange &range) {
+    TopTools_ListOfShape toolList = toList(shapes);
+    if (toolList.IsEmpty()) return TopoDS_Shape();
+    if (toolList.Extent() == 1) return toolList.First();
+
+    ShapeCache::Key key("fuse");
+    key.param(options.fuzzyValue);
+    for (TopTools_ListIteratorOfListOfShape it(toolList); it.More(); it.Next()) {
+        key.shape(it.Value());
     }
-    filletMaker.Build();
-    annotateWithPersistentNames(shape, filletMaker.Shape());
-    return filletMaker.Shape();
-}
-
-TopoDS_Shape chamfer(const TopoDS_Shape &shape, double distance) {
-    BRepOffsetAPI_MakeChamfer chamferMaker(shape);
-    for (TopExp_Explorer it(shape, TopAbs_EDGE); it.More(); it.Next()) {
-        TopoDS_Edge edge = TopoDS::Edge(it.Current());
-        TopoDS_Face face;
-        if (it.Current().ShapeType() == TopAbs_EDGE) {
-            chamferMaker.Add(distance, edge, face);
+    return ShapeCache::instance().getOrCompute(key, [&]() {
+        TopTools_ListOfShape arguments;
+        arguments.Append(toolList.First());
+        TopTools_ListOfShape others = toolList;
+        others.RemoveFirst();
+
+        BRepAlgoAPI_Fuse fuser;
+        fuser.SetArguments(arguments);
+        fuser.SetTools(others);
+        configureBoolean(fuser, options);
+        fuser.Build(range);
+        if (!fuser.IsDone()) return TopoDS_Shape();
+
+        arguments.Append(others);
+        PersistentNaming::record("fuse", arguments, fuser);
+        return fuser.Shape();
+    });
+}
+
+TopoDS_Shape revolve(const TopoDS_Shape &profile, const gp_Ax1 &axis, double angle) {
+    const gp_Pnt &origin = axis.Location();
+    const gp_Dir &dir = axis.Direction();
+    ShapeCache::Key key("revolve");
+    key.shape(profile).param(origin.X()).param(origin.Y()).param(origin.Z());
+    key.param(dir.X()).param(dir.Y()).param(dir.Z()).param(angle);
+    return ShapeCache::instance().getOrCompute(key, [&]() {
+        BRepPrimAPI_MakeRevol revolved(profile, axis, angle);
+        PersistentNaming::record("revolve", profile, revolved);
+        return revolved.Shape();
+    });
+}
+
+TopoDS_Shape fillet(const TopoDS_Shape &shape, double radius, const Message_ProgressRange &range) {
+    const auto index = EdgeIndex::forShape(shape);
+    std::vector<EdgeFillet> edges;
+    edges.reserve(index->edgeCount());
+    for (int e = 0; e < index->edgeCount(); ++e) {
+        if (index->isFilletable(e)) {
+            edges.push_back({e, radius});
         }
     }
-    chamferMaker.Build();
-    annotateWithPersistentNames(shape, chamferMaker.Shape());
-    return chamferMaker.Shape();
+    return fillet(shape, edges, range);
 }
 
-TopoDS_Shape shell(const TopoDS_Shape &shape, double thickness) {
-    TopTools_ListOfShape holes;
-    BRepOffsetAPI_MakeThickSolidByJoin shellMaker(shape, holes, -thickness, 1.0e-3);
-    shellMaker.Build();
-    annotateWithPersistentNames(shape, shellMaker.Shape());
-    return shellMaker.Shape();
+TopoDS_Shape fillet(const TopoDS_Shape &shape, const std::vector<EdgeFillet> &edges, const Message_ProgressRange &range) {
+    if (shape.IsNull() || edges.empty()) return shape;
+    const auto index = EdgeIndex::forShape(shape);
+    std::vector<EdgeFillet> selected;
+    for (const auto &entry : edges) {
+        if (index->isFilletable(entry.edge) && entry.radius > 0.0) selected.push_back(entry);
+    }
+    if (selected.empty()) return shape;
+    ShapeCache::Key key("fillet");
+    key.shape(shape);
+    for (const auto &entry : selected) {
+        key.edge(index->edge(entry.edge)).param(entry.radius);
+    }
+    return ShapeCache::instance().getOrCompute(key, [&]() {
+        BRepFilletAPI_MakeFillet filletMaker(shape);
+        for (const auto &entry : selected) {
+            filletMaker.Add(entry.radius, index->edge(entry.edge));
+        }
+        filletMaker.Build(range);
+        if (!filletMaker.IsDone()) return TopoDS_Shape();
+        PersistentNaming::record("fillet", shape, filletMaker);
+        return filletMaker.Shape();
+    });
+}
+
+TopoDS_Shape chamfer(const TopoDS_Shape &shape, double distance, const Message_ProgressRange &range) {
+    const auto index = EdgeIndex::forShape(shape);
+    std::vector<int> edges;
+    edges.reserve(index->edgeCount());
+    for (int e = 0; e < index->edgeCount(); ++e) {
+        if (index->isFilletable(e)) {
+            edges.push_back(e);
+        }
+    }
+    return chamfer(shape, edges, distance, range);
 }
 
-TopoDS_Shape draft(const TopoDS_Shape &shape, const gp_Dir &dir, double angleDegrees) {
-    BRepOffsetAPI_DraftAngle draftMaker(shape);
-    gp_Dir direction = dir;
-    for (TopExp_Explorer it(shape, TopAbs_FACE); it.More(); it.Next()) {
-        TopoDS_Face face = TopoDS::Face(it.Current());
-        draftMaker.Add(face, direction, angleDegrees * (M_PI / 180.0));
+TopoDS_Shape chamfer(const TopoDS_Shape &shape, const std::vector<int> &edges, double distance, const Message_ProgressRange &range) {
+    if (shape.IsNull() || edges.empty() || distance <= 0.0) return shape;
+    const auto index = EdgeIndex::forShape(shape);
+    std::vector<int> selected;
+    for (int e : edges) {
+        if (index->isFilletable(e)) selected.push_back(e);
     }
-    draftMaker.Build();
-    annotateWithPersistentNames(shape, draftMaker.Shape());
-    return draftMaker.Shape();
+    if (selected.empty()) return shape;
+    ShapeCache::Key key("chamfer");
+    key.shape(shape).param(distance);
+    for (int e : selected) {
+        key.edge(index->edge(e));
+    }
+    return ShapeCache::instance().getOrCompute(key, [&]() {
+        BRepFilletAPI_MakeChamfer chamferMaker(shape);
+        for (int e : selected) {
+            chamferMaker.Add(distance, distance, index->edge(e), index->adjacentFace(e));
+        }
+        chamferMaker.Build(range);
+        if (!chamferMaker.IsDone()) return TopoDS_Shape();
+        PersistentNaming::record("chamfer", shape, chamferMaker);
+        return chamferMaker.Shape();
+    });
+}
+
+TopoDS_Shape shell(const TopoDS_Shape &shape, double thickness, const Message_ProgressRange &range) {
+    return ShapeCache::instance().getOrCompute(ShapeCache::Key("shell").shape(shape).param(thickness), [&]() {
+        TopTools_ListOfShape holes;
+        BRepOffsetAPI_MakeThickSolidByJoin shellMaker(shape, holes, -thickness, 1.0e-3);
+        shellMaker.Build(range);
+        if (!shellMaker.IsDone()) return TopoDS_Shape();
+        PersistentNaming::record("shell", shape, shellMaker);
+        return shellMaker.Shape();
+    });
+}
+
+TopoDS_Shape draft(const TopoDS_Shape &shape, const gp_Dir &dir, double angleDegrees, const Message_ProgressRange &range) {
+    ShapeCache::Key key("draft");
+    key.shape(shape).param(dir.X()).param(dir.Y()).param(dir.Z()).param(angleDegrees);
+    return ShapeCache::instance().getOrCompute(key, [&]() {
+        BRepOffsetAPI_DraftAngle draftMaker(shape);
+        gp_Dir direction = dir;
+        for (TopExp_Explorer it(shape, TopAbs_FACE); it.More(); it.Next()) {
+            TopoDS_Face face = TopoDS::Face(it.Current());
+            draftMaker.Add(face, direction, angleDegrees * (M_PI / 180.0));
+        }
+        draftMaker.Build(range);
+        if (!draftMaker.IsDone()) return TopoDS_Shape();
+        PersistentNaming::record("draft", shape, draftMaker);
+        return draftMaker.Shape();
+    });
 }
 
 } // namespace FeatureOps
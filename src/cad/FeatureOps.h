@@ -5,19 +5,65 @@
 #include <gp_Ax1.hxx>
 #include <gp_Dir.hxx>
 #include <gp_Vec.hxx>
+#include <Message_ProgressRange.hxx>
 #include <QString>
+#include <vector>
+
+class Settings;
 
 namespace FeatureOps {
+struct BooleanOptions {
+    bool runParallel{true};
+    bool useOBB{true};
+    double fuzzyValue{0.0};  // 0 keeps OCCT's default tolerance handling
+};
+
+// Process-wide switches for OCCT's parallel modes. Booleans and meshing honour them;
+// fillet, chamfer, shell and draft have no parallel implementation in OCCT.
+struct ExecutionPolicy {
+    int threads{0};  // 0 uses one worker per hardware thread
+    bool parallelBooleans{true};
+    bool parallelMeshing{true};
+    bool useOBB{true};
+    double fuzzyValue{0.0};
+};
+
+// OCCT's pool is resized right away when idle, otherwise on a later call once it is.
+void setExecutionPolicy(const ExecutionPolicy &policy);
+ExecutionPolicy executionPolicy();
+ExecutionPolicy loadExecutionPolicy(const Settings &settings);
+void saveExecutionPolicy(Settings &settings, const ExecutionPolicy &policy);
+BooleanOptions booleanOptions();
+
+// Edge numbers refer to EdgeIndex::forShape(shape) of the shape being filleted.
+struct EdgeFillet {
+    int edge{0};
+    double radius{0.0};
+};
+
 TopoDS_Shape makeBox(double size);
 TopoDS_Shape makeCylinder(double radius, double height);
 TopoDS_Shape hollowOut(const TopoDS_Shape &shape, double offset);
 
 TopoDS_Shape extrude(const TopoDS_Shape &profile, double height, const gp_Vec &direction = gp_Vec(0, 0, 1));
-TopoDS_Shape cut(const TopoDS_Shape &base, const TopoDS_Shape &tool);
+TopoDS_Shape cut(const TopoDS_Shape &base, const TopoDS_Shape &tool, const Message_ProgressRange &range = Message_ProgressRange());
+// One multi-argument boolean instead of one pass per tool.
+TopoDS_Shape cutMany(const TopoDS_Shape &base, const std::vector<TopoDS_Shape> &tools,
+                     const BooleanOptions &options = booleanOptions(),
+                     const Message_ProgressRange &range = Message_ProgressRange());
+TopoDS_Shape fuseMany(const std::vector<TopoDS_Shape> &shapes, const BooleanOptions &options = booleanOptions(),
+                      const Message_ProgressRange &range = Message_ProgressRange());
 TopoDS_Shape revolve(const TopoDS_Shape &profile, const gp_Ax1 &axis, double angle);
-TopoDS_Shape fillet(const TopoDS_Shape &shape, double radius);
-TopoDS_Shape chamfer(const TopoDS_Shape &shape, double distance);
-TopoDS_Shape shell(const TopoDS_Shape &shape, double thickness);
-TopoDS_Shape draft(const TopoDS_Shape &shape, const gp_Dir &dir, double angleDegrees);
+TopoDS_Shape fillet(const TopoDS_Shape &shape, double radius, const Message_ProgressRange &range = Message_ProgressRange());
+TopoDS_Shape fillet(const TopoDS_Shape &shape, const std::vector<EdgeFillet> &edges, const Message_ProgressRange &range = Message_ProgressRange());
+TopoDS_Shape chamfer(const TopoDS_Shape &shape, double distance, const Message_ProgressRange &range = Message_ProgressRange());
+TopoDS_Shape chamfer(const TopoDS_Shape &shape, const std::vector<int> &edges, double distance,
+                     const Message_ProgressRange &range = Message_ProgressRange());
+TopoDS_Shape shell(const TopoDS_Shape &shape, double thickness, const Message_ProgressRange &range = Message_ProgressRange());
+// Triangulates a copy with BRepMesh_IncrementalMesh, in parallel when the policy allows, and
+// returns it (null on failure). Results of this namespace are shared through ShapeCache and
+// are never meshed in place.
+TopoDS_Shape mesh(const TopoDS_Shape &shape, double linearDeflection, double angularDeflection = 0.5);
+TopoDS_Shape draft(const TopoDS_Shape &shape, const gp_Dir &dir, double angleDegrees, const Message_ProgressRange &range = Message_ProgressRange());
 }
 
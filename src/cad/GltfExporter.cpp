@@ -1,35 +1,223 @@
 #include "GltfExporter.h"
+#include "TessellationService.h"
+#include "XcafDocumentPool.h"
 
+#include <BRepBndLib.hxx>
+#include <BRep_Tool.hxx>
+#include <Bnd_Box.hxx>
+#include <Message_ProgressRange.hxx>
+#include <Poly_Triangulation.hxx>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
 #include <RWGltf_CafWriter.hxx>
-#include <RWMesh_CafReader.hxx>
-#include <XCAFApp_Application.hxx>
-#include <XCAFDoc_DocumentTool.hxx>
+#include <Standard_Version.hxx>
+#include <TColStd_IndexedDataMapOfStringString.hxx>
 #include <TDocStd_Document.hxx>
-#include <Message_ProgressRange.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Iterator.hxx>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
 #include "../utils/Logging.h"
 
-bool GltfExporter::exportShape(const QString &path, const TopoDS_Shape &shape) const {
-    if (shape.IsNull()) {
-        Logging::warn(QStringLiteral("Cannot export glTF: no geometry for %1").arg(path));
-        return false;
+#if OCC_VERSION_HEX >= 0x070700
+#include <RWGltf_DracoParameters.hxx>
+#endif
+
+namespace {
+void collectLeaves(const TopoDS_Shape &shape, std::vector<TopoDS_Shape> &leaves) {
+    if (shape.ShapeType() != TopAbs_COMPOUND) {
+        leaves.push_back(shape);
+        return;
+    }
+    for (TopoDS_Iterator it(shape); it.More(); it.Next()) {
+        collectLeaves(it.Value(), leaves);
+    }
+}
+
+int triangleCount(const TopoDS_Shape &shape) {
+    int triangles = 0;
+    for (TopExp_Explorer it(shape, TopAbs_FACE); it.More(); it.Next()) {
+        TopLoc_Location location;
+        const Handle(Poly_Triangulation) mesh = BRep_Tool::Triangulation(TopoDS::Face(it.Current()), location);
+        triangles += mesh.IsNull() ? 0 : mesh->NbTriangles();
     }
-    Handle(XCAFApp_Application) app = XCAFApp_Application::GetApplication();
-    Handle(TDocStd_Document) doc;
-    app->NewDocument("MDTV-CAF", doc);
+    return triangles;
+}
 
-    Handle(XCAFDoc_ShapeTool) shapeTool = XCAFDoc_DocumentTool::ShapeTool(doc->Main());
+// Adds `shape` to the document as an assembly of its pieces: each distinct piece is one
+// part and located repeats become components, so the writer emits one mesh per part. The
+// parts are the service's meshed copies. Returns the number of triangles written.
+int addInstanced(const Handle(XCAFDoc_ShapeTool) &tool, const TopoDS_Shape &shape,
+                 const TessellationService::Parameters &parameters) {
+    std::vector<TopoDS_Shape> leaves;
+    collectLeaves(shape, leaves);
+    std::vector<TopoDS_Shape> parts;
+    std::vector<std::size_t> leafPart;
+    if (leaves.size() <= 1) {
+        parts.push_back(shape);
+    } else {
+        std::unordered_map<const TopoDS_TShape *, std::size_t> partOf;
+        for (const auto &leaf : leaves) {
+            const auto inserted = partOf.emplace(leaf.TShape().get(), parts.size());
+            if (inserted.second) {
+                parts.push_back(leaf.Located(TopLoc_Location()));
+            }
+            leafPart.push_back(inserted.first->second);
+        }
+    }
+    const std::vector<TopoDS_Shape> meshed = TessellationService::instance().tessellateAll(parts, parameters);
+    for (std::size_t i = 0; i < parts.size(); ++i) {
+        if (!meshed[i].IsNull()) parts[i] = meshed[i];
+    }
+
+    if (leaves.size() <= 1) {
+        tool->AddShape(parts.front(), Standard_False);
+        return triangleCount(parts.front());
+    }
+    std::vector<TDF_Label> labels;
+    labels.reserve(parts.size());
+    for (const auto &part : parts) {
+        labels.push_back(tool->AddShape(part, Standard_False));
+    }
+    const TDF_Label assembly = tool->NewShape();
+    int triangles = 0;
+    for (std::size_t i = 0; i < leaves.size(); ++i) {
+        tool->AddComponent(assembly, labels[leafPart[i]], leaves[i].Location());
+        triangles += triangleCount(parts[leafPart[i]]);
+    }
+    tool->UpdateAssemblies();
+    return triangles;
+}
+
+bool writeFile(XcafDocumentPool::Lease &lease, const GltfExporter::Options &options, const QString &path,
+               const TopoDS_Shape &shape, int *triangles) {
     if (shape.IsNull()) {
+        Logging::warn(QStringLiteral("Cannot export glTF: no geometry for %1").arg(path));
         return false;
     }
-    shapeTool->AddShape(shape);
+    const int meshed = addInstanced(lease.shapeTool(), shape,
+                                    {options.linearDeflection, options.angularDeflection, options.relativeDeflection});
+    if (triangles) *triangles = meshed;
 
-    RWGltf_CafWriter writer(path.toStdString().c_str(), false);
+    const bool binary = options.binary || path.endsWith(QStringLiteral(".glb"), Qt::CaseInsensitive);
+    RWGltf_CafWriter writer(path.toStdString().c_str(), binary);
     writer.SetCoordinateSystem(RWGltf_CafWriter::CoordinateSystem_ZUp);
-    Message_ProgressRange range;
-    const bool ok = writer.Perform(doc, range);
+    writer.SetMergeFaces(options.mergeFaces);
+    writer.SetSplitIndices16(options.mergeFaces);
+#if OCC_VERSION_HEX >= 0x070700
+    if (options.draco) {
+        RWGltf_DracoParameters draco;
+        draco.DracoCompression = true;
+        draco.CompressionLevel = options.compressionLevel;
+        draco.QuantizePositionBits = options.positionBits;
+        draco.QuantizeNormalBits = options.normalBits;
+        writer.SetCompressionParameters(draco);
+        writer.SetParallel(true);
+    }
+#else
+    if (options.draco) {
+        Logging::warn(QStringLiteral("Draco compression needs OCCT 7.7; writing %1 uncompressed").arg(path));
+    }
+#endif
+    const TColStd_IndexedDataMapOfStringString fileInfo;
+    const bool ok = writer.Perform(lease.document(), fileInfo, Message_ProgressRange());
     if (!ok) {
         Logging::warn(QStringLiteral("Failed to write glTF file: %1").arg(path));
     }
+    if (!lease.reset()) {
+        lease = XcafDocumentPool::instance().acquire();
+    }
     return ok;
 }
+}
+
+GltfExporter::GltfExporter() = default;
+
+GltfExporter::GltfExporter(const Options &options) : m_options(options) {}
+
+bool GltfExporter::exportShape(const QString &path, const TopoDS_Shape &shape) const {
+    return exportShapes({{path, shape}}) == 1;
+}
+
+int GltfExporter::exportShapes(const std::vector<std::pair<QString, TopoDS_Shape>> &files) const {
+    XcafDocumentPool::Lease lease = XcafDocumentPool::instance().acquire();
+    int written = 0;
+    for (const auto &file : files) {
+        written += writeFile(lease, m_options, file.first, file.second, nullptr) ? 1 : 0;
+    }
+    return written;
+}
+
+std::vector<GltfExporter::LodLevel> GltfExporter::defaultLevels(const TopoDS_Shape &shape) {
+    Bnd_Box box;
+    BRepBndLib::Add(shape, box);
+    const double diagonal = box.IsVoid() ? 1.0 : std::sqrt(box.SquareExtent());
+    return {
+        {diagonal * 0.0005, 0.2, 1.0},
+        {diagonal * 0.002, 0.4, 1.0},
+        {diagonal * 0.008, 0.8, 1.0},
+    };
+}
 
+QString GltfExporter::exportLods(const QString &path, const TopoDS_Shape &shape, std::vector<LodLevel> levels) const {
+    if (shape.IsNull()) {
+        Logging::warn(QStringLiteral("Cannot export glTF: no geometry for %1").arg(path));
+        return QString();
+    }
+    if (levels.empty()) {
+        levels = defaultLevels(shape);
+    }
+    // Finest first. Every level meshes its own copy of the shape, so a finer level never
+    // satisfies a coarser one's deflection and the caller's shape is not touched.
+    std::sort(levels.begin(), levels.end(), [](const LodLevel &a, const LodLevel &b) { return a.linearDeflection < b.linearDeflection; });
+
+    XcafDocumentPool::Lease lease = XcafDocumentPool::instance().acquire();
+    const QFileInfo info(path);
+    const QString suffix = info.suffix().isEmpty() ? QStringLiteral("glb") : info.suffix();
+    QJsonArray entries;
+    for (int i = 0; i < static_cast<int>(levels.size()); ++i) {
+        const LodLevel &level = levels[i];
+        Options options = m_options;
+        options.linearDeflection = level.linearDeflection;
+        options.angularDeflection = level.angularDeflection;
+        options.relativeDeflection = false;
+
+        const QString fileName = QStringLiteral("%1_lod%2.%3").arg(info.completeBaseName()).arg(i).arg(suffix);
+        int triangles = 0;
+        if (!writeFile(lease, options, info.dir().filePath(fileName), shape, &triangles)) {
+            return QString();
+        }
+        QJsonObject entry;
+        entry["level"] = i;
+        entry["file"] = fileName;
+        entry["linearDeflection"] = level.linearDeflection;
+        entry["angularDeflection"] = level.angularDeflection;
+        entry["geometricError"] = level.linearDeflection;
+        entry["screenSpaceError"] = level.screenSpaceError;
+        entry["triangles"] = triangles;
+        entries.append(entry);
+    }
+
+    QJsonObject manifest;
+    manifest["format"] = QStringLiteral("aegis-gltf-lod");
+    manifest["version"] = 1;
+    manifest["levels"] = entries;
+    const QString manifestPath = info.dir().filePath(info.completeBaseName() + QStringLiteral(".lod.json"));
+    QSaveFile file(manifestPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        Logging::warn(QStringLiteral("Cannot write LOD manifest: %1").arg(manifestPath));
+        return QString();
+    }
+    file.write(QJsonDocument(manifest).toJson());
+    if (!file.commit()) {
+        Logging::warn(QStringLiteral("Cannot write LOD manifest: %1").arg(manifestPath));
+        return QString();
+    }
+    return manifestPath;
+}
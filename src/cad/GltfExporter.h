@@ -2,9 +2,53 @@
 
 #include <QString>
 #include <TopoDS_Shape.hxx>
+#include <utility>
+#include <vector>
 
+// Meshes shapes with a chosen deflection and writes them as glTF or GLB. Located repeats of
+// one part are meshed once and written as instances of a single mesh.
 class GltfExporter {
 public:
+    struct Options {
+        double linearDeflection{0.1};
+        double angularDeflection{0.5};
+        bool relativeDeflection{false};
+        bool binary{false};        // GLB; implied by a .glb path
+        bool mergeFaces{true};     // one primitive per part instead of one per face
+        // Draco compression with quantized attributes; needs OCCT built with Draco.
+        bool draco{false};
+        int positionBits{14};
+        int normalBits{10};
+        int compressionLevel{7};
+    };
+
+    // One detail level of exportLods(). A viewer shows the coarsest level whose geometric
+    // error (the linear deflection), projected to the screen, stays below screenSpaceError.
+    struct LodLevel {
+        double linearDeflection{0.1};
+        double angularDeflection{0.5};
+        double screenSpaceError{1.0};  // pixels
+    };
+
+    GltfExporter();
+    explicit GltfExporter(const Options &options);
+
+    const Options &options() const { return m_options; }
+    void setOptions(const Options &options) { m_options = options; }
+
     bool exportShape(const QString &path, const TopoDS_Shape &shape) const;
-};
+    // Writes one glTF file per (path, shape), reusing a single pooled document. Returns the
+    // number of files written; failures are logged.
+    int exportShapes(const std::vector<std::pair<QString, TopoDS_Shape>> &files) const;
+
+    // Writes one file per level beside `path` (name_lod0.ext is the finest) plus a JSON
+    // manifest, name.lod.json, with each level's file, deflections, triangle count and
+    // screen-space error threshold. Levels default to defaultLevels(shape). Returns the
+    // manifest path, or an empty string on failure. The shape itself is not meshed.
+    QString exportLods(const QString &path, const TopoDS_Shape &shape, std::vector<LodLevel> levels = {}) const;
+    // Three levels with deflections relative to the bounding-box diagonal.
+    static std::vector<LodLevel> defaultLevels(const TopoDS_Shape &shape);
 
+private:
+    Options m_options;
+};
@@ -0,0 +1,336 @@
+#include "LazyShape.h"
+
+#include <BRepTools.hxx>
+#include <BRep_Builder.hxx>
+#include <BinTools.hxx>
+#include <Standard_Failure.hxx>
+#include <TopoDS_TShape.hxx>
+#include <algorithm>
+#include <istream>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+struct LazyShape::State {
+    ~State();
+    // Pulls the bytes from the source on first need and drops the source afterwards.
+    void fetch() {
+        if (data.isEmpty() && source) {
+            data = source();
+            source = nullptr;
+        }
+    }
+    // Someone besides this state holds the decoded TShape. Dropping it would free nothing, and
+    // the next decode would be a new TShape that misses every cache keyed on the old one.
+    bool heldElsewhere() const { return !shape.IsNull() && shape.TShape()->GetRefCount() > 1; }
+
+    std::mutex mutex;
+    QByteArray data;
+    std::function<QByteArray()> source;
+    // Set while `data` may point into the owner's memory rather than its own.
+    std::shared_ptr<const void> owner;
+    LazyShape::Encoding encoding{LazyShape::Encoding::Binary};
+    TopoDS_Shape shape;
+    bool loaded{false};
+
+    // Guarded by the resident set's mutex.
+    bool resident{false};
+    std::list<std::weak_ptr<State>>::iterator position;
+};
+
+namespace {
+constexpr std::size_t kDefaultBudget = std::size_t{256} * 1024 * 1024;
+
+// Read-only stream over bytes owned elsewhere, so decoding never copies the input.
+class MemoryStreamBuf : public std::streambuf {
+public:
+    MemoryStreamBuf(const char *data, qint64 size) {
+        char *begin = const_cast<char *>(data);
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    pos_type seekoff(off_type offset, std::ios_base::seekdir dir, std::ios_base::openmode) override {
+        char *target = dir == std::ios_base::beg ? eback() + offset : dir == std::ios_base::cur ? gptr() + offset : egptr() + offset;
+        if (target < eback() || target > egptr()) return pos_type(off_type(-1));
+        setg(eback(), target, egptr());
+        return pos_type(target - eback());
+    }
+
+    pos_type seekpos(pos_type position, std::ios_base::openmode mode) override {
+        return seekoff(off_type(position), std::ios_base::beg, mode);
+    }
+};
+
+// Decoded shapes that can be dropped, most recently used first. Sizes are measured by the
+// serialized form, which tracks the decoded footprint closely enough for eviction. Shapes
+// still held outside their state are skipped, so the set may stay above budget until they
+// are let go. Lock order is the set's mutex, then a state's.
+class ResidentSet {
+public:
+    static ResidentSet &instance() {
+        static ResidentSet set;
+        return set;
+    }
+
+    void touch(const std::shared_ptr<LazyShape::State> &state, std::size_t bytes) {
+        std::vector<std::shared_ptr<LazyShape::State>> victims;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (state->resident) {
+                m_entries.splice(m_entries.begin(), m_entries, state->position);
+            } else {
+                m_entries.push_front(state);
+                state->position = m_entries.begin();
+                state->resident = true;
+                m_bytes += bytes;
+            }
+            collectVictims(victims);
+        }
+        // Released outside the lock: dropping the last reference to a state re-enters forget().
+    }
+
+    void forget(LazyShape::State &state, std::size_t bytes) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!state.resident) return;
+        m_entries.erase(state.position);
+        state.resident = false;
+        m_bytes -= bytes;
+    }
+
+    void setBudget(std::size_t bytes) {
+        std::vector<std::shared_ptr<LazyShape::State>> victims;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_budget = bytes;
+            collectVictims(victims);
+        }
+    }
+
+    std::size_t bytes() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_bytes;
+    }
+
+private:
+    void collectVictims(std::vector<std::shared_ptr<LazyShape::State>> &victims) {
+        auto it = m_entries.end();
+        while (m_bytes > m_budget && it != m_entries.begin()) {
+            --it;
+            std::shared_ptr<LazyShape::State> victim = it->lock();
+            // An expired entry belongs to a state being destroyed; its destructor unlinks it.
+            if (!victim) continue;
+            std::lock_guard<std::mutex> lock(victim->mutex);
+            if (victim->heldElsewhere()) continue;
+            victim->shape.Nullify();
+            victim->loaded = false;
+            it = m_entries.erase(it);
+            victim->resident = false;
+            m_bytes -= static_cast<std::size_t>(victim->data.size());
+            victims.push_back(std::move(victim));
+        }
+    }
+
+    mutable std::mutex m_mutex;
+    std::list<std::weak_ptr<LazyShape::State>> m_entries;
+    std::size_t m_bytes{0};
+    std::size_t m_budget{kDefaultBudget};
+};
+}
+
+namespace {
+// States created with an owner, so detachFrom() can find the ones borrowing from it.
+class BorrowingStates {
+public:
+    static BorrowingStates &instance() {
+        static BorrowingStates states;
+        return states;
+    }
+
+    void add(const std::shared_ptr<LazyShape::State> &state) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_states.erase(std::remove_if(m_states.begin(), m_states.end(),
+                                      [](const std::weak_ptr<LazyShape::State> &entry) { return entry.expired(); }),
+                       m_states.end());
+        m_states.push_back(state);
+    }
+
+    std::vector<std::shared_ptr<LazyShape::State>> live() const {
+        std::vector<std::shared_ptr<LazyShape::State>> states;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto &entry : m_states) {
+            if (auto state = entry.lock()) states.push_back(std::move(state));
+        }
+        return states;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::vector<std::weak_ptr<LazyShape::State>> m_states;
+};
+}
+
+LazyShape::State::~State() {
+    ResidentSet::instance().forget(*this, static_cast<std::size_t>(data.size()));
+}
+
+LazyShape::LazyShape(const TopoDS_Shape &shape) {
+    if (shape.IsNull()) return;
+    m_state = std::make_shared<State>();
+    m_state->shape = shape;
+    m_state->loaded = true;
+}
+
+LazyShape LazyShape::fromBytes(QByteArray data, Encoding encoding) {
+    LazyShape lazy;
+    if (data.isEmpty()) return lazy;
+    lazy.m_state = std::make_shared<State>();
+    lazy.m_state->data = std::move(data);
+    lazy.m_state->encoding = encoding;
+    return lazy;
+}
+
+LazyShape LazyShape::fromSource(std::function<QByteArray()> source, Encoding encoding, std::shared_ptr<const void> owner) {
+    LazyShape lazy;
+    if (!source) return lazy;
+    lazy.m_state = std::make_shared<State>();
+    lazy.m_state->source = std::move(source);
+    lazy.m_state->encoding = encoding;
+    if (owner) {
+        lazy.m_state->owner = std::move(owner);
+        BorrowingStates::instance().add(lazy.m_state);
+    }
+    return lazy;
+}
+
+void LazyShape::detachFrom(const void *owner) {
+    if (!owner) return;
+    for (const auto &state : BorrowingStates::instance().live()) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->owner.get() != owner) continue;
+        if (!state->data.isEmpty()) {
+            state->data = QByteArray(state->data.constData(), state->data.size());
+        }
+        // A source not pulled yet is pulled now, while the owner can still serve it. The
+        // owner is expected to hand out copies by this point.
+        state->fetch();
+        state->source = nullptr;
+        state->owner.reset();
+    }
+}
+
+QByteArray LazyShape::encode(const TopoDS_Shape &shape, Encoding encoding) {
+    if (shape.IsNull()) return QByteArray();
+    std::ostringstream stream(std::ios::out | std::ios::binary);
+    if (encoding == Encoding::AsciiBrep) {
+        BRepTools::Write(shape, stream);
+    } else {
+        BinTools::Write(shape, stream);
+    }
+    const std::string data = stream.str();
+    if (encoding == Encoding::CompressedBinary) {
+        return qCompress(reinterpret_cast<const uchar *>(data.data()), static_cast<qsizetype>(data.size()));
+    }
+    return QByteArray(data.data(), static_cast<qsizetype>(data.size()));
+}
+
+TopoDS_Shape LazyShape::decode(const char *data, qint64 size, Encoding encoding) {
+    if (size <= 0) return TopoDS_Shape();
+    QByteArray inflated;
+    if (encoding == Encoding::CompressedBinary) {
+        inflated = qUncompress(reinterpret_cast<const uchar *>(data), static_cast<qsizetype>(size));
+        if (inflated.isEmpty()) return TopoDS_Shape();
+        data = inflated.constData();
+        size = inflated.size();
+    }
+    MemoryStreamBuf buffer(data, size);
+    std::istream stream(&buffer);
+    TopoDS_Shape shape;
+    try {
+        if (encoding == Encoding::AsciiBrep) {
+            BRep_Builder builder;
+            if (!BRepTools::Read(shape, stream, builder)) return TopoDS_Shape();
+        } else {
+            BinTools::Read(shape, stream);
+        }
+    } catch (const Standard_Failure &) {
+        return TopoDS_Shape();
+    }
+    return shape;
+}
+
+TopoDS_Shape LazyShape::get() const {
+    if (!m_state) return TopoDS_Shape();
+    TopoDS_Shape shape;
+    std::size_t bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        if (!m_state->loaded) {
+            m_state->fetch();
+            m_state->shape = decode(m_state->data.constData(), m_state->data.size(), m_state->encoding);
+            m_state->loaded = true;
+        }
+        shape = m_state->shape;
+        bytes = static_cast<std::size_t>(m_state->data.size());
+    }
+    if (bytes > 0) {
+        ResidentSet::instance().touch(m_state, bytes);
+    }
+    return shape;
+}
+
+bool LazyShape::isNull() const {
+    if (!m_state) return true;
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    return m_state->data.isEmpty() && !m_state->source && m_state->shape.IsNull();
+}
+
+bool LazyShape::isLoaded() const {
+    if (!m_state) return false;
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    return m_state->loaded;
+}
+
+QByteArray LazyShape::bytes() const {
+    if (!m_state) return QByteArray();
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    m_state->fetch();
+    if (m_state->data.isEmpty()) {
+        m_state->data = encode(m_state->shape, m_state->encoding);
+    }
+    if (m_state->owner) {
+        return QByteArray(m_state->data.constData(), m_state->data.size());
+    }
+    return m_state->data;
+}
+
+LazyShape::Encoding LazyShape::encoding() const {
+    if (!m_state) return Encoding::Binary;
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    return m_state->encoding;
+}
+
+void LazyShape::release() const {
+    if (!m_state) return;
+    const std::size_t size = static_cast<std::size_t>(bytes().size());
+    if (size == 0) return;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        if (m_state->heldElsewhere()) return;
+        m_state->shape.Nullify();
+        m_state->loaded = false;
+    }
+    ResidentSet::instance().forget(*m_state, size);
+}
+
+void LazyShape::setResidentBudget(std::size_t bytes) {
+    ResidentSet::instance().setBudget(bytes);
+}
+
+std::size_t LazyShape::residentBytes() {
+    return ResidentSet::instance().bytes();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QByteArray>
+#include <TopoDS_Shape.hxx>
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+// Shape handle that may hold only its serialized form and decode it on first access.
+// Copies share one state. Decoded shapes backed by a serialized form join a process-wide
+// LRU and are dropped back to bytes once the resident budget is exceeded, unless a
+// TopoDS_Shape obtained from get() is still alive: a decoded TShape is kept while anything
+// refers to it, so caches keyed on its identity (feature trees, edge indices, viewers) stay valid.
+class LazyShape {
+public:
+    enum class Encoding {
+        AsciiBrep,         // BRepTools text, as in older JSON files
+        Binary,            // BinTools
+        CompressedBinary   // BinTools wrapped in qCompress
+    };
+
+    LazyShape() = default;
+    LazyShape(const TopoDS_Shape &shape);
+    static LazyShape fromBytes(QByteArray data, Encoding encoding);
+    // Bytes are pulled from `source` on first use, e.g. out of a mapped file. The source may
+    // return QByteArray::fromRawData over memory of `owner` instead of copying; the handle
+    // keeps `owner` alive while it holds such bytes.
+    static LazyShape fromSource(std::function<QByteArray()> source, Encoding encoding,
+                                std::shared_ptr<const void> owner = nullptr);
+    // Copies bytes borrowed from `owner` into every handle's own storage, pulling sources
+    // not used yet, and lets go of the owner, e.g. before the mapped file is replaced.
+    static void detachFrom(const void *owner);
+
+    static QByteArray encode(const TopoDS_Shape &shape, Encoding encoding);
+    static TopoDS_Shape decode(const char *data, qint64 size, Encoding encoding);
+
+    // Decodes on first use; a copy of the handle stays valid after the geometry is released.
+    TopoDS_Shape get() const;
+    // True when there is neither geometry nor serialized data; never decodes.
+    bool isNull() const;
+    bool isLoaded() const;
+    // Serialized form; a handle built from a shape encodes it as Binary once and keeps it.
+    // Always owns its data, even when the handle itself borrows it.
+    QByteArray bytes() const;
+    Encoding encoding() const;
+    // Drops the decoded geometry if it can be restored from bytes and nothing else holds it.
+    void release() const;
+
+    static void setResidentBudget(std::size_t bytes);
+    static std::size_t residentBytes();
+
+    struct State;
+
+private:
+    std::shared_ptr<State> m_state;
+};
@@ -1,126 +1,278 @@
 #include "PartRegistry.h"
 #include "FeatureOps.h"
+#include "ShapeArchive.h"
+#include "../utils/Logging.h"
 
-#include <BRep_Builder.hxx>
-#include <BRepTools.hxx>
-#include <QBuffer>
 #include <QByteArray>
 #include <QFile>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QRandomGenerator>
+#include <QSaveFile>
 #include <QtGlobal>
-#include <sstream>
+#include <algorithm>
+#include <unordered_set>
 
 PartRegistry::PartRegistry() = default;
 
+QJsonObject PartRegistry::entryToJson(const Entry &entry) {
+    QJsonObject obj;
+    obj["id"] = entry.id;
+    obj["name"] = entry.name;
+    obj["visible"] = entry.visible;
+    obj["material"] = entry.material;
+    obj["density"] = entry.density;
+    obj["yieldStrength"] = entry.yieldStrength;
+    return obj;
+}
+
+PartRegistry::Entry PartRegistry::entryFromJson(const QJsonObject &obj) {
+    Entry entry;
+    entry.id = obj["id"].toString();
+    entry.name = obj["name"].toString();
+    entry.visible = obj["visible"].toBool(true);
+    entry.material = obj.value("material").toString(entry.material);
+    entry.density = obj.value("density").toDouble(entry.density);
+    entry.yieldStrength = obj.value("yieldStrength").toDouble(entry.yieldStrength);
+    return entry;
+}
+
+QString PartRegistry::newId() const {
+    QString id;
+    do {
+        id = QString::number(QRandomGenerator::global()->generate64(), 16);
+    } while (m_index.count(id) > 0);
+    return id;
+}
+
+PartRegistry::Entry *PartRegistry::findMutable(const QString &id) {
+    const auto it = m_index.find(id);
+    return it == m_index.end() ? nullptr : &m_parts[it->second];
+}
+
+const PartRegistry::Entry *PartRegistry::find(const QString &id) const {
+    const auto it = m_index.find(id);
+    return it == m_index.end() ? nullptr : &m_parts[it->second];
+}
+
+void PartRegistry::record(const QString &id, bool removed) {
+    m_log.push_back({m_generation, id, removed});
+    if (m_log.size() >= m_compactAt) {
+        compactLog();
+    }
+}
+
+// Keeps only the latest record per id, so the log stays proportional to the ids it has seen.
+void PartRegistry::compactLog() {
+    std::unordered_map<QString, std::size_t> latest;
+    latest.reserve(m_log.size());
+    for (std::size_t i = 0; i < m_log.size(); ++i) {
+        latest[m_log[i].id] = i;
+    }
+    std::vector<ChangeRecord> compacted;
+    compacted.reserve(latest.size());
+    for (std::size_t i = 0; i < m_log.size(); ++i) {
+        if (latest[m_log[i].id] == i) {
+            compacted.push_back(std::move(m_log[i]));
+        }
+    }
+    m_log = std::move(compacted);
+    m_compactAt = 2 * m_log.size() + 128;
+}
+
 QString PartRegistry::addPart(const QString &name, const TopoDS_Shape &shape) {
-    QString id = QString::number(QRandomGenerator::global()->generate64(), 16);
-    m_parts.push_back({id, name, shape, true});
+    return addParts({{name, shape}}).front();
+}
+
+std::vector<QString> PartRegistry::addParts(const std::vector<std::pair<QString, TopoDS_Shape>> &parts) {
+    std::vector<QString> ids;
+    if (parts.empty()) return ids;
+    ids.reserve(parts.size());
+    m_parts.reserve(m_parts.size() + parts.size());
+    m_index.reserve(m_parts.size() + parts.size());
+    ++m_generation;
+    for (const auto &[name, shape] : parts) {
+        QString id = newId();
+        m_index.emplace(id, m_parts.size());
+        m_parts.push_back({id, name, shape, true});
+        m_parts.back().generation = m_generation;
+        record(id, false);
+        ids.push_back(std::move(id));
+    }
+    m_activeId = ids.back();
+    return ids;
+}
+
+bool PartRegistry::updatePart(const QString &id, const TopoDS_Shape &shape) {
+    if (updateParts({{id, shape}}) == 0) {
+        Logging::warn(QStringLiteral("Cannot update unknown part %1").arg(id));
+        return false;
+    }
     m_activeId = id;
-    return id;
+    return true;
+}
+
+std::size_t PartRegistry::updateParts(const std::vector<std::pair<QString, TopoDS_Shape>> &updates) {
+    std::size_t updated = 0;
+    ++m_generation;
+    for (const auto &[id, shape] : updates) {
+        Entry *entry = findMutable(id);
+        if (!entry) continue;
+        entry->shape = shape;
+        entry->generation = m_generation;
+        record(id, false);
+        ++updated;
+    }
+    return updated;
+}
+
+bool PartRegistry::removePart(const QString &id) {
+    const auto it = m_index.find(id);
+    if (it == m_index.end()) return false;
+    const std::size_t row = it->second;
+    m_index.erase(it);
+    if (row + 1 != m_parts.size()) {
+        m_parts[row] = std::move(m_parts.back());
+        m_index[m_parts[row].id] = row;
+    }
+    m_parts.pop_back();
+    ++m_generation;
+    record(id, true);
+    if (m_activeId == id) {
+        m_activeId = m_parts.empty() ? QString() : m_parts.back().id;
+    }
+    return true;
+}
+
+bool PartRegistry::setMaterial(const QString &id, const QString &material, double density, double yieldStrength) {
+    Entry *entry = findMutable(id);
+    if (!entry) return false;
+    entry->material = material;
+    entry->density = density;
+    entry->yieldStrength = yieldStrength;
+    entry->generation = ++m_generation;
+    record(id, false);
+    return true;
+}
+
+bool PartRegistry::setVisible(const QString &id, bool visible) {
+    Entry *entry = findMutable(id);
+    if (!entry) return false;
+    if (entry->visible == visible) return true;
+    entry->visible = visible;
+    entry->generation = ++m_generation;
+    record(id, false);
+    return true;
 }
 
-void PartRegistry::updatePart(const QString &id, const TopoDS_Shape &shape) {
-    for (auto &entry : m_parts) {
-        if (entry.id == id) {
-            entry.shape = shape;
-            m_activeId = id;
-            return;
+void PartRegistry::assign(std::vector<Entry> parts, const QString &activeId) {
+    ++m_generation;
+    for (const auto &entry : m_parts) {
+        record(entry.id, true);
+    }
+    m_parts.clear();
+    m_index.clear();
+    m_parts.reserve(parts.size());
+    m_index.reserve(parts.size());
+    for (auto &entry : parts) {
+        if (!m_index.emplace(entry.id, m_parts.size()).second) {
+            Logging::warn(QStringLiteral("Skipping duplicate part id %1").arg(entry.id));
+            continue;
         }
+        entry.generation = m_generation;
+        record(entry.id, false);
+        m_parts.push_back(std::move(entry));
     }
-    addPart(id, shape);
+    m_activeId = contains(activeId) ? activeId : (m_parts.empty() ? QString() : m_parts.front().id);
 }
 
-void PartRegistry::setMaterial(const QString &id, const QString &material, double density, double yieldStrength) {
-    for (auto &entry : m_parts) {
-        if (entry.id == id) {
-            entry.material = material;
-            entry.density = density;
-            entry.yieldStrength = yieldStrength;
-            return;
+PartRegistry::Changes PartRegistry::changesSince(std::uint64_t generation) const {
+    Changes changes;
+    changes.generation = m_generation;
+    if (generation == 0) {
+        changes.changed.reserve(m_parts.size());
+        for (const auto &entry : m_parts) {
+            changes.changed.push_back(entry.id);
+        }
+        return changes;
+    }
+    const auto first = std::upper_bound(m_log.begin(), m_log.end(), generation,
+                                        [](std::uint64_t g, const ChangeRecord &record) { return g < record.generation; });
+    std::unordered_set<QString> seen;
+    for (auto it = m_log.end(); it != first;) {
+        --it;
+        if (!seen.insert(it->id).second) continue;
+        // A removed id that was re-added later is reported by its newest record only.
+        if (it->removed) {
+            changes.removed.push_back(it->id);
+        } else if (contains(it->id)) {
+            changes.changed.push_back(it->id);
         }
     }
+    return changes;
 }
 
 TopoDS_Shape PartRegistry::activeShape() const {
-    for (const auto &entry : m_parts) {
-        if (entry.id == m_activeId) {
-            return entry.shape;
-        }
+    if (const Entry *entry = find(m_activeId)) {
+        return entry->shape.get();
     }
     if (!m_parts.empty()) {
-        return m_parts.back().shape;
+        return m_parts.back().shape.get();
     }
     return TopoDS_Shape();
 }
 
-QString PartRegistry::serializeShape(const TopoDS_Shape &shape) {
-    if (shape.IsNull()) return {};
-
-    std::ostringstream stream;
-    BRepTools::Write(shape, stream);
-    const std::string data = stream.str();
-    QByteArray bytes(data.data(), static_cast<int>(data.size()));
-    return QString::fromLatin1(bytes.toBase64());
+bool PartRegistry::save(const QString &path, LazyShape::Encoding encoding) const {
+    // Written beside the target and renamed over it, so parts still mapped from the old file
+    // stay readable while they are copied. The mapping is released before the rename.
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    ShapeArchiveWriter writer(file, encoding);
+    for (const auto &entry : m_parts) {
+        writer.add(entry.shape, entryToJson(entry));
+    }
+    QJsonObject header;
+    header["activeId"] = m_activeId;
+    if (!writer.finish(header)) return false;
+    ShapeArchiveReader::releaseMapping(path);
+    return file.commit();
 }
 
-TopoDS_Shape PartRegistry::deserializeShape(const QString &encoded) {
-    if (encoded.isEmpty()) return TopoDS_Shape();
-    QByteArray bytes = QByteArray::fromBase64(encoded.toLatin1());
-    std::string buffer(bytes.constData(), bytes.size());
-    std::istringstream stream(buffer);
-    TopoDS_Shape shape;
-    BRep_Builder builder;
-    if (BRepTools::Read(shape, stream, builder)) {
-        return shape;
+bool PartRegistry::load(const QString &path) {
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) return false;
+        if (!ShapeArchive::isArchive(file)) {
+            return loadLegacyJson(file.readAll());
+        }
     }
-    return TopoDS_Shape();
-}
 
-bool PartRegistry::exportToJson(const QString &path) const {
-    QJsonArray array;
-    for (const auto &entry : m_parts) {
-        QJsonObject obj;
-        obj["id"] = entry.id;
-        obj["name"] = entry.name;
-        obj["visible"] = entry.visible;
-        obj["material"] = entry.material;
-        obj["density"] = entry.density;
-        obj["yieldStrength"] = entry.yieldStrength;
-        obj["brep"] = serializeShape(entry.shape);
-        array.push_back(obj);
-    }
-
-    QJsonDocument doc(array);
-    QFile file(path);
-    if (!file.open(QIODevice::WriteOnly)) return false;
-    file.write(doc.toJson(QJsonDocument::Indented));
+    ShapeArchiveReader reader;
+    if (!reader.open(path)) return false;
+    std::vector<Entry> parts;
+    parts.reserve(reader.entries().size());
+    for (std::size_t i = 0; i < reader.entries().size(); ++i) {
+        Entry entry = entryFromJson(reader.entries()[i].meta);
+        entry.shape = reader.shape(i);
+        parts.push_back(std::move(entry));
+    }
+    assign(std::move(parts), reader.header().value("activeId").toString());
     return true;
 }
 
-bool PartRegistry::importFromJson(const QString &path) {
-    QFile file(path);
-    if (!file.open(QIODevice::ReadOnly)) return false;
-    const auto doc = QJsonDocument::fromJson(file.readAll());
+bool PartRegistry::loadLegacyJson(const QByteArray &json) {
+    const auto doc = QJsonDocument::fromJson(json);
     if (!doc.isArray()) return false;
 
-    m_parts.clear();
+    std::vector<Entry> parts;
     for (const auto &value : doc.array()) {
         const auto obj = value.toObject();
-        Entry entry;
-        entry.id = obj["id"].toString();
-        entry.name = obj["name"].toString();
-        entry.visible = obj["visible"].toBool(true);
-        entry.material = obj.value("material").toString(entry.material);
-        entry.density = obj.value("density").toDouble(entry.density);
-        entry.yieldStrength = obj.value("yieldStrength").toDouble(entry.yieldStrength);
-        entry.shape = deserializeShape(obj["brep"].toString());
-        m_parts.push_back(entry);
-    }
-    if (!m_parts.empty()) {
-        m_activeId = m_parts.front().id;
+        Entry entry = entryFromJson(obj);
+        entry.shape = LazyShape::fromBytes(QByteArray::fromBase64(obj["brep"].toString().toLatin1()),
+                                           LazyShape::Encoding::AsciiBrep);
+        parts.push_back(std::move(entry));
     }
+    assign(std::move(parts));
     return true;
 }
 
@@ -1,41 +1,92 @@
 #pragma once
 
+#include "LazyShape.h"
+
 #include <TopoDS_Shape.hxx>
 #include <QString>
 #include <QJsonObject>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+// Parts are stored densely and found through an id hash index. Every mutation advances the
+// registry generation and records the touched id, so the viewer and the analysis manager
+// can pull only what changed since they last looked.
 class PartRegistry {
 public:
     struct Entry {
         QString id;
         QString name;
-        TopoDS_Shape shape;
+        LazyShape shape;  // decoded on first get()
         bool visible{true};
         QString material{QStringLiteral("Aluminum 6061")};
         double density{2700.0};
         double yieldStrength{250e6};
+        std::uint64_t generation{0};  // registry generation of the last change
+    };
+
+    struct Changes {
+        std::vector<QString> changed;  // added or modified and still present
+        std::vector<QString> removed;
+        std::uint64_t generation{0};   // pass to the next changesSince()
     };
 
     PartRegistry();
 
     QString addPart(const QString &name, const TopoDS_Shape &shape);
-    void updatePart(const QString &id, const TopoDS_Shape &shape);
-    void setMaterial(const QString &id, const QString &material, double density = 2700.0, double yieldStrength = 250e6);
+    // One index reservation and one generation for the whole batch; returns the new ids in order.
+    std::vector<QString> addParts(const std::vector<std::pair<QString, TopoDS_Shape>> &parts);
+    // Unknown ids are rejected; use addPart to create parts.
+    bool updatePart(const QString &id, const TopoDS_Shape &shape);
+    // Returns how many of the ids were known and updated.
+    std::size_t updateParts(const std::vector<std::pair<QString, TopoDS_Shape>> &updates);
+    bool removePart(const QString &id);
+    bool setMaterial(const QString &id, const QString &material, double density = 2700.0, double yieldStrength = 250e6);
+    bool setVisible(const QString &id, bool visible);
+    // Replaces every part, e.g. with the lazily loaded parts of a project.
+    void assign(std::vector<Entry> parts, const QString &activeId = QString());
+
+    const Entry *find(const QString &id) const;
+    bool contains(const QString &id) const { return m_index.count(id) > 0; }
     TopoDS_Shape activeShape() const;
     QString activeId() const { return m_activeId; }
-    std::vector<Entry> parts() const { return m_parts; }
+    // Order is not stable across removals.
+    const std::vector<Entry> &parts() const { return m_parts; }
+
+    std::uint64_t generation() const { return m_generation; }
+    // Ids touched after `generation`; 0 reports every present part.
+    Changes changesSince(std::uint64_t generation) const;
 
-    bool exportToJson(const QString &path) const;
-    bool importFromJson(const QString &path);
+    // Writes a ShapeArchive: BinTools geometry plus a JSON index of part attributes.
+    bool save(const QString &path, LazyShape::Encoding encoding = LazyShape::Encoding::Binary) const;
+    // Reads archives and the older base64-in-JSON files. Shapes stay encoded until first accessed.
+    bool load(const QString &path);
+
+    // Part attributes without the shape, as stored in archive metadata.
+    static QJsonObject entryToJson(const Entry &entry);
+    static Entry entryFromJson(const QJsonObject &obj);
 
     TopoDS_Shape synthesizeFromPrompt(const QString &prompt);
 
 private:
-    static QString serializeShape(const TopoDS_Shape &shape);
-    static TopoDS_Shape deserializeShape(const QString &encoded);
+    struct ChangeRecord {
+        std::uint64_t generation;
+        QString id;
+        bool removed;
+    };
+
+    bool loadLegacyJson(const QByteArray &json);
+    Entry *findMutable(const QString &id);
+    QString newId() const;
+    void record(const QString &id, bool removed);
+    void compactLog();
 
     std::vector<Entry> m_parts;
+    std::unordered_map<QString, std::size_t> m_index;
     QString m_activeId;
+    std::uint64_t m_generation{0};
+    std::vector<ChangeRecord> m_log;  // ordered by generation
+    std::size_t m_compactAt{128};
 };
 
@@ -0,0 +1,70 @@
+#include "PersistentNaming.h"
+
+#include <TopTools_ListIteratorOfListOfShape.hxx>
+
+#include <atomic>
+
+namespace {
+std::atomic<bool> g_namingEnabled{true};
+thread_local NamingJournal *t_activeJournal = nullptr;
+}
+
+void NamingJournal::append(const QString &operation, const Handle(BRepTools_History) &history) {
+    if (history.IsNull()) return;
+    m_steps.push_back({operation, history});
+}
+
+void NamingJournal::append(const NamingJournal &other) {
+    m_steps.insert(m_steps.end(), other.m_steps.begin(), other.m_steps.end());
+}
+
+TopTools_ListOfShape NamingJournal::track(const TopoDS_Shape &initial) const {
+    TopTools_ListOfShape current;
+    current.Append(initial);
+    for (const auto &step : m_steps) {
+        TopTools_ListOfShape next;
+        for (TopTools_ListIteratorOfListOfShape it(current); it.More(); it.Next()) {
+            const TopoDS_Shape &shape = it.Value();
+            if (!step.history->IsRemoved(shape)) {
+                const TopTools_ListOfShape &modified = step.history->Modified(shape);
+                if (modified.IsEmpty()) {
+                    next.Append(shape);
+                } else {
+                    for (TopTools_ListIteratorOfListOfShape m(modified); m.More(); m.Next()) {
+                        next.Append(m.Value());
+                    }
+                }
+            }
+            const TopTools_ListOfShape &generated = step.history->Generated(shape);
+            for (TopTools_ListIteratorOfListOfShape g(generated); g.More(); g.Next()) {
+                next.Append(g.Value());
+            }
+        }
+        current = next;
+    }
+    return current;
+}
+
+namespace PersistentNaming {
+
+void setEnabled(bool enabled) {
+    g_namingEnabled.store(enabled);
+}
+
+bool isEnabled() {
+    return g_namingEnabled.load();
+}
+
+NamingJournal *activeJournal() {
+    return t_activeJournal;
+}
+
+JournalScope::JournalScope(NamingJournal *journal) : m_previous(t_activeJournal) {
+    t_activeJournal = journal;
+}
+
+JournalScope::~JournalScope() {
+    t_activeJournal = m_previous;
+}
+
+} // namespace PersistentNaming
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <BRepTools_History.hxx>
+#include <TopTools_ListOfShape.hxx>
+#include <TopoDS_Shape.hxx>
+#include <QString>
+#include <vector>
+
+// Sub-shape history (modified/generated/removed) as reported by each modelling
+// algorithm, kept per feature so faces and edges can be traced through a rebuild.
+class NamingJournal {
+public:
+    struct Step {
+        QString operation;
+        Handle(BRepTools_History) history;
+    };
+
+    void append(const QString &operation, const Handle(BRepTools_History) &history);
+    void append(const NamingJournal &other);
+    void clear() { m_steps.clear(); }
+    bool isEmpty() const { return m_steps.empty(); }
+    const std::vector<Step> &steps() const { return m_steps; }
+
+    // Follows a sub-shape of the first input through every recorded step.
+    TopTools_ListOfShape track(const TopoDS_Shape &initial) const;
+
+private:
+    std::vector<Step> m_steps;
+};
+
+namespace PersistentNaming {
+void setEnabled(bool enabled);
+bool isEnabled();
+
+NamingJournal *activeJournal();
+
+// Routes records made on the current thread into a journal while in scope.
+class JournalScope {
+public:
+    explicit JournalScope(NamingJournal *journal);
+    ~JournalScope();
+    JournalScope(const JournalScope &) = delete;
+    JournalScope &operator=(const JournalScope &) = delete;
+
+private:
+    NamingJournal *m_previous{nullptr};
+};
+
+template <typename Algo>
+void record(const char *operation, const TopTools_ListOfShape &arguments, Algo &algo) {
+    NamingJournal *journal = activeJournal();
+    if (!journal || !isEnabled() || !algo.IsDone()) return;
+    journal->append(QString::fromLatin1(operation), new BRepTools_History(arguments, algo));
+}
+
+template <typename Algo>
+void record(const char *operation, const TopoDS_Shape &input, Algo &algo) {
+    if (!activeJournal() || !isEnabled()) return;
+    TopTools_ListOfShape arguments;
+    arguments.Append(input);
+    record(operation, arguments, algo);
+}
+}
@@ -0,0 +1,288 @@
+#include "ProfileBuilder.h"
+#include "ShapeHash.h"
+#include "../utils/Logging.h"
+
+#include <BRepBuilderAPI_MakeEdge.hxx>
+#include <BRepBuilderAPI_MakeFace.hxx>
+#include <BRepBuilderAPI_MakeVertex.hxx>
+#include <BRepBuilderAPI_MakeWire.hxx>
+#include <BRep_Builder.hxx>
+#include <Geom_Circle.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Compound.hxx>
+#include <TopoDS_Vertex.hxx>
+#include <TopoDS_Wire.hxx>
+#include <gp.hxx>
+#include <gp_Ax2.hxx>
+#include <gp_Pnt.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+struct Point {
+    double x;
+    double y;
+};
+
+struct CellHash {
+    std::size_t operator()(const std::pair<long long, long long> &cell) const {
+        std::size_t seed = 0;
+        ShapeHash::combineValue(seed, cell.first);
+        ShapeHash::combineValue(seed, cell.second);
+        return seed;
+    }
+};
+
+// Merges endpoints closer than the tolerance. Each lookup probes the 3x3 block of grid cells
+// around the point, so merging stays linear in the number of endpoints.
+class VertexGrid {
+public:
+    explicit VertexGrid(double tolerance) : m_tolerance(tolerance) {}
+
+    int findOrAdd(const Point &point) {
+        const long long ci = static_cast<long long>(std::floor(point.x / m_tolerance));
+        const long long cj = static_cast<long long>(std::floor(point.y / m_tolerance));
+        for (long long di = -1; di <= 1; ++di) {
+            for (long long dj = -1; dj <= 1; ++dj) {
+                const auto cell = m_cells.find({ci + di, cj + dj});
+                if (cell == m_cells.end()) continue;
+                for (int vertex : cell->second) {
+                    const Point &other = points[vertex];
+                    if (std::hypot(other.x - point.x, other.y - point.y) <= m_tolerance) return vertex;
+                }
+            }
+        }
+        const int vertex = static_cast<int>(points.size());
+        points.push_back(point);
+        m_cells[{ci, cj}].push_back(vertex);
+        return vertex;
+    }
+
+    std::vector<Point> points;
+
+private:
+    double m_tolerance;
+    std::unordered_map<std::pair<long long, long long>, std::vector<int>, CellHash> m_cells;
+};
+
+struct Loop {
+    std::vector<int> vertices;  // closed polygon, first vertex not repeated
+    std::size_t circleRow{0};
+    bool isCircle{false};
+    double area{0.0};  // signed; positive is counter-clockwise
+    Point sample{0.0, 0.0};
+    double minX{0.0};
+    double minY{0.0};
+    double maxX{0.0};
+    double maxY{0.0};
+};
+
+bool contains(const Loop &loop, const std::vector<Point> &points, const SketchGeometry &geometry, const Point &p) {
+    if (p.x < loop.minX || p.x > loop.maxX || p.y < loop.minY || p.y > loop.maxY) return false;
+    if (loop.isCircle) {
+        const std::size_t row = loop.circleRow;
+        return std::hypot(p.x - geometry.startX[row], p.y - geometry.startY[row]) < geometry.radius[row];
+    }
+    bool inside = false;
+    const std::size_t n = loop.vertices.size();
+    for (std::size_t i = 0, j = n - 1; i < n; j = i++) {
+        const Point &a = points[loop.vertices[i]];
+        const Point &b = points[loop.vertices[j]];
+        if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+TopoDS_Wire makeWire(const Loop &loop, const std::vector<Point> &points, const SketchGeometry &geometry,
+                     bool counterClockwise) {
+    if (loop.isCircle) {
+        const std::size_t row = loop.circleRow;
+        const gp_Pnt center(geometry.startX[row], geometry.startY[row], 0.0);
+        Handle(Geom_Circle) circle =
+            new Geom_Circle(gp_Ax2(center, counterClockwise ? gp::DZ() : -gp::DZ()), geometry.radius[row]);
+        return BRepBuilderAPI_MakeWire(BRepBuilderAPI_MakeEdge(circle)).Wire();
+    }
+
+    std::vector<int> order = loop.vertices;
+    if ((loop.area > 0.0) != counterClockwise) {
+        std::reverse(order.begin(), order.end());
+    }
+    // Shared vertices make the wire topologically closed rather than merely within tolerance.
+    std::vector<TopoDS_Vertex> vertices;
+    vertices.reserve(order.size());
+    for (int v : order) {
+        vertices.push_back(BRepBuilderAPI_MakeVertex(gp_Pnt(points[v].x, points[v].y, 0.0)));
+    }
+    BRepBuilderAPI_MakeWire wire;
+    for (std::size_t i = 0; i < vertices.size(); ++i) {
+        wire.Add(BRepBuilderAPI_MakeEdge(vertices[i], vertices[(i + 1) % vertices.size()]));
+    }
+    return wire.Wire();
+}
+}
+
+ProfileBuilder::Result ProfileBuilder::build(const SketchGeometry &geometry) const {
+    Result result;
+    VertexGrid grid(m_tolerance);
+    std::vector<std::pair<int, int>> segments;
+    std::vector<Loop> loops;
+
+    for (std::size_t row = 0; row < geometry.size(); ++row) {
+        if (geometry.kind[row] == SketchPrimitive::Kind::Circle) {
+            const double r = geometry.radius[row];
+            if (r <= m_tolerance) continue;
+            Loop loop;
+            loop.isCircle = true;
+            loop.circleRow = row;
+            loop.area = M_PI * r * r;
+            loop.sample = {geometry.startX[row] + r, geometry.startY[row]};
+            loop.minX = geometry.startX[row] - r;
+            loop.maxX = geometry.startX[row] + r;
+            loop.minY = geometry.startY[row] - r;
+            loop.maxY = geometry.startY[row] + r;
+            loops.push_back(std::move(loop));
+            continue;
+        }
+        const int a = grid.findOrAdd({geometry.startX[row], geometry.startY[row]});
+        const int b = grid.findOrAdd({geometry.endX[row], geometry.endY[row]});
+        if (a != b) segments.emplace_back(a, b);
+    }
+
+    const std::vector<Point> &points = grid.points;
+    std::vector<std::vector<int>> incident(points.size());
+    for (int s = 0; s < static_cast<int>(segments.size()); ++s) {
+        incident[segments[s].first].push_back(s);
+        incident[segments[s].second].push_back(s);
+    }
+
+    // Dangling chains are stripped first, so every later walk closes unless a vertex is shared
+    // by more than two segments; there the walk takes the first unused branch.
+    std::vector<char> used(segments.size(), 0);
+    const auto walk = [&](int startVertex, int startSegment, std::vector<int> &vertices) {
+        int vertex = startVertex;
+        int segment = startSegment;
+        while (segment >= 0) {
+            used[segment] = 1;
+            vertices.push_back(vertex);
+            vertex = segments[segment].first == vertex ? segments[segment].second : segments[segment].first;
+            if (vertex == startVertex) return true;
+            segment = -1;
+            for (int next : incident[vertex]) {
+                if (!used[next]) {
+                    segment = next;
+                    break;
+                }
+            }
+        }
+        return false;
+    };
+    // A strip starts at a free end and stops at the first vertex still joined to two or more
+    // unused segments, so a stray segment on a loop corner leaves the loop whole. A junction
+    // whose other branches were all stripped is a free end by then and the strip runs on.
+    std::vector<int> degree(points.size());
+    for (int v = 0; v < static_cast<int>(points.size()); ++v) {
+        degree[v] = static_cast<int>(incident[v].size());
+    }
+    for (int v = 0; v < static_cast<int>(points.size()); ++v) {
+        if (degree[v] != 1) continue;
+        int vertex = v;
+        while (degree[vertex] == 1) {
+            const auto next = std::find_if(incident[vertex].begin(), incident[vertex].end(), [&used](int s) { return !used[s]; });
+            const int segment = *next;
+            used[segment] = 1;
+            --degree[segments[segment].first];
+            --degree[segments[segment].second];
+            vertex = segments[segment].first == vertex ? segments[segment].second : segments[segment].first;
+        }
+        ++result.openChains;
+    }
+    std::vector<int> vertices;
+    for (int s = 0; s < static_cast<int>(segments.size()); ++s) {
+        if (used[s]) continue;
+        vertices.clear();
+        if (!walk(segments[s].first, s, vertices) || vertices.size() < 3) {
+            ++result.openChains;
+            continue;
+        }
+        Loop loop;
+        loop.vertices = vertices;
+        loop.minX = loop.maxX = points[vertices.front()].x;
+        loop.minY = loop.maxY = points[vertices.front()].y;
+        for (std::size_t i = 0; i < vertices.size(); ++i) {
+            const Point &p = points[vertices[i]];
+            const Point &q = points[vertices[(i + 1) % vertices.size()]];
+            loop.area += 0.5 * (p.x * q.y - q.x * p.y);
+            loop.minX = std::min(loop.minX, p.x);
+            loop.maxX = std::max(loop.maxX, p.x);
+            loop.minY = std::min(loop.minY, p.y);
+            loop.maxY = std::max(loop.maxY, p.y);
+        }
+        const Point &p = points[vertices[0]];
+        const Point &q = points[vertices[1]];
+        loop.sample = {0.5 * (p.x + q.x), 0.5 * (p.y + q.y)};
+        loops.push_back(std::move(loop));
+    }
+    if (result.openChains > 0) {
+        Logging::warn(QStringLiteral("Sketch profile has %1 open chain(s); they are ignored").arg(result.openChains));
+    }
+    result.loops = loops.size();
+    if (loops.empty()) return result;
+
+    // Largest first, so the nearest container of a loop is the last earlier loop holding it.
+    std::vector<std::size_t> bySize(loops.size());
+    std::iota(bySize.begin(), bySize.end(), 0);
+    std::sort(bySize.begin(), bySize.end(),
+              [&loops](std::size_t l, std::size_t r) { return std::abs(loops[l].area) > std::abs(loops[r].area); });
+    std::vector<int> parent(loops.size(), -1);
+    std::vector<int> depth(loops.size(), 0);
+    for (std::size_t i = 0; i < bySize.size(); ++i) {
+        const Loop &loop = loops[bySize[i]];
+        for (std::size_t j = i; j-- > 0;) {
+            if (contains(loops[bySize[j]], points, geometry, loop.sample)) {
+                parent[bySize[i]] = static_cast<int>(bySize[j]);
+                depth[bySize[i]] = depth[bySize[j]] + 1;
+                break;
+            }
+        }
+    }
+
+    std::vector<std::vector<std::size_t>> holes(loops.size());
+    for (std::size_t l = 0; l < loops.size(); ++l) {
+        if (depth[l] % 2 == 1) {
+            holes[parent[l]].push_back(l);
+            ++result.holes;
+        }
+    }
+
+    std::vector<TopoDS_Shape> faces;
+    for (std::size_t l = 0; l < loops.size(); ++l) {
+        if (depth[l] % 2 == 1) continue;
+        BRepBuilderAPI_MakeFace face(makeWire(loops[l], points, geometry, true), Standard_True);
+        for (std::size_t hole : holes[l]) {
+            face.Add(makeWire(loops[hole], points, geometry, false));
+        }
+        if (face.IsDone()) {
+            faces.push_back(face.Face());
+        }
+    }
+
+    if (faces.size() == 1) {
+        result.shape = faces.front();
+    } else if (!faces.empty()) {
+        TopoDS_Compound compound;
+        BRep_Builder builder;
+        builder.MakeCompound(compound);
+        for (const auto &face : faces) {
+            builder.Add(compound, face);
+        }
+        result.shape = compound;
+    }
+    return result;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "SketchSolver.h"
+
+#include <TopoDS_Shape.hxx>
+#include <cstddef>
+
+// Turns unordered sketch segments into planar faces. Endpoints are merged on a tolerance
+// grid, segments are chained into closed loops, and loop nesting depth decides which loops
+// bound material and which are holes: even depth is an outer boundary, odd depth a hole
+// of its immediate parent.
+class ProfileBuilder {
+public:
+    struct Result {
+        TopoDS_Shape shape;  // a face, a compound of faces, or null when no loop closes
+        std::size_t loops{0};
+        std::size_t holes{0};
+        std::size_t openChains{0};
+    };
+
+    explicit ProfileBuilder(double tolerance = 1.0e-6) : m_tolerance(tolerance) {}
+
+    Result build(const SketchGeometry &geometry) const;
+
+private:
+    double m_tolerance;
+};
@@ -0,0 +1,381 @@
+#include "ShapeArchive.h"
+#include "../utils/Logging.h"
+
+#include <BinTools.hxx>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+
+namespace {
+constexpr char kMagic[8] = {'A', 'E', 'G', 'I', 'S', 'S', 'H', 'P'};
+constexpr char kIndexMagic[8] = {'A', 'E', 'G', 'I', 'S', 'I', 'D', 'X'};
+constexpr quint32 kVersion = 1;
+constexpr qint64 kHeaderSize = 16;   // magic, version, reserved
+constexpr qint64 kTrailerSize = 24;  // index offset, index size, magic
+
+QString encodingName(LazyShape::Encoding encoding) {
+    switch (encoding) {
+    case LazyShape::Encoding::AsciiBrep:
+        return QStringLiteral("brep");
+    case LazyShape::Encoding::Binary:
+        return QStringLiteral("binary");
+    case LazyShape::Encoding::CompressedBinary:
+        return QStringLiteral("binary+zlib");
+    }
+    return QString();
+}
+
+bool encodingFromName(const QString &name, LazyShape::Encoding &encoding) {
+    for (auto candidate : {LazyShape::Encoding::AsciiBrep, LazyShape::Encoding::Binary, LazyShape::Encoding::CompressedBinary}) {
+        if (encodingName(candidate) == name) {
+            encoding = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Buffered output stream into a QIODevice, so BinTools writes land in the file directly.
+class DeviceStreamBuf : public std::streambuf {
+public:
+    explicit DeviceStreamBuf(QIODevice &device) : m_device(device) {
+        setp(m_buffer, m_buffer + sizeof(m_buffer));
+    }
+    ~DeviceStreamBuf() override { flushBuffer(); }
+
+    qint64 written() const { return m_written + (pptr() - pbase()); }
+    bool ok() const { return m_ok; }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (!flushBuffer()) return traits_type::eof();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override { return flushBuffer() ? 0 : -1; }
+
+private:
+    bool flushBuffer() {
+        const qint64 pending = pptr() - pbase();
+        if (pending > 0) {
+            m_ok = m_ok && m_device.write(pbase(), pending) == pending;
+            m_written += pending;
+            setp(m_buffer, m_buffer + sizeof(m_buffer));
+        }
+        return m_ok;
+    }
+
+    QIODevice &m_device;
+    char m_buffer[64 * 1024];
+    qint64 m_written{0};
+    bool m_ok{true};
+};
+}
+
+bool ShapeArchive::isArchive(QIODevice &device) {
+    char magic[sizeof(kMagic)];
+    return device.peek(magic, sizeof(magic)) == sizeof(magic) && std::memcmp(magic, kMagic, sizeof(magic)) == 0;
+}
+
+ShapeArchiveWriter::ShapeArchiveWriter(QIODevice &device, LazyShape::Encoding encoding)
+    : m_device(device), m_encoding(encoding == LazyShape::Encoding::AsciiBrep ? LazyShape::Encoding::Binary : encoding) {
+    char header[kHeaderSize] = {};
+    std::memcpy(header, kMagic, sizeof(kMagic));
+    qToLittleEndian<quint32>(kVersion, header + sizeof(kMagic));
+    writeRaw(header, kHeaderSize);
+}
+
+bool ShapeArchiveWriter::writeRaw(const char *data, qint64 size) {
+    if (!m_ok) return false;
+    m_ok = m_device.write(data, size) == size;
+    m_written += size;
+    return m_ok;
+}
+
+bool ShapeArchiveWriter::add(const LazyShape &shape, const QJsonObject &meta, const QString &name) {
+    ShapeArchive::Entry entry;
+    entry.name = name;
+    entry.offset = m_written;
+    entry.encoding = m_encoding;
+    entry.meta = meta;
+
+    if (!shape.isNull()) {
+        if (!shape.isLoaded() && shape.encoding() == m_encoding) {
+            const QByteArray bytes = shape.bytes();
+            writeRaw(bytes.constData(), bytes.size());
+        } else if (m_encoding == LazyShape::Encoding::CompressedBinary) {
+            const QByteArray bytes = LazyShape::encode(shape.get(), m_encoding);
+            writeRaw(bytes.constData(), bytes.size());
+        } else if (m_ok) {
+            DeviceStreamBuf buffer(m_device);
+            {
+                std::ostream stream(&buffer);
+                BinTools::Write(shape.get(), stream);
+                stream.flush();
+            }
+            m_ok = buffer.ok();
+            m_written += buffer.written();
+        }
+    }
+    entry.size = m_written - entry.offset;
+    appendEntry(std::move(entry));
+    return m_ok;
+}
+
+bool ShapeArchiveWriter::addChunk(const QString &name, const QByteArray &data) {
+    ShapeArchive::Entry entry;
+    entry.name = name;
+    entry.raw = true;
+    entry.offset = m_written;
+    entry.size = data.size();
+    writeRaw(data.constData(), data.size());
+    appendEntry(std::move(entry));
+    return m_ok;
+}
+
+void ShapeArchiveWriter::appendEntry(ShapeArchive::Entry entry) {
+    if (!entry.name.isEmpty()) {
+        for (const auto &existing : m_entries) {
+            if (existing.name == entry.name) {
+                Logging::warn(QStringLiteral("Shape archive entry name %1 is used twice; lookups find the first").arg(entry.name));
+                break;
+            }
+        }
+    }
+    m_entries.push_back(std::move(entry));
+}
+
+bool ShapeArchiveWriter::finish(const QJsonObject &header) {
+    QJsonArray entries;
+    for (const auto &entry : m_entries) {
+        QJsonObject obj;
+        if (!entry.name.isEmpty()) {
+            obj["name"] = entry.name;
+        }
+        obj["offset"] = entry.offset;
+        obj["size"] = entry.size;
+        obj["encoding"] = entry.raw ? QStringLiteral("raw") : encodingName(entry.encoding);
+        if (!entry.meta.isEmpty()) {
+            obj["meta"] = entry.meta;
+        }
+        entries.append(obj);
+    }
+    QJsonObject index;
+    index["version"] = static_cast<int>(kVersion);
+    index["header"] = header;
+    index["entries"] = entries;
+    const QByteArray json = QJsonDocument(index).toJson(QJsonDocument::Compact);
+
+    const qint64 indexOffset = m_written;
+    writeRaw(json.constData(), json.size());
+    char trailer[kTrailerSize];
+    qToLittleEndian<quint64>(static_cast<quint64>(indexOffset), trailer);
+    qToLittleEndian<quint64>(static_cast<quint64>(json.size()), trailer + 8);
+    std::memcpy(trailer + 16, kIndexMagic, sizeof(kIndexMagic));
+    return writeRaw(trailer, kTrailerSize);
+}
+
+// The opened file, shared with lazy handles so it outlives the reader while they need it.
+// Handles get views straight into the mapping; detach() swaps them for copies and close()
+// lets go of the file.
+struct ShapeArchiveReader::Source {
+    ~Source() {
+        if (map) {
+            file.unmap(map);
+        }
+    }
+
+    // A view into the mapping while there is one, which is only valid while this source lives.
+    QByteArray view(qint64 offset, qint64 length) {
+        if (length <= 0) return QByteArray();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (map && !releasing) {
+            return QByteArray::fromRawData(reinterpret_cast<const char *>(map + offset), static_cast<qsizetype>(length));
+        }
+        return copyLocked(offset, length);
+    }
+
+    QByteArray read(qint64 offset, qint64 length) {
+        if (length <= 0) return QByteArray();
+        std::lock_guard<std::mutex> lock(mutex);
+        return copyLocked(offset, length);
+    }
+
+    QByteArray copyLocked(qint64 offset, qint64 length) {
+        if (map) {
+            return QByteArray(reinterpret_cast<const char *>(map + offset), static_cast<qsizetype>(length));
+        }
+        if (!file.isOpen()) return contents.mid(static_cast<qsizetype>(offset), static_cast<qsizetype>(length));
+        if (!file.seek(offset)) return QByteArray();
+        return file.read(length);
+    }
+
+    // Gives every handle reading from this source its own bytes, including handles not
+    // used yet, so none of them comes back to the file.
+    void detach() {
+        {
+            // From here on new reads are copies, so nothing fresh points into the mapping.
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!file.isOpen()) return;
+            releasing = true;
+        }
+        LazyShape::detachFrom(this);
+    }
+
+    // Unmaps and closes the file. A reader still open keeps the contents in memory.
+    void close(bool keepContents) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!file.isOpen()) return;
+        if (keepContents) {
+            contents = copyLocked(0, size);
+        }
+        if (map) {
+            file.unmap(map);
+            map = nullptr;
+        }
+        file.close();
+    }
+
+    QFile file;
+    QString canonicalPath;
+    uchar *map{nullptr};
+    qint64 size{0};
+    QByteArray contents;  // the file's bytes once it is closed under an open reader
+    bool releasing{false};
+    std::mutex mutex;
+};
+
+namespace {
+// Sources with an open file, so a save can release the file it replaces.
+std::mutex &openSourcesMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::vector<std::weak_ptr<ShapeArchiveReader::Source>> &openSources() {
+    static std::vector<std::weak_ptr<ShapeArchiveReader::Source>> sources;
+    return sources;
+}
+}
+
+void ShapeArchiveReader::releaseMapping(const QString &path) {
+    const QString canonical = QFileInfo(path).canonicalFilePath();
+    if (canonical.isEmpty()) return;
+    std::vector<std::shared_ptr<Source>> matches;
+    {
+        std::lock_guard<std::mutex> lock(openSourcesMutex());
+        auto &sources = openSources();
+        sources.erase(std::remove_if(sources.begin(), sources.end(),
+                                     [](const std::weak_ptr<Source> &entry) { return entry.expired(); }),
+                      sources.end());
+        for (const auto &entry : sources) {
+            std::shared_ptr<Source> source = entry.lock();
+            if (source && source->canonicalPath == canonical) matches.push_back(std::move(source));
+        }
+    }
+    for (const auto &source : matches) {
+        source->detach();
+        // Besides `matches`, only a reader that is still open holds the source now.
+        source->close(source.use_count() > 1);
+    }
+}
+
+bool ShapeArchiveReader::open(const QString &path) {
+    m_header = QJsonObject();
+    m_entries.clear();
+    m_names.clear();
+    m_source.reset();
+
+    auto source = std::make_shared<Source>();
+    source->file.setFileName(path);
+    if (!source->file.open(QIODevice::ReadOnly)) {
+        Logging::warn(QStringLiteral("Cannot open shape archive: %1").arg(path));
+        return false;
+    }
+    source->size = source->file.size();
+    if (!ShapeArchive::isArchive(source->file) || source->size < kHeaderSize + kTrailerSize) {
+        Logging::warn(QStringLiteral("Not a shape archive: %1").arg(path));
+        return false;
+    }
+    source->map = source->file.map(0, source->size);
+    source->canonicalPath = QFileInfo(path).canonicalFilePath();
+
+    const QByteArray trailer = source->read(source->size - kTrailerSize, kTrailerSize);
+    if (trailer.size() != kTrailerSize || std::memcmp(trailer.constData() + 16, kIndexMagic, sizeof(kIndexMagic)) != 0) {
+        Logging::warn(QStringLiteral("Not a shape archive: %1").arg(path));
+        return false;
+    }
+    const qint64 indexOffset = static_cast<qint64>(qFromLittleEndian<quint64>(trailer.constData()));
+    const qint64 indexSize = static_cast<qint64>(qFromLittleEndian<quint64>(trailer.constData() + 8));
+    if (indexOffset < kHeaderSize || indexSize <= 0 || indexOffset + indexSize > source->size - kTrailerSize) {
+        Logging::warn(QStringLiteral("Shape archive index is out of range: %1").arg(path));
+        return false;
+    }
+    const QJsonDocument index = QJsonDocument::fromJson(source->read(indexOffset, indexSize));
+    if (!index.isObject()) {
+        Logging::warn(QStringLiteral("Shape archive index is corrupt: %1").arg(path));
+        return false;
+    }
+
+    const QJsonObject root = index.object();
+    m_header = root.value("header").toObject();
+    for (const auto &value : root.value("entries").toArray()) {
+        const QJsonObject obj = value.toObject();
+        ShapeArchive::Entry entry;
+        entry.name = obj.value("name").toString();
+        entry.offset = static_cast<qint64>(obj.value("offset").toDouble());
+        entry.size = static_cast<qint64>(obj.value("size").toDouble());
+        entry.meta = obj.value("meta").toObject();
+        const QString encoding = obj.value("encoding").toString();
+        entry.raw = encoding == QStringLiteral("raw");
+        if ((!entry.raw && !encodingFromName(encoding, entry.encoding)) || entry.offset < kHeaderSize || entry.size < 0 ||
+            entry.offset + entry.size > indexOffset) {
+            Logging::warn(QStringLiteral("Skipping invalid shape archive entry %1 in %2").arg(m_entries.size()).arg(path));
+            entry.size = 0;
+        }
+        if (!entry.name.isEmpty()) {
+            m_names.emplace(entry.name, m_entries.size());
+        }
+        m_entries.push_back(std::move(entry));
+    }
+    {
+        std::lock_guard<std::mutex> lock(openSourcesMutex());
+        openSources().push_back(source);
+    }
+    m_source = std::move(source);
+    return true;
+}
+
+int ShapeArchiveReader::find(const QString &name) const {
+    const auto it = m_names.find(name);
+    return it == m_names.end() ? -1 : static_cast<int>(it->second);
+}
+
+QByteArray ShapeArchiveReader::bytes(std::size_t index) const {
+    if (!m_source || index >= m_entries.size()) return QByteArray();
+    return m_source->read(m_entries[index].offset, m_entries[index].size);
+}
+
+QByteArray ShapeArchiveReader::chunk(const QString &name) const {
+    const int index = find(name);
+    return index < 0 ? QByteArray() : bytes(static_cast<std::size_t>(index));
+}
+
+LazyShape ShapeArchiveReader::shape(std::size_t index) const {
+    if (!m_source || index >= m_entries.size() || m_entries[index].raw || m_entries[index].size == 0) return LazyShape();
+    const auto &entry = m_entries[index];
+    std::shared_ptr<Source> source = m_source;
+    const qint64 offset = entry.offset;
+    const qint64 size = entry.size;
+    return LazyShape::fromSource([source, offset, size]() { return source->view(offset, size); }, entry.encoding, source);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "LazyShape.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QJsonObject>
+#include <QString>
+#include <TopoDS_Shape.hxx>
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Binary shape container: a fixed header, the encoded entries back to back, then a compact
+// JSON index with the offset, size, encoding and caller metadata of each entry, and a
+// trailer pointing at the index. Shapes are never base64'd or embedded in JSON. Entries may
+// be named for lookup, and raw chunks carry non-shape payloads alongside the shapes.
+namespace ShapeArchive {
+struct Entry {
+    QString name;
+    qint64 offset{0};
+    qint64 size{0};
+    bool raw{false};  // chunk of caller bytes rather than a shape
+    LazyShape::Encoding encoding{LazyShape::Encoding::Binary};
+    QJsonObject meta;
+};
+
+// True when the device starts with the archive header; the read position is restored.
+bool isArchive(QIODevice &device);
+}
+
+class ShapeArchiveWriter {
+public:
+    // Uncompressed entries are streamed straight into the device; compressed ones are
+    // encoded in memory once because qCompress needs the whole buffer.
+    explicit ShapeArchiveWriter(QIODevice &device,
+                                LazyShape::Encoding encoding = LazyShape::Encoding::Binary);
+
+    // A handle that still holds bytes in the target encoding is copied without decoding.
+    bool add(const LazyShape &shape, const QJsonObject &meta = QJsonObject(), const QString &name = QString());
+    bool addChunk(const QString &name, const QByteArray &data);
+    // Writes the index and trailer; `header` is stored alongside the entries.
+    bool finish(const QJsonObject &header = QJsonObject());
+
+private:
+    bool writeRaw(const char *data, qint64 size);
+    void appendEntry(ShapeArchive::Entry entry);
+
+    QIODevice &m_device;
+    LazyShape::Encoding m_encoding;
+    std::vector<ShapeArchive::Entry> m_entries;
+    qint64 m_written{0};  // offsets are relative to where the archive starts
+    bool m_ok{true};
+};
+
+class ShapeArchiveReader {
+public:
+    // Maps the file and parses only the trailer and the index; entry bytes are paged in
+    // when used. Falls back to seek-and-read where the file cannot be mapped.
+    bool open(const QString &path);
+
+    const QJsonObject &header() const { return m_header; }
+    const std::vector<ShapeArchive::Entry> &entries() const { return m_entries; }
+    // Index of the entry with this name, or -1.
+    int find(const QString &name) const;
+    // Stored bytes of one entry; empty for an unknown name.
+    QByteArray bytes(std::size_t index) const;
+    QByteArray chunk(const QString &name) const;
+    // Nothing is read until the handle is first used; until then it keeps the file open.
+    // Decoding reads straight from the mapping, which the handle keeps alive.
+    LazyShape shape(std::size_t index) const;
+
+    // Unmaps and closes `path` for every reader and handle that uses it, which then go on
+    // with their own copies of the bytes. Call before replacing the file: Windows refuses
+    // to rename over a file that is mapped or open.
+    static void releaseMapping(const QString &path);
+
+    struct Source;
+
+private:
+
+    std::shared_ptr<Source> m_source;
+    QJsonObject m_header;
+    std::vector<ShapeArchive::Entry> m_entries;
+    std::unordered_map<QString, std::size_t> m_names;
+};
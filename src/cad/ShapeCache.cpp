@@ -0,0 +1,165 @@
+#include "ShapeCache.h"
+
+#include <BRepAdaptor_Curve.hxx>
+#include <BRep_Tool.hxx>
+#include <TopAbs_ShapeEnum.hxx>
+#include <TopExp.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+#include <algorithm>
+
+namespace {
+constexpr std::size_t kDefaultCapacity = std::size_t{256} * 1024 * 1024;
+
+// Rough in-memory footprint of a B-rep; faces dominate through their surfaces and pcurves.
+// The key is held twice, by the entry and by the lookup table.
+std::size_t estimateBytes(const TopoDS_Shape &shape, const ShapeCache::Key &key) {
+    TopTools_IndexedMapOfShape faces;
+    TopTools_IndexedMapOfShape edges;
+    TopTools_IndexedMapOfShape vertices;
+    TopExp::MapShapes(shape, TopAbs_FACE, faces);
+    TopExp::MapShapes(shape, TopAbs_EDGE, edges);
+    TopExp::MapShapes(shape, TopAbs_VERTEX, vertices);
+    return 1024 * static_cast<std::size_t>(faces.Extent()) + 384 * static_cast<std::size_t>(edges.Extent())
+           + 96 * static_cast<std::size_t>(vertices.Extent()) + 256 + 2 * key.bytes();
+}
+}
+
+ShapeCache::Key &ShapeCache::Key::shape(const TopoDS_Shape &input) {
+    m_fingerprints.push_back(ShapeHash::fingerprint(input));
+    TopTools_IndexedMapOfShape faces;
+    TopExp::MapShapes(input, TopAbs_FACE, faces);
+    m_faces.push_back(ShapeHash::faceKeys(faces));
+    m_inputs.push_back(ShapeHash::hashFingerprint(m_fingerprints.back()));
+    m_identities.push_back(ShapeHash::identity(input));
+    return *this;
+}
+
+ShapeCache::Key &ShapeCache::Key::edge(const TopoDS_Edge &edge) {
+    if (edge.IsNull() || BRep_Tool::Degenerated(edge)) return param(std::int64_t{-1});
+    BRepAdaptor_Curve curve(edge);
+    param(static_cast<std::int64_t>(curve.GetType()));
+    for (double t : {curve.FirstParameter(), 0.5 * (curve.FirstParameter() + curve.LastParameter()), curve.LastParameter()}) {
+        const gp_Pnt point = curve.Value(t);
+        param(ShapeHash::quantize(point.X())).param(ShapeHash::quantize(point.Y())).param(ShapeHash::quantize(point.Z()));
+    }
+    return *this;
+}
+
+bool ShapeCache::Key::operator==(const Key &other) const {
+    return m_operation == other.m_operation && m_parameters == other.m_parameters && m_inputs == other.m_inputs
+           && m_parameterBytes == other.m_parameterBytes && m_fingerprints == other.m_fingerprints
+           && std::equal(m_faces.begin(), m_faces.end(), other.m_faces.begin(), other.m_faces.end(),
+                         ShapeHash::sameFaces);
+}
+
+std::size_t ShapeCache::Key::bytes() const {
+    std::size_t total = m_operation.size() + m_parameterBytes.size();
+    for (const auto &fingerprint : m_fingerprints) {
+        total += fingerprint.size() * sizeof(std::int64_t);
+    }
+    for (const auto &faces : m_faces) {
+        total += faces.size() * sizeof(ShapeHash::FaceKey);
+    }
+    return total;
+}
+
+std::size_t ShapeCache::Key::hash() const {
+    std::size_t seed = std::hash<std::string>{}(m_operation);
+    ShapeHash::combine(seed, m_parameters);
+    for (std::size_t input : m_inputs) {
+        ShapeHash::combine(seed, input);
+    }
+    return seed;
+}
+
+ShapeCache::ShapeCache() {
+    m_stats.capacityBytes = kDefaultCapacity;
+}
+
+ShapeCache &ShapeCache::instance() {
+    static ShapeCache cache;
+    return cache;
+}
+
+bool ShapeCache::lookup(const Key &key, TopoDS_Shape &result) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_lookup.find(key);
+    if (found == m_lookup.end()) {
+        ++m_stats.misses;
+        return false;
+    }
+
+    const Entry &entry = *found->second;
+    NamingJournal *journal = PersistentNaming::activeJournal();
+    if (journal && PersistentNaming::isEnabled()) {
+        // The cached history maps the original inputs' sub-shapes; it is only valid
+        // for a caller holding those very handles.
+        if (!entry.namingRecorded || entry.key.m_identities != key.m_identities) {
+            ++m_stats.misses;
+            return false;
+        }
+        journal->append(entry.naming);
+    }
+    m_entries.splice(m_entries.begin(), m_entries, found->second);
+    ++m_stats.hits;
+    result = entry.result;
+    return true;
+}
+
+void ShapeCache::store(const Key &key, const TopoDS_Shape &result, const NamingJournal &naming, bool namingRecorded) {
+    const std::size_t bytes = estimateBytes(result, key);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto existing = m_lookup.find(key);
+    if (existing != m_lookup.end()) {
+        m_stats.bytes -= existing->second->bytes;
+        m_entries.erase(existing->second);
+        m_lookup.erase(existing);
+    }
+    m_entries.push_front({key, result, naming, namingRecorded, bytes});
+    m_lookup.emplace(key, m_entries.begin());
+    m_stats.bytes += bytes;
+    evictLocked();
+}
+
+void ShapeCache::evictLocked() {
+    while (m_stats.bytes > m_stats.capacityBytes && !m_entries.empty()) {
+        const Entry &oldest = m_entries.back();
+        m_stats.bytes -= oldest.bytes;
+        m_lookup.erase(oldest.key);
+        m_entries.pop_back();
+        ++m_stats.evictions;
+    }
+}
+
+void ShapeCache::setEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_enabled = enabled;
+}
+
+bool ShapeCache::isEnabled() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_enabled;
+}
+
+void ShapeCache::setCapacity(std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.capacityBytes = bytes;
+    evictLocked();
+}
+
+void ShapeCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_lookup.clear();
+    m_stats.hits = 0;
+    m_stats.misses = 0;
+    m_stats.evictions = 0;
+    m_stats.bytes = 0;
+}
+
+ShapeCache::Stats ShapeCache::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats snapshot = m_stats;
+    snapshot.entries = m_entries.size();
+    return snapshot;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "PersistentNaming.h"
+#include "ShapeHash.h"
+
+#include <TopoDS_Edge.hxx>
+#include <TopoDS_Shape.hxx>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Process-wide memo of FeatureOps results. Inputs are keyed by ShapeHash::contentHash,
+// so an identical shape rebuilt from scratch still hits; a hit also compares the inputs'
+// full fingerprints, the surface type, bounds and area of each of their faces, and the
+// parameter bytes. Eviction is LRU under a byte budget.
+// Results are handed out to every caller with an equal key, so they must never be modified
+// in place, meshing included.
+class ShapeCache {
+public:
+    class Key {
+    public:
+        explicit Key(std::string operation) : m_operation(std::move(operation)) {}
+
+        Key &shape(const TopoDS_Shape &input);
+        // An edge of an input by its geometry (curve type, end points, midpoint), which,
+        // unlike its position in an edge map, equal inputs are guaranteed to share.
+        Key &edge(const TopoDS_Edge &edge);
+        template <typename T>
+        Key &param(const T &value) {
+            static_assert(std::is_trivially_copyable_v<T>, "parameters are compared bytewise");
+            ShapeHash::combineValue(m_parameters, value);
+            m_parameterBytes.append(reinterpret_cast<const char *>(&value), sizeof(T));
+            return *this;
+        }
+
+        bool operator==(const Key &other) const;
+        std::size_t hash() const;
+        // Memory held by the key itself, mostly the input fingerprints and face keys.
+        std::size_t bytes() const;
+
+    private:
+        friend class ShapeCache;
+        std::string m_operation;
+        std::size_t m_parameters{0};
+        std::string m_parameterBytes;
+        std::vector<std::size_t> m_inputs;
+        std::vector<std::vector<std::int64_t>> m_fingerprints;
+        std::vector<std::vector<ShapeHash::FaceKey>> m_faces;
+        // Handle identities of the inputs; not part of equality, only used to decide
+        // whether a cached naming journal still refers to the caller's sub-shapes.
+        std::vector<std::size_t> m_identities;
+    };
+
+    struct Stats {
+        std::size_t hits{0};
+        std::size_t misses{0};
+        std::size_t evictions{0};
+        std::size_t entries{0};
+        std::size_t bytes{0};
+        std::size_t capacityBytes{0};
+    };
+
+    static ShapeCache &instance();
+
+    template <typename Compute>
+    TopoDS_Shape getOrCompute(const Key &key, Compute &&compute) {
+        if (!isEnabled()) return compute();
+        TopoDS_Shape cached;
+        if (lookup(key, cached)) return cached;
+
+        NamingJournal journal;
+        NamingJournal *outer = PersistentNaming::activeJournal();
+        const bool namingRecorded = PersistentNaming::isEnabled();
+        TopoDS_Shape result;
+        {
+            PersistentNaming::JournalScope scope(&journal);
+            result = compute();
+        }
+        if (outer) outer->append(journal);
+        if (!result.IsNull()) store(key, result, journal, namingRecorded);
+        return result;
+    }
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    void setCapacity(std::size_t bytes);
+    void clear();
+    Stats stats() const;
+
+private:
+    struct KeyHasher {
+        std::size_t operator()(const Key &key) const { return key.hash(); }
+    };
+    struct Entry {
+        Key key;
+        TopoDS_Shape result;
+        NamingJournal naming;
+        bool namingRecorded{false};
+        std::size_t bytes{0};
+    };
+
+    ShapeCache();
+    bool lookup(const Key &key, TopoDS_Shape &result);
+    void store(const Key &key, const TopoDS_Shape &result, const NamingJournal &naming, bool namingRecorded);
+    void evictLocked();
+
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_entries;  // most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHasher> m_lookup;
+    bool m_enabled{true};
+    Stats m_stats;
+};
@@ -0,0 +1,138 @@
+#include "ShapeHash.h"
+
+#include <BRepAdaptor_Curve.hxx>
+#include <BRepAdaptor_Surface.hxx>
+#include <BRepBndLib.hxx>
+#include <BRepGProp.hxx>
+#include <BRepTools.hxx>
+#include <BRep_Tool.hxx>
+#include <Bnd_Box.hxx>
+#include <GProp_GProps.hxx>
+#include <TopAbs_ShapeEnum.hxx>
+#include <TopExp.hxx>
+#include <TopLoc_Location.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+#include <TopoDS.hxx>
+#include <algorithm>
+#include <gp_Pnt.hxx>
+#include <gp_Trsf.hxx>
+
+namespace {
+constexpr double kFaceTolerance = 1e-6;
+
+void appendPoint(std::vector<std::int64_t> &values, const gp_Pnt &point) {
+    values.push_back(ShapeHash::quantize(point.X()));
+    values.push_back(ShapeHash::quantize(point.Y()));
+    values.push_back(ShapeHash::quantize(point.Z()));
+}
+
+bool nearlyEqual(double a, double b) {
+    return std::abs(a - b) <= kFaceTolerance * std::max({1.0, std::abs(a), std::abs(b)});
+}
+}
+
+namespace ShapeHash {
+
+std::size_t identity(const TopoDS_Shape &shape) {
+    std::size_t seed = 0;
+    if (shape.IsNull()) return seed;
+
+    combineValue(seed, reinterpret_cast<std::uintptr_t>(shape.TShape().get()));
+    combineValue(seed, static_cast<int>(shape.Orientation()));
+    if (!shape.Location().IsIdentity()) {
+        const gp_Trsf trsf = shape.Location().Transformation();
+        for (int r = 1; r <= 3; ++r) {
+            for (int c = 1; c <= 4; ++c) {
+                combineValue(seed, trsf.Value(r, c));
+            }
+        }
+    }
+    return seed;
+}
+
+std::size_t contentHash(const TopoDS_Shape &shape) {
+    if (shape.IsNull()) return 0;
+    return hashFingerprint(fingerprint(shape));
+}
+
+std::vector<std::int64_t> fingerprint(const TopoDS_Shape &shape) {
+    std::vector<std::int64_t> values;
+    if (shape.IsNull()) return values;
+
+    TopTools_IndexedMapOfShape vertices;
+    TopTools_IndexedMapOfShape edges;
+    TopTools_IndexedMapOfShape faces;
+    TopExp::MapShapes(shape, TopAbs_VERTEX, vertices);
+    TopExp::MapShapes(shape, TopAbs_EDGE, edges);
+    TopExp::MapShapes(shape, TopAbs_FACE, faces);
+
+    values.reserve(4 + 3 * vertices.Extent() + 4 * edges.Extent() + 5 * faces.Extent());
+    values.push_back(static_cast<int>(shape.ShapeType()));
+    values.push_back(vertices.Extent());
+    values.push_back(edges.Extent());
+    values.push_back(faces.Extent());
+
+    for (int i = 1; i <= vertices.Extent(); ++i) {
+        appendPoint(values, BRep_Tool::Pnt(TopoDS::Vertex(vertices(i))));
+    }
+    for (int i = 1; i <= edges.Extent(); ++i) {
+        const TopoDS_Edge &edge = TopoDS::Edge(edges(i));
+        if (BRep_Tool::Degenerated(edge)) {
+            values.push_back(-1);
+            continue;
+        }
+        BRepAdaptor_Curve curve(edge);
+        values.push_back(static_cast<int>(curve.GetType()));
+        appendPoint(values, curve.Value(0.5 * (curve.FirstParameter() + curve.LastParameter())));
+    }
+    for (int i = 1; i <= faces.Extent(); ++i) {
+        const TopoDS_Face &face = TopoDS::Face(faces(i));
+        BRepAdaptor_Surface surface(face);
+        double u1 = 0.0, u2 = 0.0, v1 = 0.0, v2 = 0.0;
+        BRepTools::UVBounds(face, u1, u2, v1, v2);
+        values.push_back(static_cast<int>(surface.GetType()));
+        values.push_back(static_cast<int>(face.Orientation()));
+        appendPoint(values, surface.Value(0.5 * (u1 + u2), 0.5 * (v1 + v2)));
+    }
+    return values;
+}
+
+std::size_t hashFingerprint(const std::vector<std::int64_t> &fingerprint) {
+    std::size_t seed = 0;
+    for (std::int64_t value : fingerprint) {
+        combineValue(seed, value);
+    }
+    return seed;
+}
+
+std::vector<FaceKey> faceKeys(const TopTools_IndexedMapOfShape &faces) {
+    std::vector<FaceKey> keys(faces.Extent());
+    for (int i = 1; i <= faces.Extent(); ++i) {
+        const TopoDS_Face &face = TopoDS::Face(faces(i));
+        FaceKey &key = keys[i - 1];
+        key.surface = static_cast<std::int32_t>(BRepAdaptor_Surface(face, Standard_False).GetType());
+        Bnd_Box box;
+        BRepBndLib::Add(face, box, false);
+        if (!box.IsVoid()) {
+            box.Get(key.bounds[0], key.bounds[1], key.bounds[2], key.bounds[3], key.bounds[4], key.bounds[5]);
+        }
+        GProp_GProps props;
+        BRepGProp::SurfaceProperties(face, props);
+        key.area = props.Mass();
+    }
+    return keys;
+}
+
+bool sameFace(const FaceKey &a, const FaceKey &b) {
+    if (a.surface != b.surface || !nearlyEqual(a.area, b.area)) return false;
+    for (int i = 0; i < 6; ++i) {
+        if (!nearlyEqual(a.bounds[i], b.bounds[i])) return false;
+    }
+    return true;
+}
+
+bool sameFaces(const std::vector<FaceKey> &a, const std::vector<FaceKey> &b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), sameFace);
+}
+
+} // namespace ShapeHash
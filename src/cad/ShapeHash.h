@@ -0,0 +1,47 @@
+#pragma once
+
+#include <TopTools_IndexedMapOfShape.hxx>
+#include <TopoDS_Shape.hxx>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace ShapeHash {
+inline void combine(std::size_t &seed, std::size_t value) {
+    seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
+
+template <typename T>
+inline void combineValue(std::size_t &seed, const T &value) {
+    combine(seed, std::hash<T>{}(value));
+}
+
+// Coordinates are compared on a 1e-6 grid.
+inline std::int64_t quantize(double value) {
+    return std::llround(value / 1.0e-6);
+}
+
+// Identity of a shape handle: same TShape, location and orientation.
+std::size_t identity(const TopoDS_Shape &shape);
+// Geometry of a shape independent of the handle: vertex positions, curve and surface
+// types and sample points, quantized to 1e-6. Equal for identically rebuilt shapes.
+std::size_t contentHash(const TopoDS_Shape &shape);
+// The quantized values contentHash() folds, for callers that must rule out hash collisions.
+std::vector<std::int64_t> fingerprint(const TopoDS_Shape &shape);
+std::size_t hashFingerprint(const std::vector<std::int64_t> &fingerprint);
+
+// Surface type, bounds and area of one face. Fingerprints only sample a few points, so
+// callers that trust an equal fingerprint check these face by face as well.
+struct FaceKey {
+    std::int32_t surface{-1};
+    double bounds[6]{};
+    double area{0.0};
+};
+// One key per face of the map, in its order.
+std::vector<FaceKey> faceKeys(const TopTools_IndexedMapOfShape &faces);
+// Same surface type, and bounds and area equal to within 1e-6 relative.
+bool sameFace(const FaceKey &a, const FaceKey &b);
+bool sameFaces(const std::vector<FaceKey> &a, const std::vector<FaceKey> &b);
+}
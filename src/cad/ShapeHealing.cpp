@@ -0,0 +1,230 @@
+#include "ShapeHealing.h"
+#include "../utils/Logging.h"
+
+#include <BRepBuilderAPI_Copy.hxx>
+#include <BRepCheck_Analyzer.hxx>
+#include <BRep_Builder.hxx>
+#include <BRep_Tool.hxx>
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include <ShapeExtend_Status.hxx>
+#include <ShapeFix_FixSmallFace.hxx>
+#include <ShapeFix_Shape.hxx>
+#include <ShapeFix_ShapeTolerance.hxx>
+#include <ShapeFix_Wireframe.hxx>
+#include <ShapeUpgrade_UnifySameDomain.hxx>
+#include <Standard_Failure.hxx>
+#include <TopExp.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Compound.hxx>
+#include <TopoDS_Iterator.hxx>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+struct Piece {
+    TopoDS_Shape shape;  // unlocated prototype
+    TopoDS_Shape healed;
+    ShapeHealing::Report report;
+};
+
+// Compounds are opened up to their non-compound leaves; everything else is one piece.
+void collectLeaves(const TopoDS_Shape &shape, std::vector<TopoDS_Shape> &leaves) {
+    if (shape.ShapeType() != TopAbs_COMPOUND) {
+        leaves.push_back(shape);
+        return;
+    }
+    for (TopoDS_Iterator it(shape); it.More(); it.Next()) {
+        collectLeaves(it.Value(), leaves);
+    }
+}
+
+int count(const TopoDS_Shape &shape, TopAbs_ShapeEnum type) {
+    TopTools_IndexedMapOfShape map;
+    TopExp::MapShapes(shape, type, map);
+    return map.Extent();
+}
+
+double maxTolerance(const TopoDS_Shape &shape) {
+    double tolerance = 0.0;
+    for (TopExp_Explorer it(shape, TopAbs_VERTEX); it.More(); it.Next()) {
+        tolerance = std::max(tolerance, BRep_Tool::Tolerance(TopoDS::Vertex(it.Current())));
+    }
+    for (TopExp_Explorer it(shape, TopAbs_EDGE); it.More(); it.Next()) {
+        tolerance = std::max(tolerance, BRep_Tool::Tolerance(TopoDS::Edge(it.Current())));
+    }
+    return tolerance;
+}
+
+// `fixed` is set when a fixer reports work done. Repairs such as added pcurves, reordered
+// wires or a reoriented shell change neither counts nor tolerances.
+TopoDS_Shape healPiece(const TopoDS_Shape &input, const ShapeHealing::Options &options, bool &fixed) {
+    ShapeFix_Shape fixer(input);
+    fixer.SetPrecision(options.precision);
+    fixer.SetMaxTolerance(options.maxTolerance);
+    fixer.Perform();
+    TopoDS_Shape shape = fixer.Shape();
+    fixed = fixer.Status(ShapeExtend_DONE);
+
+    ShapeFix_Wireframe wireframe(shape);
+    wireframe.SetPrecision(options.minEdgeLength);
+    wireframe.SetMaxTolerance(options.maxTolerance);
+    wireframe.ModeDropSmallEdges() = Standard_True;
+    wireframe.FixSmallEdges();
+    wireframe.FixWireGaps();
+    shape = wireframe.Shape();
+    fixed = fixed || wireframe.StatusSmallEdges(ShapeExtend_DONE) || wireframe.StatusWireGaps(ShapeExtend_DONE);
+
+    ShapeFix_FixSmallFace smallFaces;
+    smallFaces.Init(shape);
+    smallFaces.SetPrecision(options.minEdgeLength);
+    smallFaces.SetMaxTolerance(options.maxTolerance);
+    smallFaces.Perform();
+    shape = smallFaces.FixShape();
+
+    if (options.unifySameDomain) {
+        ShapeUpgrade_UnifySameDomain unify(shape, Standard_True, Standard_True, Standard_False);
+        unify.Build();
+        shape = unify.Shape();
+    }
+
+    ShapeFix_ShapeTolerance().LimitTolerance(shape, options.precision, options.maxTolerance);
+    return shape;
+}
+}
+
+void ShapeHealing::Report::merge(const Report &other) {
+    pieces += other.pieces;
+    healed += other.healed;
+    rejected += other.rejected;
+    facesBefore += other.facesBefore;
+    facesAfter += other.facesAfter;
+    edgesBefore += other.edgesBefore;
+    edgesAfter += other.edgesAfter;
+    maxToleranceBefore = std::max(maxToleranceBefore, other.maxToleranceBefore);
+    maxToleranceAfter = std::max(maxToleranceAfter, other.maxToleranceAfter);
+    elapsedMs += other.elapsedMs;
+}
+
+QString ShapeHealing::Report::summary() const {
+    return QStringLiteral("%1: healed %2 of %3 pieces (%4 kept as read), faces %5 -> %6, edges %7 -> %8, max tolerance %9 -> %10 in %11 ms")
+        .arg(source.isEmpty() ? QStringLiteral("shape") : source)
+        .arg(healed)
+        .arg(pieces)
+        .arg(rejected)
+        .arg(facesBefore)
+        .arg(facesAfter)
+        .arg(edgesBefore)
+        .arg(edgesAfter)
+        .arg(maxToleranceBefore)
+        .arg(maxToleranceAfter)
+        .arg(elapsedMs);
+}
+
+QJsonObject ShapeHealing::Report::toJson() const {
+    QJsonObject obj;
+    obj["source"] = source;
+    obj["pieces"] = pieces;
+    obj["healed"] = healed;
+    obj["rejected"] = rejected;
+    obj["facesBefore"] = facesBefore;
+    obj["facesAfter"] = facesAfter;
+    obj["edgesBefore"] = edgesBefore;
+    obj["edgesAfter"] = edgesAfter;
+    obj["maxToleranceBefore"] = maxToleranceBefore;
+    obj["maxToleranceAfter"] = maxToleranceAfter;
+    obj["elapsedMs"] = elapsedMs;
+    return obj;
+}
+
+ShapeHealing::ShapeHealing() = default;
+
+ShapeHealing::ShapeHealing(const Options &options) : m_options(options) {}
+
+TopoDS_Shape ShapeHealing::heal(const TopoDS_Shape &shape, Report *report) const {
+    QElapsedTimer timer;
+    timer.start();
+    if (shape.IsNull()) return shape;
+
+    // Instances share their TShape, so each distinct piece is healed once. Distinct pieces can
+    // still share edges and vertices, and the fixers adjust tolerances in place, so every worker
+    // heals its own deep copy; rolling a piece back just drops the copy.
+    std::vector<TopoDS_Shape> leaves;
+    collectLeaves(shape, leaves);
+    std::vector<Piece> pieces;
+    std::unordered_map<const TopoDS_TShape *, std::size_t> pieceOf;
+    std::vector<std::size_t> leafPiece;
+    leafPiece.reserve(leaves.size());
+    for (const auto &leaf : leaves) {
+        const auto inserted = pieceOf.emplace(leaf.TShape().get(), pieces.size());
+        if (inserted.second) {
+            Piece piece;
+            piece.shape = leaf.Located(TopLoc_Location());
+            pieces.push_back(std::move(piece));
+        }
+        leafPiece.push_back(inserted.first->second);
+    }
+
+    const Options options = m_options;
+    QtConcurrent::blockingMap(pieces, [options](Piece &piece) {
+        Report &stats = piece.report;
+        stats.pieces = 1;
+        stats.facesBefore = count(piece.shape, TopAbs_FACE);
+        stats.edgesBefore = count(piece.shape, TopAbs_EDGE);
+        stats.maxToleranceBefore = maxTolerance(piece.shape);
+        const bool wasValid = BRepCheck_Analyzer(piece.shape).IsValid();
+        bool fixed = false;
+        try {
+            const TopoDS_Shape copy = BRepBuilderAPI_Copy(piece.shape, Standard_True, Standard_False).Shape();
+            piece.healed = healPiece(copy, options, fixed);
+        } catch (const Standard_Failure &failure) {
+            Logging::warn(QStringLiteral("Shape healing failed: %1").arg(QString::fromLatin1(failure.GetMessageString())));
+        }
+        // Only a valid piece made invalid is rolled back. Anything the fixers repaired is
+        // kept, even when the piece is still not valid.
+        const bool valid = !piece.healed.IsNull() && BRepCheck_Analyzer(piece.healed).IsValid();
+        if (piece.healed.IsNull() || (wasValid && !valid)) {
+            piece.healed = piece.shape;
+            stats.rejected = 1;
+        } else if (fixed || (valid && !wasValid) || count(piece.healed, TopAbs_FACE) != stats.facesBefore
+                   || count(piece.healed, TopAbs_EDGE) != stats.edgesBefore
+                   || maxTolerance(piece.healed) != stats.maxToleranceBefore) {
+            stats.healed = 1;
+            if (!valid) {
+                Logging::warn(QStringLiteral("Shape healing left a piece invalid"));
+            }
+        } else {
+            piece.healed = piece.shape;
+        }
+        stats.facesAfter = count(piece.healed, TopAbs_FACE);
+        stats.edgesAfter = count(piece.healed, TopAbs_EDGE);
+        stats.maxToleranceAfter = maxTolerance(piece.healed);
+    });
+
+    TopoDS_Shape result;
+    if (leaves.size() == 1 && shape.ShapeType() != TopAbs_COMPOUND) {
+        result = pieces.front().healed.Moved(shape.Location());
+    } else {
+        BRep_Builder builder;
+        TopoDS_Compound compound;
+        builder.MakeCompound(compound);
+        for (std::size_t i = 0; i < leaves.size(); ++i) {
+            builder.Add(compound, pieces[leafPiece[i]].healed.Moved(leaves[i].Location()));
+        }
+        result = compound;
+    }
+
+    if (report) {
+        const QString source = report->source;
+        *report = Report();
+        report->source = source;
+        for (const auto &piece : pieces) {
+            report->merge(piece.report);
+        }
+        report->elapsedMs = timer.elapsed();
+    }
+    return result;
+}
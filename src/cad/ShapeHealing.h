@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+#include <TopoDS_Shape.hxx>
+
+// Post-import repair for supplier geometry: ShapeFix, removal of tiny edges and sliver
+// faces, merging of same-domain faces and a cap on tolerances. Every distinct solid (or other
+// non-compound piece) is healed on its own worker; located instances of one piece are healed
+// once and share the result. Each piece is healed on a copy, so the input is never modified;
+// pieces left unchanged or rolled back are returned as read.
+class ShapeHealing {
+public:
+    struct Options {
+        double precision{1e-6};
+        double maxTolerance{1e-2};     // tolerances are capped to this after fixing
+        double minEdgeLength{1e-4};    // shorter edges are dropped, smaller faces removed
+        bool unifySameDomain{true};
+    };
+
+    struct Report {
+        QString source;
+        int pieces{0};
+        int healed{0};     // pieces the fixers repaired or whose topology or tolerances changed
+        int rejected{0};   // pieces kept as read because healing made them invalid
+        int facesBefore{0};
+        int facesAfter{0};
+        int edgesBefore{0};
+        int edgesAfter{0};
+        double maxToleranceBefore{0.0};
+        double maxToleranceAfter{0.0};
+        qint64 elapsedMs{0};
+
+        void merge(const Report &other);
+        QString summary() const;
+        QJsonObject toJson() const;
+    };
+
+    ShapeHealing();
+    explicit ShapeHealing(const Options &options);
+
+    TopoDS_Shape heal(const TopoDS_Shape &shape, Report *report = nullptr) const;
+
+    const Options &options() const { return m_options; }
+
+private:
+    Options m_options;
+};
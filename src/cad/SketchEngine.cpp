@@ -1,76 +1,161 @@
 #include "SketchEngine.h"
+#include "ProfileBuilder.h"
+#include "ShapeHash.h"
 
-#include <BRepBuilderAPI_MakeEdge.hxx>
-#include <BRepBuilderAPI_MakeFace.hxx>
-#include <BRepBuilderAPI_MakeWire.hxx>
-#include <Geom_Circle.hxx>
 #include <Geom_Line.hxx>
+#include <Message_ProgressIndicator.hxx>
+#include <Message_ProgressScope.hxx>
 #include <Standard_Version.hxx>
-#include <gp_Ax2.hxx>
 #include <gp_Dir.hxx>
 #include <gp_Pnt.hxx>
 #include <QRandomGenerator>
+#include <QPromise>
 #include <QtConcurrent>
+#include <algorithm>
+#include <unordered_map>
 
 namespace {
+constexpr int kProgressSteps = 1000;
+
 QString newId() {
     return QString::number(QRandomGenerator::global()->generate64(), 16);
 }
+
+// Bridges OCCT progress reporting to the QPromise of a background regeneration:
+// position updates become QFuture progress and QFuture::cancel() becomes a user break.
+class PromiseProgress : public Message_ProgressIndicator {
+public:
+    explicit PromiseProgress(QPromise<TopoDS_Shape> &promise) : m_promise(promise) {}
+
+    Standard_Boolean UserBreak() override { return m_promise.isCanceled(); }
+
+    void Show(const Message_ProgressScope &, const Standard_Boolean) override {
+        m_promise.setProgressValue(static_cast<int>(GetPosition() * kProgressSteps));
+    }
+
+private:
+    QPromise<TopoDS_Shape> &m_promise;
+};
 }
 
 QString Sketch2D::addLine(const gp_Pnt2d &a, const gp_Pnt2d &b) {
+    ++m_revision;
     SketchPrimitive prim;
     prim.kind = SketchPrimitive::Kind::Line;
     prim.id = newId();
     prim.start = a;
     prim.end = b;
-    m_primitives.push_back(prim);
+    m_handles.emplace(prim.id, m_geometry.add(prim));
+    m_structureChanged = true;
     return prim.id;
 }
 
 QString Sketch2D::addCircle(const gp_Pnt2d &center, double radius) {
+    ++m_revision;
     SketchPrimitive prim;
     prim.kind = SketchPrimitive::Kind::Circle;
     prim.id = newId();
     prim.start = center;
     prim.radius = radius;
-    m_primitives.push_back(prim);
+    m_handles.emplace(prim.id, m_geometry.add(prim));
+    m_structureChanged = true;
     return prim.id;
 }
 
 void Sketch2D::addConstraint(const SketchConstraint &c) {
-    m_constraints.push_back(c);
+    ++m_revision;
+    m_constraints.push_back({c.type, handleOf(c.a), handleOf(c.b), c.value});
+    m_structureChanged = true;
 }
 
 void Sketch2D::addDimension(const SketchDimension &d) {
-    m_dimensions.push_back(d);
+    ++m_revision;
+    m_dimensionIndex[d.id] = m_dimensions.size();
+    m_dimensions.push_back({handleOf(d.target), d.value});
+    m_structureChanged = true;
 }
 
 void Sketch2D::updateDimension(const QString &id, double newValue) {
-    for (auto &dim : m_dimensions) {
-        if (dim.id == id) {
-            dim.value = newValue;
+    ++m_revision;
+    SlotHandle target;
+    const auto dimension = m_dimensionIndex.find(id);
+    if (dimension != m_dimensionIndex.end()) {
+        BoundDimension &dim = m_dimensions[dimension->second];
+        dim.value = newValue;
+        target = dim.target;
+    } else {
+        // Ids of circles drive their radius directly.
+        const SlotHandle handle = handleOf(id);
+        const std::size_t row = m_geometry.handles.row(handle);
+        if (row != SlotMap::npos && m_geometry.kind[row] == SketchPrimitive::Kind::Circle) {
+            m_geometry.radius[row] = newValue;
+            target = handle;
         }
     }
-    for (auto &prim : m_primitives) {
-        if (prim.id == id && prim.kind == SketchPrimitive::Kind::Circle) {
-            prim.radius = newValue;
+
+    if (m_structureChanged) {
+        solve();
+    } else if (target.isValid()) {
+        const std::size_t row = m_geometry.handles.row(target);
+        if (row != SlotMap::npos) {
+            // Warm start: the cluster is solved from its previous solution.
+            m_lastSolve = m_solver.solveFor(row, m_geometry, m_constraints, m_dimensions);
         }
     }
 }
 
+bool Sketch2D::removePrimitive(const QString &id) {
+    const auto found = m_handles.find(id);
+    if (found == m_handles.end()) return false;
+    m_geometry.remove(found->second);
+    m_handles.erase(found);
+    ++m_revision;
+    m_structureChanged = true;
+    return true;
+}
+
+SlotHandle Sketch2D::handleOf(const QString &id) const {
+    const auto found = m_handles.find(id);
+    return found == m_handles.end() ? SlotHandle() : found->second;
+}
+
+SketchPrimitive Sketch2D::primitive(const QString &id) const {
+    const std::size_t row = m_geometry.handles.row(handleOf(id));
+    if (row == SlotMap::npos) return SketchPrimitive{SketchPrimitive::Kind::Line, QString(), gp_Pnt2d(), gp_Pnt2d(), 0.0};
+    return m_geometry.primitiveAt(row);
+}
+
+SketchSolver::Report Sketch2D::solve() {
+    if (!m_structureChanged) return m_lastSolve;
+    m_solver.analyze(m_geometry, m_constraints, m_dimensions);
+    m_lastSolve = m_solver.solveAll(m_geometry, m_constraints, m_dimensions);
+    m_structureChanged = false;
+    ++m_revision;
+    return m_lastSolve;
+}
+
 TopoDS_Shape Sketch2D::toFace() const {
-    BRepBuilderAPI_MakeWire wireBuilder;
-    for (const auto &prim : m_primitives) {
-        if (prim.kind == SketchPrimitive::Kind::Line) {
-            wireBuilder.Add(BRepBuilderAPI_MakeEdge(gp_Pnt(prim.start.X(), prim.start.Y(), 0), gp_Pnt(prim.end.X(), prim.end.Y(), 0)));
-        } else if (prim.kind == SketchPrimitive::Kind::Circle) {
-            Handle(Geom_Circle) circle = new Geom_Circle(gp_Ax2(gp_Pnt(prim.start.X(), prim.start.Y(), 0), gp::DZ()), prim.radius);
-            wireBuilder.Add(BRepBuilderAPI_MakeEdge(circle));
-        }
-    }
-    TopoDS_Wire wire = wireBuilder.Wire();
-    return BRepBuilderAPI_MakeFace(wire);
+    return ProfileBuilder().build(m_geometry).shape;
+}
+
+FeatureTree::FeatureTree(const FeatureTree &other) {
+    std::lock_guard<std::mutex> lock(other.m_evalMutex);
+    m_profile = other.m_profile;
+    m_history = other.m_history;
+    m_cache = other.m_cache;
+    m_edgeRefs = other.m_edgeRefs;
+    m_lastRecomputed = other.m_lastRecomputed;
+}
+
+FeatureTree &FeatureTree::operator=(const FeatureTree &other) {
+    if (this == &other) return *this;
+    std::scoped_lock lock(m_evalMutex, other.m_evalMutex);
+    m_profile = other.m_profile;
+    m_history = other.m_history;
+    m_cache = other.m_cache;
+    m_edgeRefs = other.m_edgeRefs;
+    m_lastRecomputed = other.m_lastRecomputed;
+    return *this;
 }
 
 void FeatureTree::setProfile(const TopoDS_Shape &face) {
@@ -79,87 +164,294 @@ void FeatureTree::setProfile(const TopoDS_Shape &face) {
 
 void FeatureTree::push(const Node &node) {
     m_history.push_back(node);
+    m_edgeRefs.resize(m_history.size());
+}
+
+void FeatureTree::update(std::size_t index, const Node &node) {
+    if (index >= m_history.size()) return;
+    const auto sameEdges = [](const FeatureOps::EdgeFillet &a, const FeatureOps::EdgeFillet &b) { return a.edge == b.edge; };
+    const std::vector<FeatureOps::EdgeFillet> &previous = m_history[index].edges;
+    // A new selection is made against the current input, so it is anchored afresh.
+    if (!std::equal(previous.begin(), previous.end(), node.edges.begin(), node.edges.end(), sameEdges)) {
+        m_edgeRefs.resize(m_history.size());
+        m_edgeRefs[index].clear();
+    }
+    m_history[index] = node;
 }
 
-TopoDS_Shape FeatureTree::replay() const {
-    TopoDS_Shape current = m_profile;
+void FeatureTree::clearCache() {
+    std::lock_guard<std::mutex> lock(m_evalMutex);
+    m_cache.clear();
+}
+
+void FeatureTree::adoptCache(const FeatureTree &other) {
+    if (this == &other) return;
+    std::scoped_lock lock(m_evalMutex, other.m_evalMutex);
+    m_cache = other.m_cache;
+    m_edgeRefs = other.m_edgeRefs;
+}
+
+std::size_t FeatureTree::nodeKey(const Node &node, std::size_t inputKey) {
+    std::size_t key = inputKey;
+    ShapeHash::combineValue(key, static_cast<int>(node.type));
+    ShapeHash::combineValue(key, node.value);
+    const gp_Pnt &origin = node.axis.Location();
+    const gp_Dir &axisDir = node.axis.Direction();
+    for (double v : {origin.X(), origin.Y(), origin.Z(), axisDir.X(), axisDir.Y(), axisDir.Z(),
+                     node.draftDir.X(), node.draftDir.Y(), node.draftDir.Z()}) {
+        ShapeHash::combineValue(key, v);
+    }
+    for (const auto &edge : node.edges) {
+        ShapeHash::combineValue(key, edge.edge);
+        ShapeHash::combineValue(key, edge.radius);
+    }
+    if (node.toolTree) {
+        ShapeHash::combine(key, node.toolTree->resultKey(node.toolTree->m_profile));
+    } else {
+        ShapeHash::combine(key, ShapeHash::identity(node.tool));
+    }
+    return key;
+}
+
+std::size_t FeatureTree::resultKey(const TopoDS_Shape &seed) const {
+    std::size_t key = ShapeHash::identity(seed);
     for (const auto &node : m_history) {
-        switch (node.type) {
-        case NodeType::Extrude:
-            current = FeatureOps::extrude(current, node.value);
-            break;
-        case NodeType::Revolve:
-            current = FeatureOps::revolve(current, node.axis, node.value);
-            break;
-        case NodeType::Cut:
-            current = FeatureOps::cut(current, node.tool);
-            break;
-        case NodeType::Fillet:
-            current = FeatureOps::fillet(current, node.value);
-            break;
-        case NodeType::Chamfer:
-            current = FeatureOps::chamfer(current, node.value);
-            break;
-        case NodeType::Shell:
-            current = FeatureOps::shell(current, node.value);
-            break;
-        case NodeType::Draft:
-            current = FeatureOps::draft(current, node.draftDir, node.value);
-            break;
+        key = nodeKey(node, key);
+    }
+    return key;
+}
+
+std::vector<FeatureOps::EdgeFillet> FeatureTree::selectEdges(std::size_t index, const TopoDS_Shape &input) const {
+    std::vector<FeatureOps::EdgeFillet> edges = m_history[index].edges;
+    if (edges.empty()) return edges;
+    m_edgeRefs.resize(m_history.size());
+    std::vector<EdgeIndex::Reference> &refs = m_edgeRefs[index];
+    const auto edgeIndex = EdgeIndex::forShape(input);
+    if (refs.size() != edges.size()) {
+        refs.clear();
+        for (const auto &edge : edges) {
+            refs.push_back(edgeIndex->reference(edge.edge));
         }
+        return edges;
     }
-    return current;
+    for (std::size_t k = 0; k < edges.size(); ++k) {
+        const int found = edgeIndex->resolve(refs[k]);
+        if (found < 0) continue;
+        edges[k].edge = found;
+        refs[k] = edgeIndex->reference(found);
+    }
+    return edges;
 }
 
-TopoDS_Shape FeatureTree::recomputeFromHistory(const TopoDS_Shape &seed) const {
-    if (m_history.empty()) return seed;
-    auto worker = [this, seed]() {
-        TopoDS_Shape current = seed;
-        for (const auto &node : m_history) {
-            switch (node.type) {
-            case NodeType::Extrude:
-                current = FeatureOps::extrude(current, node.value);
-                break;
-            case NodeType::Revolve:
-                current = FeatureOps::revolve(current, node.axis, node.value);
-                break;
-            case NodeType::Cut:
-                current = FeatureOps::cut(current, node.tool);
-                break;
-            case NodeType::Fillet:
-                current = FeatureOps::fillet(current, node.value);
-                break;
-            case NodeType::Chamfer:
-                current = FeatureOps::chamfer(current, node.value);
-                break;
-            case NodeType::Shell:
-                current = FeatureOps::shell(current, node.value);
-                break;
-            case NodeType::Draft:
-                current = FeatureOps::draft(current, node.draftDir, node.value);
-                break;
+TopoDS_Shape FeatureTree::apply(const Node &node, const TopoDS_Shape &input, const TopoDS_Shape &tool,
+                                const std::vector<FeatureOps::EdgeFillet> &edges, const Message_ProgressRange &range) {
+    switch (node.type) {
+    case NodeType::Extrude:
+        return FeatureOps::extrude(input, node.value);
+    case NodeType::Revolve:
+        return FeatureOps::revolve(input, node.axis, node.value);
+    case NodeType::Cut:
+        return FeatureOps::cut(input, tool, range);
+    case NodeType::Fillet:
+        if (!edges.empty()) return FeatureOps::fillet(input, edges, range);
+        return FeatureOps::fillet(input, node.value, range);
+    case NodeType::Chamfer:
+        if (!edges.empty()) {
+            std::vector<int> numbers;
+            numbers.reserve(edges.size());
+            for (const auto &edge : edges) {
+                numbers.push_back(edge.edge);
+            }
+            return FeatureOps::chamfer(input, numbers, node.value, range);
+        }
+        return FeatureOps::chamfer(input, node.value, range);
+    case NodeType::Shell:
+        return FeatureOps::shell(input, node.value, range);
+    case NodeType::Draft:
+        return FeatureOps::draft(input, node.draftDir, node.value, range);
+    }
+    return input;
+}
+
+TopoDS_Shape FeatureTree::evaluate(const TopoDS_Shape &seed, const Message_ProgressRange &range) const {
+    std::lock_guard<std::mutex> lock(m_evalMutex);
+    const std::size_t count = m_history.size();
+    m_cache.resize(count);
+
+    // Keys chain through the history, so a changed node invalidates its whole suffix.
+    std::vector<std::size_t> keys(count);
+    std::size_t key = ShapeHash::identity(seed);
+    for (std::size_t i = 0; i < count; ++i) {
+        key = nodeKey(m_history[i], key);
+        keys[i] = key;
+    }
+
+    std::size_t start = 0;
+    TopoDS_Shape current = seed;
+    for (std::size_t i = count; i > 0; --i) {
+        const CacheSlot &slot = m_cache[i - 1];
+        if (slot.key == keys[i - 1] && !slot.result.IsNull()) {
+            start = i;
+            current = slot.result;
+            break;
+        }
+    }
+
+    // Tool sub-features of the dirty suffix are independent of the main chain: start them all
+    // on the pool now and join each one at the node that consumes it. Waiting on a future that
+    // has not started yet runs it on the waiting thread, so nested sub-features cannot starve.
+    // Each one replays under its own step of `progress`, so a user break stops it too and a
+    // stale regeneration lets go of a shared sub-feature quickly.
+    std::vector<const FeatureTree *> toolTrees;
+    for (std::size_t i = start; i < count; ++i) {
+        const FeatureTree *toolTree = m_history[i].toolTree.get();
+        if (toolTree && std::find(toolTrees.begin(), toolTrees.end(), toolTree) == toolTrees.end()) {
+            toolTrees.push_back(toolTree);
+        }
+    }
+
+    Message_ProgressScope progress(range, "Regenerate features",
+                                   static_cast<Standard_Real>(std::max<std::size_t>(count - start + toolTrees.size(), 1)));
+    // The jobs report into `progress`, so they are joined before it closes, early returns included.
+    struct ToolJobs {
+        ~ToolJobs() {
+            for (auto &job : futures) {
+                job.second.waitForFinished();
             }
         }
-        return current;
+        std::unordered_map<const FeatureTree *, QFuture<TopoDS_Shape>> futures;
+    } tools;
+    for (const FeatureTree *toolTree : toolTrees) {
+        const Message_ProgressRange toolRange = progress.Next();
+        tools.futures.emplace(toolTree, QtConcurrent::run([toolTree, toolRange]() { return toolTree->replay(toolRange); }));
+    }
+
+    const auto toolFor = [&tools](const Node &node) {
+        return node.toolTree ? tools.futures.at(node.toolTree.get()).result() : node.tool;
     };
-    QFuture<TopoDS_Shape> future = QtConcurrent::run(worker);
-    future.waitForFinished();
-    return future.result();
+
+    std::size_t i = start;
+    while (i < count) {
+        if (!progress.More()) {
+            m_lastRecomputed = i - start;
+            return TopoDS_Shape();
+        }
+        // Consecutive cuts are merged into one multi-tool boolean (bolt patterns, perforations).
+        std::size_t end = i + 1;
+        if (m_history[i].type == NodeType::Cut) {
+            while (end < count && m_history[end].type == NodeType::Cut) {
+                ++end;
+            }
+        }
+        const Message_ProgressRange nodeRange = progress.Next(static_cast<Standard_Real>(end - i));
+
+        NamingJournal naming;
+        TopoDS_Shape next;
+        {
+            PersistentNaming::JournalScope scope(&naming);
+            if (end - i > 1) {
+                std::vector<TopoDS_Shape> batch;
+                batch.reserve(end - i);
+                for (std::size_t k = i; k < end; ++k) {
+                    batch.push_back(toolFor(m_history[k]));
+                }
+                next = FeatureOps::cutMany(current, batch, FeatureOps::booleanOptions(), nodeRange);
+            } else {
+                next = apply(m_history[i], current, toolFor(m_history[i]), selectEdges(i, current), nodeRange);
+            }
+        }
+        if (progress.UserBreak()) {
+            m_lastRecomputed = i - start;
+            return TopoDS_Shape();
+        }
+        current = next;
+        // Only the last node of a merged batch holds a result; resuming inside it redoes the batch tail.
+        for (std::size_t k = i; k + 1 < end; ++k) {
+            m_cache[k] = CacheSlot();
+        }
+        m_cache[end - 1] = {keys[end - 1], current, std::move(naming)};
+        i = end;
+    }
+    m_lastRecomputed = count - start;
+    return current;
+}
+
+NamingJournal FeatureTree::naming() const {
+    NamingJournal journal;
+    for (std::size_t i = 0; i < m_cache.size() && i < m_history.size(); ++i) {
+        journal.append(m_cache[i].naming);
+    }
+    return journal;
 }
 
-SketchEngine::SketchEngine()
-    : m_sketch(std::make_unique<Sketch2D>()),
-      m_tree(std::make_unique<FeatureTree>()) {}
+TopoDS_Shape FeatureTree::replay(const Message_ProgressRange &range) const {
+    return evaluate(m_profile, range);
+}
+
+TopoDS_Shape FeatureTree::recomputeFromHistory(const TopoDS_Shape &seed, const Message_ProgressRange &range) const {
+    if (m_history.empty()) return seed;
+    return evaluate(seed, range);
+}
+
+SketchEngine::SketchEngine(QObject *parent)
+    : QObject(parent),
+      m_sketch(std::make_unique<Sketch2D>()),
+      m_tree(std::make_unique<FeatureTree>()) {
+    connect(&m_watcher, &QFutureWatcher<TopoDS_Shape>::progressValueChanged, this, [this](int value) {
+        emit regenerationProgress(static_cast<double>(value) / kProgressSteps);
+    });
+    connect(&m_watcher, &QFutureWatcher<TopoDS_Shape>::finished, this, &SketchEngine::onRegenerationFinished);
+}
+
+SketchEngine::~SketchEngine() {
+    m_pending.cancel();
+    m_pending.waitForFinished();
+}
+
+const TopoDS_Shape &SketchEngine::currentProfile() {
+    // Keep the same face while the sketch is unchanged so cached feature results stay valid.
+    m_sketch->solve();
+    if (!m_hasProfile || m_profileRevision != m_sketch->revision()) {
+        m_profile = m_sketch->toFace();
+        m_profileRevision = m_sketch->revision();
+        m_hasProfile = true;
+        m_tree->setProfile(m_profile);
+    }
+    return m_profile;
+}
 
 TopoDS_Shape SketchEngine::rebuild3D() {
-    TopoDS_Shape profile = m_sketch->toFace();
-    m_tree->setProfile(profile);
+    currentProfile();
     return m_tree->replay();
 }
 
 TopoDS_Shape SketchEngine::recomputeFromHistory() {
-    TopoDS_Shape profile = m_sketch->toFace();
-    m_tree->setProfile(profile);
-    return m_tree->recomputeFromHistory(profile);
+    return m_tree->recomputeFromHistory(currentProfile());
 }
 
+QFuture<TopoDS_Shape> SketchEngine::regenerateAsync() {
+    m_pending.cancel();
+
+    const TopoDS_Shape profile = currentProfile();
+    auto snapshot = std::make_shared<FeatureTree>(*m_tree);
+    m_pendingSnapshot = snapshot;
+    m_pending = QtConcurrent::run([snapshot, profile](QPromise<TopoDS_Shape> &promise) {
+        promise.setProgressRange(0, kProgressSteps);
+        Handle(PromiseProgress) progress = new PromiseProgress(promise);
+        const TopoDS_Shape result = snapshot->recomputeFromHistory(profile, progress->Start());
+        if (!promise.isCanceled()) {
+            promise.addResult(result);
+        }
+    });
+    m_watcher.setFuture(m_pending);
+    return m_pending;
+}
+
+void SketchEngine::onRegenerationFinished() {
+    if (!m_pending.isFinished() || m_pending.isCanceled() || m_pending.resultCount() == 0) return;
+    if (m_pendingSnapshot) {
+        m_tree->adoptCache(*m_pendingSnapshot);
+        m_pendingSnapshot.reset();
+    }
+    emit regenerated(m_pending.result());
+}
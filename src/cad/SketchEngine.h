@@ -1,53 +1,64 @@
 #pragma once
 
+#include "EdgeIndex.h"
 #include "FeatureOps.h"
+#include "PersistentNaming.h"
+#include "SketchSolver.h"
 
+#include <Message_ProgressRange.hxx>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QObject>
 #include <QString>
 #include <TopoDS_Shape.hxx>
+#include <cstddef>
+#include <cstdint>
 #include <gp_Pnt2d.hxx>
 #include <gp_Ax1.hxx>
 #include <gp_Dir.hxx>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
-struct SketchConstraint {
-    enum class Type { Equal, Parallel, Perpendicular, Tangent, Coincident, Radius, Distance };
-    Type type;
-    QString a;
-    QString b;
-    double value{0.0};
-};
-
-struct SketchDimension {
-    QString id;
-    QString target;
-    double value{0.0};
-};
-
-struct SketchPrimitive {
-    enum class Kind { Line, Circle };
-    Kind kind;
-    QString id;
-    gp_Pnt2d start;
-    gp_Pnt2d end;
-    double radius{0.0};
-};
-
+// Primitives live in SoA columns addressed by SlotHandle; QString ids are only resolved at
+// this API boundary through a hash index.
 class Sketch2D {
 public:
     QString addLine(const gp_Pnt2d &a, const gp_Pnt2d &b);
     QString addCircle(const gp_Pnt2d &center, double radius);
+    // Constraints and dimensions referring to unknown ids are kept but never solved.
     void addConstraint(const SketchConstraint &c);
     void addDimension(const SketchDimension &d);
+    // Re-solves only the cluster of the dimension's target once the sketch has been solved.
     void updateDimension(const QString &id, double newValue);
+    // Constraints and dimensions on the removed primitive stop taking part in the solve.
+    bool removePrimitive(const QString &id);
+
+    SlotHandle handleOf(const QString &id) const;
+    bool hasDimension(const QString &id) const { return m_dimensionIndex.count(id) > 0; }
+    std::size_t primitiveCount() const { return m_geometry.size(); }
+    SketchPrimitive primitive(const QString &id) const;
+    const SketchGeometry &geometry() const { return m_geometry; }
+
+    // Solves every cluster after primitives, constraints or dimensions were added; otherwise
+    // returns the report of the last solve.
+    SketchSolver::Report solve();
+    const SketchSolver::Report &lastSolve() const { return m_lastSolve; }
 
     TopoDS_Shape toFace() const;
+    std::uint64_t revision() const { return m_revision; }
 
 private:
-    std::vector<SketchPrimitive> m_primitives;
-    std::vector<SketchConstraint> m_constraints;
-    std::vector<SketchDimension> m_dimensions;
+    std::uint64_t m_revision{0};
+    bool m_structureChanged{false};
+    SketchSolver m_solver;
+    SketchSolver::Report m_lastSolve;
+    SketchGeometry m_geometry;
+    std::unordered_map<QString, SlotHandle> m_handles;
+    std::vector<BoundConstraint> m_constraints;
+    std::vector<BoundDimension> m_dimensions;
+    std::unordered_map<QString, std::size_t> m_dimensionIndex;
 };
 
 class FeatureTree {
@@ -59,21 +70,66 @@ public:
         gp_Ax1 axis;
         gp_Dir draftDir;
         TopoDS_Shape tool;
+        // Optional sub-feature that builds the tool body; evaluated concurrently with the main chain.
+        std::shared_ptr<const FeatureTree> toolTree;
+        // Fillet/Chamfer edge selection on the node's input; empty applies `value` to every edge.
+        // Chamfers use only the edge numbers and take the distance from `value`. The numbers
+        // refer to the input of the first replay; later replays follow the selected edges by
+        // their geometry, since upstream edits renumber them.
+        std::vector<FeatureOps::EdgeFillet> edges;
     };
 
+    FeatureTree() = default;
+    FeatureTree(const FeatureTree &other);
+    FeatureTree &operator=(const FeatureTree &other);
+
     void setProfile(const TopoDS_Shape &face);
     void push(const Node &node);
-    TopoDS_Shape replay() const;
-    TopoDS_Shape recomputeFromHistory(const TopoDS_Shape &seed) const;
+    void update(std::size_t index, const Node &node);
+    const std::vector<Node> &nodes() const { return m_history; }
+    // Each node, and each tool sub-feature it consumes, takes one step of the range; a user
+    // break returns a null shape and keeps the results of the nodes that already finished.
+    TopoDS_Shape replay(const Message_ProgressRange &range = Message_ProgressRange()) const;
+    TopoDS_Shape recomputeFromHistory(const TopoDS_Shape &seed, const Message_ProgressRange &range = Message_ProgressRange()) const;
+
+    void clearCache();
+    // Takes over cached results computed by a copy of this tree (e.g. a background snapshot).
+    void adoptCache(const FeatureTree &other);
+    // Number of nodes actually re-run by the last replay; the rest came from the cache.
+    std::size_t lastRecomputedCount() const { return m_lastRecomputed; }
+    // Sub-shape history of the last replay, one step per recorded operation.
+    NamingJournal naming() const;
 
 private:
+    struct CacheSlot {
+        std::size_t key{0};
+        TopoDS_Shape result;
+        NamingJournal naming;
+    };
+
+    static std::size_t nodeKey(const Node &node, std::size_t inputKey);
+    static TopoDS_Shape apply(const Node &node, const TopoDS_Shape &input, const TopoDS_Shape &tool,
+                              const std::vector<FeatureOps::EdgeFillet> &edges, const Message_ProgressRange &range);
+    // The node's edge selection renumbered for `input`.
+    std::vector<FeatureOps::EdgeFillet> selectEdges(std::size_t index, const TopoDS_Shape &input) const;
+    std::size_t resultKey(const TopoDS_Shape &seed) const;
+    TopoDS_Shape evaluate(const TopoDS_Shape &seed, const Message_ProgressRange &range) const;
+
+    // Serializes evaluations of the same tree, e.g. a tool sub-feature shared by two jobs.
+    mutable std::mutex m_evalMutex;
     TopoDS_Shape m_profile;
     std::vector<Node> m_history;
+    mutable std::vector<CacheSlot> m_cache;
+    // Where each node's selected edges were last found, refreshed on every resolution.
+    mutable std::vector<std::vector<EdgeIndex::Reference>> m_edgeRefs;
+    mutable std::size_t m_lastRecomputed{0};
 };
 
-class SketchEngine {
+class SketchEngine : public QObject {
+    Q_OBJECT
 public:
-    SketchEngine();
+    explicit SketchEngine(QObject *parent = nullptr);
+    ~SketchEngine() override;
 
     Sketch2D &sketch() { return *m_sketch; }
     FeatureTree &history() { return *m_tree; }
@@ -81,8 +137,26 @@ public:
     TopoDS_Shape rebuild3D();
     TopoDS_Shape recomputeFromHistory();
 
+    // Regenerates on the thread pool from a snapshot of the sketch and history. Starting a new
+    // job cancels the previous one, so only the newest edit ever emits regenerated().
+    QFuture<TopoDS_Shape> regenerateAsync();
+    bool isRegenerating() const { return m_pending.isRunning(); }
+
+signals:
+    void regenerationProgress(double fraction);
+    void regenerated(const TopoDS_Shape &shape);
+
 private:
+    const TopoDS_Shape &currentProfile();
+    void onRegenerationFinished();
+
     std::unique_ptr<Sketch2D> m_sketch;
     std::unique_ptr<FeatureTree> m_tree;
+    QFuture<TopoDS_Shape> m_pending;
+    std::shared_ptr<FeatureTree> m_pendingSnapshot;
+    QFutureWatcher<TopoDS_Shape> m_watcher;
+    TopoDS_Shape m_profile;
+    std::uint64_t m_profileRevision{0};
+    bool m_hasProfile{false};
 };
 
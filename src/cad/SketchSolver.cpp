@@ -0,0 +1,554 @@
+#include "SketchSolver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+constexpr int kMaxIterations = 100;
+constexpr double kTolerance = 1.0e-9;
+constexpr double kMinLength = 1.0e-12;
+
+struct Vec2 {
+    double x;
+    double y;
+};
+
+double length(const Vec2 &v) {
+    return std::max(std::hypot(v.x, v.y), kMinLength);
+}
+
+int findRoot(std::vector<int> &parent, int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+double dot(const std::vector<double> &a, const std::vector<double> &b) {
+    return std::inner_product(a.begin(), a.end(), b.begin(), 0.0);
+}
+
+double maxAbs(const std::vector<double> &v) {
+    double result = 0.0;
+    for (double value : v) {
+        result = std::max(result, std::abs(value));
+    }
+    return result;
+}
+
+// In-place Cholesky of a symmetric envelope matrix; row i stores columns first[i]..i.
+bool factorEnvelope(std::vector<double> &values, const std::vector<int> &first, const std::vector<std::size_t> &start) {
+    const std::size_t n = first.size();
+    for (std::size_t i = 0; i < n; ++i) {
+        double *row = values.data() + start[i] - first[i];
+        for (int j = first[i]; j <= static_cast<int>(i); ++j) {
+            const double *other = values.data() + start[j] - first[j];
+            double sum = row[j];
+            for (int k = std::max(first[i], first[j]); k < j; ++k) {
+                sum -= row[k] * other[k];
+            }
+            if (j < static_cast<int>(i)) {
+                row[j] = sum / other[j];
+            } else {
+                if (sum <= 0.0) return false;
+                row[j] = std::sqrt(sum);
+            }
+        }
+    }
+    return true;
+}
+
+void solveEnvelope(const std::vector<double> &values, const std::vector<int> &first,
+                   const std::vector<std::size_t> &start, std::vector<double> &x) {
+    const std::size_t n = first.size();
+    for (std::size_t i = 0; i < n; ++i) {
+        const double *row = values.data() + start[i] - first[i];
+        double sum = x[i];
+        for (int k = first[i]; k < static_cast<int>(i); ++k) {
+            sum -= row[k] * x[k];
+        }
+        x[i] = sum / row[i];
+    }
+    for (std::size_t i = n; i-- > 0;) {
+        const double *row = values.data() + start[i] - first[i];
+        x[i] /= row[i];
+        for (int k = first[i]; k < static_cast<int>(i); ++k) {
+            x[k] -= row[k] * x[i];
+        }
+    }
+}
+}
+
+SlotHandle SketchGeometry::add(const SketchPrimitive &primitive) {
+    const SlotHandle handle = handles.insert();
+    kind.push_back(primitive.kind);
+    id.push_back(primitive.id);
+    startX.push_back(primitive.start.X());
+    startY.push_back(primitive.start.Y());
+    endX.push_back(primitive.end.X());
+    endY.push_back(primitive.end.Y());
+    radius.push_back(primitive.radius);
+    return handle;
+}
+
+bool SketchGeometry::remove(SlotHandle handle) {
+    const std::size_t row = handles.erase(handle);
+    if (row == SlotMap::npos) return false;
+    const auto swapPop = [row](auto &column) {
+        column[row] = std::move(column.back());
+        column.pop_back();
+    };
+    swapPop(kind);
+    swapPop(id);
+    swapPop(startX);
+    swapPop(startY);
+    swapPop(endX);
+    swapPop(endY);
+    swapPop(radius);
+    return true;
+}
+
+SketchPrimitive SketchGeometry::primitiveAt(std::size_t row) const {
+    SketchPrimitive primitive;
+    primitive.kind = kind[row];
+    primitive.id = id[row];
+    primitive.start.SetCoord(startX[row], startY[row]);
+    primitive.end.SetCoord(endX[row], endY[row]);
+    primitive.radius = radius[row];
+    return primitive;
+}
+
+int SketchSolver::rowCount(EquationKind kind) {
+    return kind == EquationKind::CoincidentPoints ? 2 : 1;
+}
+
+void SketchSolver::analyze(const SketchGeometry &geometry, const std::vector<BoundConstraint> &constraints,
+                           const std::vector<BoundDimension> &dimensions) {
+    const int count = static_cast<int>(geometry.size());
+    m_isCircle.assign(geometry.size(), 0);
+    for (int i = 0; i < count; ++i) {
+        m_isCircle[i] = geometry.kind[i] == SketchPrimitive::Kind::Circle;
+    }
+    const auto rowOf = [&geometry](SlotHandle handle) {
+        const std::size_t row = geometry.handles.row(handle);
+        return row == SlotMap::npos ? -1 : static_cast<int>(row);
+    };
+
+    m_equations.clear();
+    const auto add = [this](EquationKind kind, int a, int b, int source, bool fromDimension) {
+        m_equations.push_back({kind, a, b, source, fromDimension});
+    };
+    for (int c = 0; c < static_cast<int>(constraints.size()); ++c) {
+        const BoundConstraint &constraint = constraints[c];
+        const int a = rowOf(constraint.a);
+        const int b = constraint.b.isValid() ? rowOf(constraint.b) : -1;
+        if (a < 0 || (constraint.b.isValid() && b < 0)) continue;
+        const bool binary = b >= 0 && b != a;
+        const bool circleA = m_isCircle[a];
+        const bool circleB = binary && m_isCircle[b];
+
+        switch (constraint.type) {
+        case SketchConstraint::Type::Equal:
+            if (!binary) break;
+            if (!circleA && !circleB) add(EquationKind::EqualLength, a, b, c, false);
+            else if (circleA && circleB) add(EquationKind::EqualRadius, a, b, c, false);
+            else if (circleA) add(EquationKind::EqualLengthRadius, b, a, c, false);
+            else add(EquationKind::EqualLengthRadius, a, b, c, false);
+            break;
+        case SketchConstraint::Type::Parallel:
+            if (binary && !circleA && !circleB) add(EquationKind::Parallel, a, b, c, false);
+            break;
+        case SketchConstraint::Type::Perpendicular:
+            if (binary && !circleA && !circleB) add(EquationKind::Perpendicular, a, b, c, false);
+            break;
+        case SketchConstraint::Type::Tangent:
+            if (!binary) break;
+            if (circleA && circleB) add(EquationKind::TangentCircles, a, b, c, false);
+            else if (circleA) add(EquationKind::TangentLineCircle, b, a, c, false);
+            else if (circleB) add(EquationKind::TangentLineCircle, a, b, c, false);
+            break;
+        case SketchConstraint::Type::Coincident:
+            if (!binary) break;
+            if (circleA != circleB) add(EquationKind::PointOnCircle, a, b, c, false);
+            else add(EquationKind::CoincidentPoints, a, b, c, false);
+            break;
+        case SketchConstraint::Type::Radius:
+            if (circleA) add(EquationKind::Radius, a, -1, c, false);
+            break;
+        case SketchConstraint::Type::Distance:
+            if (binary) add(EquationKind::PointDistance, a, b, c, false);
+            else if (!circleA) add(EquationKind::LineLength, a, -1, c, false);
+            break;
+        }
+    }
+    for (int d = 0; d < static_cast<int>(dimensions.size()); ++d) {
+        const int target = rowOf(dimensions[d].target);
+        if (target < 0) continue;
+        add(m_isCircle[target] ? EquationKind::Radius : EquationKind::LineLength, target, -1, d, true);
+    }
+
+    std::vector<int> parent(geometry.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    std::vector<char> involved(geometry.size(), 0);
+    for (const auto &equation : m_equations) {
+        involved[equation.a] = 1;
+        if (equation.b >= 0) {
+            involved[equation.b] = 1;
+            parent[findRoot(parent, equation.a)] = findRoot(parent, equation.b);
+        }
+    }
+
+    m_clusters.clear();
+    m_primitiveCluster.assign(geometry.size(), -1);
+    m_localOffset.assign(geometry.size(), 0);
+    std::vector<int> clusterOfRoot(geometry.size(), -1);
+    for (int i = 0; i < count; ++i) {
+        if (!involved[i]) continue;
+        const int root = findRoot(parent, i);
+        if (clusterOfRoot[root] < 0) {
+            clusterOfRoot[root] = static_cast<int>(m_clusters.size());
+            m_clusters.emplace_back();
+        }
+        Cluster &cluster = m_clusters[clusterOfRoot[root]];
+        m_primitiveCluster[i] = clusterOfRoot[root];
+        m_localOffset[i] = static_cast<int>(cluster.parameterCount);
+        cluster.primitives.push_back(i);
+        cluster.parameterCount += parameterCount(i);
+    }
+    for (int e = 0; e < static_cast<int>(m_equations.size()); ++e) {
+        m_clusters[m_primitiveCluster[m_equations[e].a]].equations.push_back(e);
+    }
+    for (auto &cluster : m_clusters) {
+        orderCluster(cluster);
+    }
+}
+
+void SketchSolver::orderCluster(Cluster &cluster) const {
+    const int n = static_cast<int>(cluster.parameterCount);
+    std::vector<std::vector<int>> adjacency(n);
+    std::vector<int> columns;
+    for (int e : cluster.equations) {
+        const Equation &equation = m_equations[e];
+        columns.clear();
+        for (int primitive : {equation.a, equation.b}) {
+            if (primitive < 0) continue;
+            for (int k = 0; k < parameterCount(primitive); ++k) {
+                columns.push_back(m_localOffset[primitive] + k);
+            }
+        }
+        for (int c1 : columns) {
+            for (int c2 : columns) {
+                if (c1 != c2) adjacency[c1].push_back(c2);
+            }
+        }
+    }
+    for (auto &neighbours : adjacency) {
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    }
+
+    // Reverse Cuthill-McKee over ordinary parameters; parameters shared by many equations
+    // (e.g. the reference of a long chain of Equal constraints) go last so they only add
+    // a few dense rows at the bottom instead of widening every row's envelope.
+    const std::size_t hubDegree = std::max<std::size_t>(32, static_cast<std::size_t>(n) / 8);
+    const auto degree = [&adjacency](int v) { return adjacency[v].size(); };
+    std::vector<char> placed(n, 0);
+    std::vector<int> order;
+    std::vector<int> hubs;
+    order.reserve(n);
+    for (int v = 0; v < n; ++v) {
+        if (degree(v) > hubDegree) {
+            hubs.push_back(v);
+            placed[v] = 1;
+        }
+    }
+    std::vector<int> seeds(n);
+    std::iota(seeds.begin(), seeds.end(), 0);
+    std::stable_sort(seeds.begin(), seeds.end(), [&degree](int l, int r) { return degree(l) < degree(r); });
+    std::vector<int> next;
+    for (int seed : seeds) {
+        if (placed[seed]) continue;
+        placed[seed] = 1;
+        std::size_t head = order.size();
+        order.push_back(seed);
+        while (head < order.size()) {
+            const int v = order[head++];
+            next.clear();
+            for (int w : adjacency[v]) {
+                if (!placed[w]) {
+                    placed[w] = 1;
+                    next.push_back(w);
+                }
+            }
+            std::stable_sort(next.begin(), next.end(), [&degree](int l, int r) { return degree(l) < degree(r); });
+            order.insert(order.end(), next.begin(), next.end());
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    order.insert(order.end(), hubs.begin(), hubs.end());
+
+    cluster.position.assign(n, 0);
+    for (int k = 0; k < n; ++k) {
+        cluster.position[order[k]] = k;
+    }
+    cluster.envelopeFirst.assign(n, 0);
+    cluster.envelopeStart.assign(n + 1, 0);
+    for (int k = 0; k < n; ++k) {
+        int first = k;
+        for (int w : adjacency[order[k]]) {
+            first = std::min(first, cluster.position[w]);
+        }
+        cluster.envelopeFirst[k] = first;
+        cluster.envelopeStart[k + 1] = cluster.envelopeStart[k] + static_cast<std::size_t>(k - first + 1);
+    }
+}
+
+int SketchSolver::clusterOf(std::size_t row) const {
+    if (row >= m_primitiveCluster.size()) return -1;
+    return m_primitiveCluster[row];
+}
+
+int SketchSolver::evaluate(const Equation &equation, const std::vector<double> &x, double value, double *out) const {
+    const double *a = x.data() + m_localOffset[equation.a];
+    const double *b = equation.b >= 0 ? x.data() + m_localOffset[equation.b] : nullptr;
+    const auto direction = [](const double *line) { return Vec2{line[2] - line[0], line[3] - line[1]}; };
+    // Lines are anchored at their start (or end), circles at their centre.
+    const auto startOf = [](const double *p) { return Vec2{p[0], p[1]}; };
+    const auto endOf = [this](const double *p, int primitive) {
+        return m_isCircle[primitive] ? Vec2{p[0], p[1]} : Vec2{p[2], p[3]};
+    };
+
+    switch (equation.kind) {
+    case EquationKind::LineLength:
+        out[0] = length(direction(a)) - value;
+        return 1;
+    case EquationKind::Radius:
+        out[0] = a[2] - value;
+        return 1;
+    case EquationKind::EqualLength:
+        out[0] = length(direction(a)) - length(direction(b));
+        return 1;
+    case EquationKind::EqualRadius:
+        out[0] = a[2] - b[2];
+        return 1;
+    case EquationKind::EqualLengthRadius:
+        out[0] = length(direction(a)) - b[2];
+        return 1;
+    case EquationKind::Parallel:
+    case EquationKind::Perpendicular: {
+        const Vec2 da = direction(a);
+        const Vec2 db = direction(b);
+        const double scale = length(da) * length(db);
+        out[0] = equation.kind == EquationKind::Parallel ? (da.x * db.y - da.y * db.x) / scale
+                                                         : (da.x * db.x + da.y * db.y) / scale;
+        return 1;
+    }
+    case EquationKind::TangentLineCircle: {
+        const Vec2 d = direction(a);
+        const double distance = (d.x * (b[1] - a[1]) - d.y * (b[0] - a[0])) / length(d);
+        out[0] = std::abs(distance) - b[2];
+        return 1;
+    }
+    case EquationKind::TangentCircles:
+        out[0] = std::hypot(a[0] - b[0], a[1] - b[1]) - (a[2] + b[2]);
+        return 1;
+    case EquationKind::CoincidentPoints: {
+        const Vec2 p = endOf(a, equation.a);
+        const Vec2 q = startOf(b);
+        out[0] = p.x - q.x;
+        out[1] = p.y - q.y;
+        return 2;
+    }
+    case EquationKind::PointOnCircle: {
+        const bool lineFirst = !m_isCircle[equation.a];
+        const Vec2 point = lineFirst ? endOf(a, equation.a) : startOf(b);
+        const double *circle = lineFirst ? b : a;
+        out[0] = std::hypot(point.x - circle[0], point.y - circle[1]) - circle[2];
+        return 1;
+    }
+    case EquationKind::PointDistance: {
+        const Vec2 p = startOf(a);
+        const Vec2 q = startOf(b);
+        out[0] = std::hypot(p.x - q.x, p.y - q.y) - value;
+        return 1;
+    }
+    }
+    return 0;
+}
+
+void SketchSolver::solveCluster(const Cluster &cluster, SketchGeometry &geometry,
+                                const std::vector<BoundConstraint> &constraints,
+                                const std::vector<BoundDimension> &dimensions, Report &report) const {
+    const std::size_t n = cluster.parameterCount;
+    std::vector<double> x(n);
+    for (int p : cluster.primitives) {
+        double *params = x.data() + m_localOffset[p];
+        params[0] = geometry.startX[p];
+        params[1] = geometry.startY[p];
+        if (m_isCircle[p]) {
+            params[2] = geometry.radius[p];
+        } else {
+            params[2] = geometry.endX[p];
+            params[3] = geometry.endY[p];
+        }
+    }
+
+    std::vector<double> values(cluster.equations.size());
+    std::size_t rows = 0;
+    for (std::size_t i = 0; i < cluster.equations.size(); ++i) {
+        const Equation &equation = m_equations[cluster.equations[i]];
+        values[i] = equation.fromDimension ? dimensions[equation.source].value : constraints[equation.source].value;
+        rows += rowCount(equation.kind);
+    }
+
+    const auto residualsAt = [&](const std::vector<double> &point, std::vector<double> &out) {
+        out.resize(rows);
+        std::size_t row = 0;
+        for (std::size_t i = 0; i < cluster.equations.size(); ++i) {
+            row += evaluate(m_equations[cluster.equations[i]], point, values[i], out.data() + row);
+        }
+    };
+
+    std::vector<double> residual;
+    residualsAt(x, residual);
+    double cost = dot(residual, residual);
+    double lambda = 1.0e-3;
+    int iteration = 0;
+    bool converged = maxAbs(residual) < kTolerance;
+
+    const std::size_t envelopeSize = cluster.envelopeStart.back();
+    std::vector<double> normal(envelopeSize);
+    std::vector<double> factor;
+    std::vector<double> gradient(n);
+    std::vector<double> step(n);
+    std::vector<double> permuted(n);
+    std::vector<double> trial(n);
+    std::vector<double> trialResidual;
+    std::vector<int> columns;
+    std::vector<double> derivatives;
+    double perturbed[2];
+    const auto entry = [&cluster](int rowIndex, int column) {
+        return cluster.envelopeStart[rowIndex] + column - cluster.envelopeFirst[rowIndex];
+    };
+
+    while (!converged && iteration < kMaxIterations) {
+        ++iteration;
+        // Forward differences per equation; each row only touches its one or two primitives,
+        // and its outer product goes straight into the envelope of J^T J.
+        std::fill(normal.begin(), normal.end(), 0.0);
+        std::fill(gradient.begin(), gradient.end(), 0.0);
+        std::size_t row = 0;
+        for (std::size_t i = 0; i < cluster.equations.size(); ++i) {
+            const Equation &equation = m_equations[cluster.equations[i]];
+            const int equationRows = rowCount(equation.kind);
+            columns.clear();
+            for (int primitive : {equation.a, equation.b}) {
+                if (primitive < 0) continue;
+                const int offset = m_localOffset[primitive];
+                const int count = parameterCount(primitive);
+                for (int k = 0; k < count; ++k) {
+                    if (std::find(columns.begin(), columns.end(), offset + k) == columns.end()) {
+                        columns.push_back(offset + k);
+                    }
+                }
+            }
+            derivatives.assign(columns.size() * equationRows, 0.0);
+            for (std::size_t c = 0; c < columns.size(); ++c) {
+                double &parameter = x[columns[c]];
+                const double saved = parameter;
+                const double h = 1.0e-7 * std::max(1.0, std::abs(saved));
+                parameter = saved + h;
+                evaluate(equation, x, values[i], perturbed);
+                parameter = saved;
+                for (int r = 0; r < equationRows; ++r) {
+                    derivatives[r * columns.size() + c] = (perturbed[r] - residual[row + r]) / h;
+                }
+            }
+            for (int r = 0; r < equationRows; ++r) {
+                const double *d = derivatives.data() + r * columns.size();
+                for (std::size_t c1 = 0; c1 < columns.size(); ++c1) {
+                    gradient[columns[c1]] += d[c1] * residual[row + r];
+                    const int p1 = cluster.position[columns[c1]];
+                    for (std::size_t c2 = 0; c2 < columns.size(); ++c2) {
+                        const int p2 = cluster.position[columns[c2]];
+                        if (p2 <= p1) normal[entry(p1, p2)] += d[c1] * d[c2];
+                    }
+                }
+            }
+            row += equationRows;
+        }
+
+        bool improved = false;
+        while (!improved && lambda < 1.0e12) {
+            factor = normal;
+            for (std::size_t k = 0; k < n; ++k) {
+                const std::size_t diagonal = entry(static_cast<int>(k), static_cast<int>(k));
+                factor[diagonal] += lambda * (normal[diagonal] + 1.0e-9);
+            }
+            if (!factorEnvelope(factor, cluster.envelopeFirst, cluster.envelopeStart)) {
+                lambda *= 4.0;
+                continue;
+            }
+            for (std::size_t k = 0; k < n; ++k) {
+                permuted[cluster.position[k]] = -gradient[k];
+            }
+            solveEnvelope(factor, cluster.envelopeFirst, cluster.envelopeStart, permuted);
+            for (std::size_t k = 0; k < n; ++k) {
+                step[k] = permuted[cluster.position[k]];
+                trial[k] = x[k] + step[k];
+            }
+            residualsAt(trial, trialResidual);
+            const double trialCost = dot(trialResidual, trialResidual);
+            if (trialCost < cost) {
+                x.swap(trial);
+                residual.swap(trialResidual);
+                cost = trialCost;
+                lambda = std::max(lambda / 3.0, 1.0e-12);
+                improved = true;
+            } else {
+                lambda *= 4.0;
+            }
+        }
+        converged = maxAbs(residual) < kTolerance;
+        if (!improved) break;
+    }
+    for (int p : cluster.primitives) {
+        const double *params = x.data() + m_localOffset[p];
+        geometry.startX[p] = params[0];
+        geometry.startY[p] = params[1];
+        if (m_isCircle[p]) {
+            geometry.radius[p] = params[2];
+        } else {
+            geometry.endX[p] = params[2];
+            geometry.endY[p] = params[3];
+        }
+    }
+
+    report.converged = report.converged && converged;
+    report.iterations += iteration;
+    report.residual = std::max(report.residual, maxAbs(residual));
+    report.clustersSolved += 1;
+    report.parametersSolved += n;
+}
+
+SketchSolver::Report SketchSolver::solveAll(SketchGeometry &geometry, const std::vector<BoundConstraint> &constraints,
+                                            const std::vector<BoundDimension> &dimensions) const {
+    Report report;
+    for (const auto &cluster : m_clusters) {
+        solveCluster(cluster, geometry, constraints, dimensions, report);
+    }
+    return report;
+}
+
+SketchSolver::Report SketchSolver::solveFor(std::size_t row, SketchGeometry &geometry,
+                                            const std::vector<BoundConstraint> &constraints,
+                                            const std::vector<BoundDimension> &dimensions) const {
+    Report report;
+    const int cluster = clusterOf(row);
+    if (cluster >= 0) {
+        solveCluster(m_clusters[cluster], geometry, constraints, dimensions, report);
+    }
+    return report;
+}
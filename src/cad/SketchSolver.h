@@ -0,0 +1,145 @@
+#pragma once
+
+#include "SlotMap.h"
+
+#include <QString>
+#include <cstddef>
+#include <gp_Pnt2d.hxx>
+#include <vector>
+
+struct SketchConstraint {
+    enum class Type { Equal, Parallel, Perpendicular, Tangent, Coincident, Radius, Distance };
+    Type type;
+    QString a;
+    QString b;
+    double value{0.0};
+};
+
+// Drives the length of a line or the radius of a circle.
+struct SketchDimension {
+    QString id;
+    QString target;
+    double value{0.0};
+};
+
+struct SketchPrimitive {
+    enum class Kind { Line, Circle };
+    Kind kind;
+    QString id;
+    gp_Pnt2d start;
+    gp_Pnt2d end;
+    double radius{0.0};
+};
+
+// Primitive storage of a sketch: one dense row per primitive in structure-of-arrays columns,
+// addressed from outside through SlotMap handles. Lines use start/end, circles start/radius.
+struct SketchGeometry {
+    SlotMap handles;
+    std::vector<SketchPrimitive::Kind> kind;
+    std::vector<QString> id;
+    std::vector<double> startX;
+    std::vector<double> startY;
+    std::vector<double> endX;
+    std::vector<double> endY;
+    std::vector<double> radius;
+
+    std::size_t size() const { return kind.size(); }
+    SlotHandle add(const SketchPrimitive &primitive);
+    // Swap-removes the row; handles to other primitives stay valid.
+    bool remove(SlotHandle handle);
+    SketchPrimitive primitiveAt(std::size_t row) const;
+};
+
+// Constraint and dimension with their primitive ids resolved to handles.
+struct BoundConstraint {
+    SketchConstraint::Type type;
+    SlotHandle a;
+    SlotHandle b;
+    double value{0.0};
+};
+
+struct BoundDimension {
+    SlotHandle target;
+    double value{0.0};
+};
+
+// Levenberg-Marquardt solver over the sketch parameters (x1 y1 x2 y2 per line, cx cy r per
+// circle). Primitives linked by constraints form independent clusters; each cluster is solved
+// on its own from the current geometry, so an edit re-solves only the cluster it touches.
+//
+// Constraint semantics: Coincident joins the end of `a` to the start of `b` (circle centres,
+// or a line end on a circle); Distance spans the start/centre of `a` and `b`, or is the
+// length of `a` when `b` is empty; Tangent is line/circle or external circle/circle.
+class SketchSolver {
+public:
+    struct Report {
+        bool converged{true};
+        int iterations{0};
+        double residual{0.0};
+        std::size_t clustersSolved{0};
+        std::size_t parametersSolved{0};
+    };
+
+    // Rebuilds equations and clusters; needed whenever primitives or constraints are added
+    // or removed. Constraints on stale handles are ignored.
+    void analyze(const SketchGeometry &geometry, const std::vector<BoundConstraint> &constraints,
+                 const std::vector<BoundDimension> &dimensions);
+
+    Report solveAll(SketchGeometry &geometry, const std::vector<BoundConstraint> &constraints,
+                    const std::vector<BoundDimension> &dimensions) const;
+    // Solves only the cluster containing the primitive in `row`; other rows are not touched.
+    Report solveFor(std::size_t row, SketchGeometry &geometry, const std::vector<BoundConstraint> &constraints,
+                    const std::vector<BoundDimension> &dimensions) const;
+
+    std::size_t clusterCount() const { return m_clusters.size(); }
+    // -1 for unconstrained primitives.
+    int clusterOf(std::size_t row) const;
+
+private:
+    enum class EquationKind {
+        LineLength,
+        Radius,
+        EqualLength,
+        EqualRadius,
+        EqualLengthRadius,
+        Parallel,
+        Perpendicular,
+        TangentLineCircle,
+        TangentCircles,
+        CoincidentPoints,
+        PointOnCircle,
+        PointDistance
+    };
+
+    struct Equation {
+        EquationKind kind;
+        int a{-1};  // geometry rows
+        int b{-1};
+        int source{-1};  // index into constraints or dimensions, for the driving value
+        bool fromDimension{false};
+    };
+
+    // Normal equations of a cluster are factored in envelope (skyline) form. The fill-reducing
+    // ordering only depends on which parameters share an equation, so it is computed once here.
+    struct Cluster {
+        std::vector<int> primitives;
+        std::vector<int> equations;
+        std::size_t parameterCount{0};
+        std::vector<int> position;             // local parameter -> row of the factor
+        std::vector<int> envelopeFirst;        // first stored column of each row
+        std::vector<std::size_t> envelopeStart;
+    };
+
+    int parameterCount(int row) const { return m_isCircle[row] ? 3 : 4; }
+    static int rowCount(EquationKind kind);
+    void orderCluster(Cluster &cluster) const;
+    int evaluate(const Equation &equation, const std::vector<double> &x, double value, double *out) const;
+    void solveCluster(const Cluster &cluster, SketchGeometry &geometry, const std::vector<BoundConstraint> &constraints,
+                      const std::vector<BoundDimension> &dimensions, Report &report) const;
+
+    std::vector<int> m_primitiveCluster;
+    std::vector<char> m_isCircle;
+    std::vector<int> m_localOffset;  // parameter offset of each primitive inside its cluster
+    std::vector<Equation> m_equations;
+    std::vector<Cluster> m_clusters;
+};
@@ -0,0 +1,45 @@
+#include "SlotMap.h"
+
+SlotHandle SlotMap::insert() {
+    std::uint32_t slot;
+    if (!m_freeSlots.empty()) {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else {
+        slot = static_cast<std::uint32_t>(m_slots.size());
+        m_slots.emplace_back();
+    }
+    Slot &entry = m_slots[slot];
+    entry.row = static_cast<std::uint32_t>(m_rowToSlot.size());
+    entry.occupied = true;
+    m_rowToSlot.push_back(slot);
+    return {slot, entry.generation};
+}
+
+std::size_t SlotMap::erase(SlotHandle handle) {
+    const std::size_t freed = row(handle);
+    if (freed == npos) return npos;
+
+    Slot &entry = m_slots[handle.slot];
+    entry.occupied = false;
+    ++entry.generation;
+    m_freeSlots.push_back(handle.slot);
+
+    const std::uint32_t moved = m_rowToSlot.back();
+    m_rowToSlot[freed] = moved;
+    m_slots[moved].row = static_cast<std::uint32_t>(freed);
+    m_rowToSlot.pop_back();
+    return freed;
+}
+
+std::size_t SlotMap::row(SlotHandle handle) const {
+    if (handle.slot >= m_slots.size()) return npos;
+    const Slot &entry = m_slots[handle.slot];
+    if (!entry.occupied || entry.generation != handle.generation) return npos;
+    return entry.row;
+}
+
+void SlotMap::reserve(std::size_t count) {
+    m_slots.reserve(count);
+    m_rowToSlot.reserve(count);
+}
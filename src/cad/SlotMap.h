@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Compact handle to an element of a SlotMap. The generation makes handles to removed
+// elements detectably stale even after their slot is reused.
+struct SlotHandle {
+    static constexpr std::uint32_t kInvalid = std::numeric_limits<std::uint32_t>::max();
+
+    std::uint32_t slot{kInvalid};
+    std::uint32_t generation{0};
+
+    bool isValid() const { return slot != kInvalid; }
+    bool operator==(const SlotHandle &other) const { return slot == other.slot && generation == other.generation; }
+    bool operator!=(const SlotHandle &other) const { return !(*this == other); }
+};
+
+// Maps stable handles to rows of caller-owned dense columns. Removal swaps the last row into
+// the hole, so the columns stay contiguous; the caller mirrors that move on its own arrays.
+class SlotMap {
+public:
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    // The new element's row is size() - 1.
+    SlotHandle insert();
+    // Returns the freed row; the caller moves its last row there and pops. npos for stale handles.
+    std::size_t erase(SlotHandle handle);
+
+    bool contains(SlotHandle handle) const { return row(handle) != npos; }
+    std::size_t row(SlotHandle handle) const;
+    SlotHandle handleAt(std::size_t row) const { return {m_rowToSlot[row], m_slots[m_rowToSlot[row]].generation}; }
+    std::size_t size() const { return m_rowToSlot.size(); }
+    void reserve(std::size_t count);
+
+private:
+    struct Slot {
+        std::uint32_t row{0};
+        std::uint32_t generation{0};
+        bool occupied{false};
+    };
+
+    std::vector<Slot> m_slots;
+    std::vector<std::uint32_t> m_freeSlots;
+    std::vector<std::uint32_t> m_rowToSlot;
+};
@@ -2,22 +2,120 @@
 
 #include <STEPCAFControl_Reader.hxx>
 #include <STEPCAFControl_Writer.hxx>
+#include <STEPCAFControl_Controller.hxx>
+#include <IGESCAFControl_Reader.hxx>
+#include <IGESControl_Controller.hxx>
 #include <IGESControl_Reader.hxx>
 #include <IGESControl_Writer.hxx>
 #include <IFSelect_ReturnStatus.hxx>
-#include <XCAFApp_Application.hxx>
 #include <XCAFDoc_DocumentTool.hxx>
 #include <TDocStd_Document.hxx>
 #include <TDF_LabelSequence.hxx>
 #include <TopExp_Explorer.hxx>
 #include <TopoDS_Compound.hxx>
 #include <BRep_Builder.hxx>
+#include <Interface_EntityIterator.hxx>
+#include <Interface_Graph.hxx>
+#include <Message_ProgressIndicator.hxx>
+#include <Message_ProgressScope.hxx>
+#include <QDir>
+#include <QFileInfo>
+#include <QPromise>
+#include <QRegularExpression>
+#include <QSet>
+#include <QtConcurrent>
+#include <STEPControl_Reader.hxx>
+#include <StepBasic_Product.hxx>
+#include <StepBasic_ProductDefinition.hxx>
+#include <StepBasic_ProductDefinitionFormation.hxx>
+#include <StepRepr_NextAssemblyUsageOccurrence.hxx>
+#include <TCollection_HAsciiString.hxx>
+#include <XSControl_WorkSession.hxx>
+#include <TDataStd_Name.hxx>
+#include <TDF_Tool.hxx>
+#include <TopLoc_Location.hxx>
+#include <XCAFDoc_MaterialTool.hxx>
+#include <XCAFDoc_ShapeTool.hxx>
+#include "XcafDocumentPool.h"
+#include "PartRegistry.h"
+#include "../assembly/AssemblyDocument.h"
 #include "../utils/Logging.h"
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 StepIgesIO::StepIgesIO() = default;
 
 namespace {
-TopoDS_Shape collectFreeShapes(const Handle(XCAFDoc_ShapeTool) &tool) {
+// Translator controllers register process-wide state on first use; do it once up front so
+// concurrent readers only ever read it.
+void initControllers() {
+    static std::once_flag once;
+    std::call_once(once, []() {
+        STEPCAFControl_Controller::Init();
+        IGESControl_Controller::Init();
+    });
+}
+
+constexpr int kProgressSteps = 1000;
+
+// Reports a streamed import through its QPromise; QFuture::cancel() becomes a user break.
+class StreamProgress : public Message_ProgressIndicator {
+public:
+    explicit StreamProgress(QPromise<StepIgesIO::ImportedRoot> &promise) : m_promise(promise) {}
+
+    Standard_Boolean UserBreak() override { return m_promise.isCanceled(); }
+
+    void Show(const Message_ProgressScope &, const Standard_Boolean) override {
+        m_promise.setProgressValue(static_cast<int>(GetPosition() * kProgressSteps));
+    }
+
+private:
+    QPromise<StepIgesIO::ImportedRoot> &m_promise;
+};
+
+QString productName(const Handle(StepBasic_ProductDefinition) &definition) {
+    if (definition.IsNull() || definition->Formation().IsNull() || definition->Formation()->OfProduct().IsNull()) {
+        return QString();
+    }
+    const Handle(TCollection_HAsciiString) name = definition->Formation()->OfProduct()->Name();
+    return name.IsNull() ? QString() : QString::fromUtf8(name->ToCString());
+}
+
+struct TransferUnit {
+    Handle(Standard_Transient) entity;
+    QString name;
+};
+
+// Top-level assemblies are split into their direct components: transferring a
+// NextAssemblyUsageOccurrence yields the component placed in its parent, so each arrives
+// positioned while the big root would otherwise only appear once everything is converted.
+std::vector<TransferUnit> stepTransferUnits(STEPControl_Reader &reader) {
+    std::vector<TransferUnit> units;
+    const Interface_Graph &graph = reader.WS()->Graph();
+    for (Standard_Integer i = 1; i <= reader.NbRootsForTransfer(); ++i) {
+        const Handle(Standard_Transient) root = reader.RootForTransfer(i);
+        const Handle(StepBasic_ProductDefinition) product = Handle(StepBasic_ProductDefinition)::DownCast(root);
+        const std::size_t before = units.size();
+        if (!product.IsNull()) {
+            for (Interface_EntityIterator it = graph.Sharings(product); it.More(); it.Next()) {
+                const Handle(StepRepr_NextAssemblyUsageOccurrence) usage = Handle(StepRepr_NextAssemblyUsageOccurrence)::DownCast(it.Value());
+                if (usage.IsNull() || usage->RelatingProductDefinition() != product) continue;
+                units.push_back({usage, productName(usage->RelatedProductDefinition())});
+            }
+        }
+        if (units.size() == before) {
+            units.push_back({root, productName(product)});
+        }
+    }
+    return units;
+}
+}
+
+TopoDS_Shape StepIgesIO::freeShapes(const Handle(TDocStd_Document) &doc) {
+    Handle(XCAFDoc_ShapeTool) tool = XCAFDoc_DocumentTool::ShapeTool(doc->Main());
     TDF_LabelSequence labels;
     tool->GetFreeShapes(labels);
     BRep_Builder builder;
@@ -29,15 +127,10 @@ TopoDS_Shape collectFreeShapes(const Handle(XCAFDoc_ShapeTool) &tool) {
     }
     return compound;
 }
-}
 
-TopoDS_Shape StepIgesIO::importFile(const QString &path) const {
+bool StepIgesIO::readInto(const QString &path, const Handle(TDocStd_Document) &doc, const Message_ProgressRange &range) const {
+    initControllers();
     const QString lower = path.toLower();
-    Handle(XCAFApp_Application) app = XCAFApp_Application::GetApplication();
-    Handle(TDocStd_Document) doc;
-    app->NewDocument("MDTV-CAF", doc);
-    Handle(XCAFDoc_ShapeTool) shapeTool = XCAFDoc_DocumentTool::ShapeTool(doc->Main());
-
     if (lower.endsWith(".stp") || lower.endsWith(".step")) {
         STEPCAFControl_Reader reader;
         reader.SetColorMode(true);
@@ -45,13 +138,31 @@ TopoDS_Shape StepIgesIO::importFile(const QString &path) const {
         reader.SetMaterialMode(true);
         if (reader.ReadFile(path.toStdString().c_str()) != IFSelect_RetDone) {
             Logging::warn(QStringLiteral("Failed to read STEP file: %1").arg(path));
-            return TopoDS_Shape();
+            return false;
         }
-        reader.Transfer(doc);
-        return collectFreeShapes(shapeTool);
+        return reader.Transfer(doc, range);
     }
 
     if (lower.endsWith(".igs") || lower.endsWith(".iges")) {
+        IGESCAFControl_Reader reader;
+        reader.SetColorMode(true);
+        reader.SetNameMode(true);
+        reader.SetLayerMode(true);
+        if (reader.ReadFile(path.toStdString().c_str()) != IFSelect_RetDone) {
+            Logging::warn(QStringLiteral("Failed to read IGES file: %1").arg(path));
+            return false;
+        }
+        return reader.Transfer(doc, range);
+    }
+
+    Logging::warn(QStringLiteral("Unsupported CAD format: %1").arg(path));
+    return false;
+}
+
+TopoDS_Shape StepIgesIO::importFile(const QString &path) const {
+    const QString lower = path.toLower();
+    if (lower.endsWith(".igs") || lower.endsWith(".iges")) {
+        initControllers();
         IGESControl_Reader reader;
         if (reader.ReadFile(path.toStdString().c_str()) != IFSelect_RetDone) {
             Logging::warn(QStringLiteral("Failed to read IGES file: %1").arg(path));
@@ -61,28 +172,231 @@ TopoDS_Shape StepIgesIO::importFile(const QString &path) const {
         return reader.OneShape();
     }
 
-    Logging::warn(QStringLiteral("Unsupported CAD format: %1").arg(path));
-    return TopoDS_Shape();
+    XcafDocumentPool::Lease lease = XcafDocumentPool::instance().acquire();
+    if (!readInto(path, lease.document())) {
+        return TopoDS_Shape();
+    }
+    return freeShapes(lease.document());
+}
+
+namespace {
+QString labelName(const TDF_Label &label) {
+    Handle(TDataStd_Name) name;
+    if (label.IsNull() || !label.FindAttribute(TDataStd_Name::GetID(), name)) return QString();
+    return QString::fromUtf16(reinterpret_cast<const char16_t *>(name->Get().ToExtString()));
+}
+
+// Walks the XCAF label tree into AssemblyDocument nodes. Part definitions are resolved once
+// and every occurrence of a part points at the same shape.
+class AssemblyBuilder {
+public:
+    AssemblyBuilder(const Handle(XCAFDoc_ShapeTool) &tool, AssemblyDocument &assembly) : m_tool(tool), m_assembly(assembly) {}
+
+    bool add(const TDF_Label &definition, const TDF_Label &occurrence, const gp_Trsf &local, const QString &parentId, const QString &id) {
+        AssemblyNode node;
+        node.id = id;
+        node.parentId = parentId;
+        node.localTransform = local;
+        node.name = labelName(occurrence);
+        if (node.name.isEmpty()) {
+            node.name = labelName(definition);
+        }
+        const bool assembly = m_tool->IsAssembly(definition);
+        if (!assembly) {
+            node.shape = prototype(definition);
+        }
+        if (!m_assembly.addNode(node)) return false;
+        if (!assembly) return true;
+
+        TDF_LabelSequence components;
+        m_tool->GetComponents(definition, components, Standard_False);
+        for (Standard_Integer i = 1; i <= components.Length(); ++i) {
+            const TDF_Label component = components.Value(i);
+            TDF_Label referred;
+            if (!m_tool->GetReferredShape(component, referred)) continue;
+            const gp_Trsf location = m_tool->GetLocation(component).Transformation();
+            add(referred, component, location, id, QStringLiteral("%1/%2").arg(id).arg(component.Tag()));
+        }
+        return true;
+    }
+
+private:
+    TopoDS_Shape prototype(const TDF_Label &definition) {
+        TCollection_AsciiString entry;
+        TDF_Tool::Entry(definition, entry);
+        const QString key = QString::fromLatin1(entry.ToCString());
+        auto it = m_prototypes.find(key);
+        if (it == m_prototypes.end()) {
+            it = m_prototypes.emplace(key, m_tool->GetShape(definition)).first;
+        }
+        return it->second;
+    }
+
+    Handle(XCAFDoc_ShapeTool) m_tool;
+    AssemblyDocument &m_assembly;
+    std::unordered_map<QString, TopoDS_Shape> m_prototypes;
+};
+}
+
+QStringList StepIgesIO::importAssembly(const QString &path, AssemblyDocument &assembly, const QString &parentId) const {
+    QStringList ids;
+    if (!assembly.getNode(parentId)) {
+        Logging::warn(QStringLiteral("Cannot import %1: assembly node %2 does not exist").arg(path, parentId));
+        return ids;
+    }
+    XcafDocumentPool::Lease lease = XcafDocumentPool::instance().acquire();
+    if (!readInto(path, lease.document())) {
+        return ids;
+    }
+
+    Handle(XCAFDoc_ShapeTool) tool = lease.shapeTool();
+    TDF_LabelSequence roots;
+    tool->GetFreeShapes(roots);
+    AssemblyBuilder builder(tool, assembly);
+    const QString baseName = QFileInfo(path).completeBaseName();
+    for (Standard_Integer i = 1; i <= roots.Length(); ++i) {
+        QString id = QStringLiteral("%1/%2").arg(parentId, baseName);
+        if (roots.Length() > 1) {
+            id += QStringLiteral("#%1").arg(i);
+        }
+        for (int suffix = 2; assembly.getNode(id); ++suffix) {
+            id = QStringLiteral("%1/%2~%3").arg(parentId, baseName).arg(suffix);
+        }
+        if (builder.add(roots.Value(i), TDF_Label(), gp_Trsf(), parentId, id)) {
+            ids.push_back(id);
+        }
+    }
+    if (ids.isEmpty()) {
+        Logging::warn(QStringLiteral("No products found in %1").arg(path));
+    }
+    return ids;
+}
+
+int StepIgesIO::importIncremental(const QString &path, const RootCallback &onRoot, const Message_ProgressRange &range) const {
+    initControllers();
+    const QString lower = path.toLower();
+    const bool step = lower.endsWith(".stp") || lower.endsWith(".step");
+    if (!step && !lower.endsWith(".igs") && !lower.endsWith(".iges")) {
+        Logging::warn(QStringLiteral("Unsupported CAD format: %1").arg(path));
+        return 0;
+    }
+
+    std::unique_ptr<XSControl_Reader> holder;
+    if (step) {
+        holder = std::make_unique<STEPControl_Reader>();
+    } else {
+        holder = std::make_unique<IGESControl_Reader>();
+    }
+    XSControl_Reader &reader = *holder;
+    if (reader.ReadFile(path.toStdString().c_str()) != IFSelect_RetDone) {
+        Logging::warn(QStringLiteral("Failed to read %1 file: %2").arg(step ? QStringLiteral("STEP") : QStringLiteral("IGES"), path));
+        return 0;
+    }
+
+    std::vector<TransferUnit> units;
+    if (step) {
+        units = stepTransferUnits(static_cast<STEPControl_Reader &>(reader));
+    } else {
+        for (Standard_Integer i = 1; i <= reader.NbRootsForTransfer(); ++i) {
+            units.push_back({reader.RootForTransfer(i), QString()});
+        }
+    }
+
+    const QString baseName = QFileInfo(path).completeBaseName();
+    const int count = static_cast<int>(units.size());
+    Message_ProgressScope scope(range, "Streaming import", count);
+    int delivered = 0;
+    for (int i = 0; i < count && scope.More(); ++i) {
+        // Only the reader's shape list is emptied. The transfer process keeps its results, so a
+        // part used by several components is converted once and shared between them.
+        reader.ClearShapes();
+        if (!reader.TransferEntity(units[i].entity, scope.Next()) || reader.NbShapes() == 0) {
+            Logging::warn(QStringLiteral("Skipping root %1 of %2 that did not transfer").arg(i + 1).arg(path));
+            continue;
+        }
+        ImportedRoot root;
+        root.index = i;
+        root.count = count;
+        root.name = units[i].name.isEmpty() ? QStringLiteral("%1 #%2").arg(baseName).arg(i + 1) : units[i].name;
+        root.shape = reader.Shape(reader.NbShapes());
+        ++delivered;
+        if (!onRoot(root)) break;
+    }
+    reader.ClearShapes();
+    return delivered;
+}
+
+QFuture<StepIgesIO::ImportedRoot> StepIgesIO::importStreaming(const QString &path) const {
+    return QtConcurrent::run([path](QPromise<ImportedRoot> &promise) {
+        promise.setProgressRange(0, kProgressSteps);
+        Handle(StreamProgress) progress = new StreamProgress(promise);
+        StepIgesIO().importIncremental(path, [&promise](const ImportedRoot &root) {
+            promise.addResult(root);
+            return !promise.isCanceled();
+        }, progress->Start());
+    });
 }
 
 bool StepIgesIO::exportStep(const QString &path, const TopoDS_Shape &shape) const {
-    if (shape.IsNull()) {
-        Logging::warn(QStringLiteral("Cannot export STEP: no geometry for %1").arg(path));
-        return false;
+    return exportStepBatch({{path, shape}}) == 1;
+}
+
+int StepIgesIO::exportStepBatch(const std::vector<std::pair<QString, TopoDS_Shape>> &files) const {
+    XcafDocumentPool::Lease lease = XcafDocumentPool::instance().acquire();
+    STEPCAFControl_Writer writer;
+    writer.SetColorMode(true);
+    writer.SetNameMode(true);
+    writer.SetMaterialMode(true);
+
+    int written = 0;
+    for (const auto &file : files) {
+        const QString &path = file.first;
+        if (file.second.IsNull()) {
+            Logging::warn(QStringLiteral("Cannot export STEP: no geometry for %1").arg(path));
+            continue;
+        }
+        lease.shapeTool()->AddShape(file.second);
+        bool ok = writer.Transfer(lease.document(), STEPControl_AsIs);
+        if (!ok) {
+            Logging::warn(QStringLiteral("Failed to transfer STEP document for %1").arg(path));
+        } else {
+            ok = writer.Write(path.toStdString().c_str()) == IFSelect_RetDone;
+            if (!ok) {
+                Logging::warn(QStringLiteral("Failed to write STEP file: %1").arg(path));
+            }
+        }
+        written += ok ? 1 : 0;
+
+        // The next file starts from a fresh model in the same writer and an emptied document.
+        writer.Init(writer.ChangeWriter().WS());
+        if (!lease.reset()) {
+            lease = XcafDocumentPool::instance().acquire();
+        }
+    }
+    return written;
+}
+
+namespace {
+void setLabelName(const TDF_Label &label, const QString &name) {
+    if (!name.isEmpty()) {
+        TDataStd_Name::Set(label, TCollection_ExtendedString(name.toUtf8().constData(), Standard_True));
     }
-    Handle(XCAFApp_Application) app = XCAFApp_Application::GetApplication();
-    Handle(TDocStd_Document) doc;
-    app->NewDocument("MDTV-CAF", doc);
+}
 
-    Handle(XCAFDoc_ShapeTool) shapeTool = XCAFDoc_DocumentTool::ShapeTool(doc->Main());
-    shapeTool->AddShape(shape);
+void setLabelMaterial(const TDF_Label &label, const PartRegistry::Entry *entry) {
+    if (!entry || entry->material.isEmpty()) return;
+    Handle(XCAFDoc_MaterialTool) materials = XCAFDoc_DocumentTool::MaterialTool(label);
+    materials->SetMaterial(label, new TCollection_HAsciiString(entry->material.toUtf8().constData()),
+                           new TCollection_HAsciiString(""), entry->density, new TCollection_HAsciiString("density"),
+                           new TCollection_HAsciiString("POSITIVE_RATIO_MEASURE"));
+}
 
+bool writeStepDocument(const Handle(TDocStd_Document) &doc, const QString &path) {
     STEPCAFControl_Writer writer;
     writer.SetColorMode(true);
     writer.SetNameMode(true);
     writer.SetMaterialMode(true);
-    IFSelect_ReturnStatus status = writer.Transfer(doc, STEPControl_AsIs);
-    if (status != IFSelect_RetDone) {
+    if (!writer.Transfer(doc, STEPControl_AsIs)) {
         Logging::warn(QStringLiteral("Failed to transfer STEP document for %1").arg(path));
         return false;
     }
@@ -93,6 +407,166 @@ bool StepIgesIO::exportStep(const QString &path, const TopoDS_Shape &shape) cons
     return ok;
 }
 
+// One product per distinct part geometry, shared by every node that shows it.
+struct ExportPart {
+    TopoDS_Shape shape;  // unlocated
+    QString name;
+    const PartRegistry::Entry *entry{nullptr};
+    TDF_Label label;
+};
+
+// Turns an AssemblyDocument into XCAF product structure. Nodes without children are parts;
+// nodes that name a registry part by id or part path take its shape when they hold none,
+// and parts pick up the registry material of the entry they came from.
+class AssemblyExporter {
+public:
+    AssemblyExporter(const AssemblyDocument &assembly, const PartRegistry *registry, const Handle(XCAFDoc_ShapeTool) &tool)
+        : m_assembly(assembly), m_registry(registry), m_tool(tool) {
+        if (!m_registry) return;
+        for (const auto &entry : m_registry->parts()) {
+            if (entry.shape.isLoaded()) {
+                m_entryByShape.emplace(entry.shape.get().TShape().get(), &entry);
+            }
+        }
+    }
+
+    TDF_Label build(const QString &rootName) {
+        const AssemblyNode *root = m_assembly.getNode(QStringLiteral("root"));
+        if (!root) return TDF_Label();
+        const TDF_Label top = m_tool->NewShape();
+        setLabelName(top, root->name.isEmpty() ? rootName : root->name);
+        addContents(*root, top);
+        m_tool->UpdateAssemblies();
+        return top;
+    }
+
+    std::vector<ExportPart> &parts() { return m_parts; }
+
+private:
+    const PartRegistry::Entry *entryFor(const AssemblyNode &node) const {
+        if (!m_registry) return nullptr;
+        if (const auto *entry = m_registry->find(node.id)) return entry;
+        if (!node.partPath.isEmpty()) {
+            if (const auto *entry = m_registry->find(node.partPath)) return entry;
+        }
+        if (node.shape.IsNull()) return nullptr;
+        const auto it = m_entryByShape.find(node.shape.TShape().get());
+        return it == m_entryByShape.end() ? nullptr : it->second;
+    }
+
+    void addContents(const AssemblyNode &node, const TDF_Label &assemblyLabel) {
+        const PartRegistry::Entry *entry = entryFor(node);
+        TopoDS_Shape shape = node.shape;
+        if (shape.IsNull() && entry) {
+            shape = entry->shape.get();
+        }
+        if (!shape.IsNull()) {
+            const TDF_Label component = m_tool->AddComponent(assemblyLabel, partLabel(shape, node, entry), shape.Location());
+            setLabelName(component, node.name);
+        }
+        for (const QString &childId : node.children) {
+            const AssemblyNode *child = m_assembly.getNode(childId);
+            if (child) {
+                addChild(*child, assemblyLabel);
+            }
+        }
+    }
+
+    void addChild(const AssemblyNode &node, const TDF_Label &parentLabel) {
+        const TopLoc_Location location(node.localTransform);
+        if (!node.children.empty()) {
+            const TDF_Label sub = m_tool->NewShape();
+            setLabelName(sub, node.name.isEmpty() ? node.id : node.name);
+            addContents(node, sub);
+            setLabelName(m_tool->AddComponent(parentLabel, sub, location), node.name);
+            return;
+        }
+        const PartRegistry::Entry *entry = entryFor(node);
+        TopoDS_Shape shape = node.shape;
+        if (shape.IsNull() && entry) {
+            shape = entry->shape.get();
+        }
+        if (shape.IsNull()) return;
+        const TDF_Label component = m_tool->AddComponent(parentLabel, partLabel(shape, node, entry), location * shape.Location());
+        setLabelName(component, node.name);
+    }
+
+    TDF_Label partLabel(const TopoDS_Shape &shape, const AssemblyNode &node, const PartRegistry::Entry *entry) {
+        const auto it = m_partIndex.find(shape.TShape().get());
+        if (it != m_partIndex.end()) return m_parts[it->second].label;
+
+        ExportPart part;
+        part.shape = shape.Located(TopLoc_Location());
+        part.entry = entry;
+        part.name = entry ? entry->name : (node.name.isEmpty() ? node.id : node.name);
+        part.label = m_tool->AddShape(part.shape, Standard_False);
+        setLabelName(part.label, part.name);
+        setLabelMaterial(part.label, entry);
+        m_partIndex.emplace(shape.TShape().get(), m_parts.size());
+        m_parts.push_back(part);
+        return part.label;
+    }
+
+    const AssemblyDocument &m_assembly;
+    const PartRegistry *m_registry;
+    Handle(XCAFDoc_ShapeTool) m_tool;
+    std::unordered_map<const TopoDS_TShape *, const PartRegistry::Entry *> m_entryByShape;
+    std::unordered_map<const TopoDS_TShape *, std::size_t> m_partIndex;
+    std::vector<ExportPart> m_parts;
+};
+
+QString partFileName(const QString &name) {
+    QString file = name;
+    file.replace(QRegularExpression(QStringLiteral("[^A-Za-z0-9_.-]")), QStringLiteral("_"));
+    return file.isEmpty() ? QStringLiteral("part") : file;
+}
+}
+
+bool StepIgesIO::exportAssembly(const QString &path, const AssemblyDocument &assembly, const PartRegistry *registry,
+                                AssemblyExportMode mode, QStringList *partFiles) const {
+    initControllers();
+    XcafDocumentPool::Lease lease = XcafDocumentPool::instance().acquire();
+    AssemblyExporter exporter(assembly, registry, lease.shapeTool());
+    const QFileInfo info(path);
+    if (exporter.build(info.completeBaseName()).IsNull() || exporter.parts().empty()) {
+        Logging::warn(QStringLiteral("Cannot export STEP: assembly has no parts for %1").arg(path));
+        return false;
+    }
+    bool ok = writeStepDocument(lease.document(), path);
+    if (mode != AssemblyExportMode::Split) return ok;
+
+    // Each distinct part also goes to its own file, written by its own worker with a private
+    // document; names are made unique up front so workers never race for a file name.
+    struct PartJob {
+        QString path;
+        const ExportPart *part;
+    };
+    std::vector<PartJob> jobs;
+    QSet<QString> used;
+    for (const auto &part : exporter.parts()) {
+        QString name = info.completeBaseName() + QLatin1Char('_') + partFileName(part.name);
+        for (int suffix = 2; used.contains(name); ++suffix) {
+            name = QStringLiteral("%1_%2_%3").arg(info.completeBaseName(), partFileName(part.name)).arg(suffix);
+        }
+        used.insert(name);
+        jobs.push_back({info.dir().filePath(name + QStringLiteral(".step")), &part});
+    }
+    const QList<bool> written = QtConcurrent::blockingMapped<QList<bool>>(jobs, [](const PartJob &job) {
+        XcafDocumentPool::Lease partLease = XcafDocumentPool::instance().acquire();
+        const TDF_Label label = partLease.shapeTool()->AddShape(job.part->shape, Standard_False);
+        setLabelName(label, job.part->name);
+        setLabelMaterial(label, job.part->entry);
+        return writeStepDocument(partLease.document(), job.path);
+    });
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        ok = ok && written[static_cast<int>(i)];
+        if (partFiles && written[static_cast<int>(i)]) {
+            partFiles->push_back(jobs[i].path);
+        }
+    }
+    return ok;
+}
+
 bool StepIgesIO::exportIges(const QString &path, const TopoDS_Shape &shape) const {
     if (shape.IsNull()) {
         Logging::warn(QStringLiteral("Cannot export IGES: no geometry for %1").arg(path));
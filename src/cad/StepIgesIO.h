@@ -1,14 +1,67 @@
 #pragma once
 
+#include <Message_ProgressRange.hxx>
+#include <QFuture>
 #include <QString>
+#include <QStringList>
+#include <TDocStd_Document.hxx>
 #include <TopoDS_Shape.hxx>
+#include <functional>
+#include <utility>
+#include <vector>
+
+class AssemblyDocument;
+class PartRegistry;
 
 class StepIgesIO {
 public:
+    // One unit of a streamed import: a top-level product, or a direct component of a
+    // top-level STEP assembly, placed as in the full model.
+    struct ImportedRoot {
+        int index{0};
+        int count{0};
+        QString name;
+        TopoDS_Shape shape;
+    };
+    // Return false to stop the import.
+    using RootCallback = std::function<bool(const ImportedRoot &)>;
+
+    enum class AssemblyExportMode {
+        Single,  // one file with the whole product structure
+        Split    // also one file per distinct part, written concurrently beside it
+    };
+
     StepIgesIO();
 
     TopoDS_Shape importFile(const QString &path) const;
+    // Transfers the file one root at a time and hands each shape over as soon as it is built,
+    // instead of converting the whole model first. Returns the number of roots delivered.
+    int importIncremental(const QString &path, const RootCallback &onRoot,
+                          const Message_ProgressRange &range = Message_ProgressRange()) const;
+    // importIncremental on the thread pool with one future result per root, so a watcher can
+    // show parts while the rest of the file loads. Cancelling the future stops the transfer.
+    QFuture<ImportedRoot> importStreaming(const QString &path) const;
+    // Fills `assembly` with one node per product occurrence under `parentId`, keeping the
+    // file's structure: repeated parts share one TopoDS_Shape and each node's localTransform
+    // is its XCAF location. Returns the ids of the top-level nodes, empty on failure.
+    QStringList importAssembly(const QString &path, AssemblyDocument &assembly,
+                               const QString &parentId = QStringLiteral("root")) const;
+    // Reads a STEP or IGES file with names, colours and materials into `doc`. Safe to call
+    // from several threads as long as each uses its own document.
+    bool readInto(const QString &path, const Handle(TDocStd_Document) &doc,
+                  const Message_ProgressRange &range = Message_ProgressRange()) const;
+    // Compound of the document's free shapes.
+    static TopoDS_Shape freeShapes(const Handle(TDocStd_Document) &doc);
     bool exportStep(const QString &path, const TopoDS_Shape &shape) const;
+    // Writes `assembly` as STEP product structure: each distinct part geometry is one product
+    // and repeated nodes are instances of it. `registry` supplies shapes for nodes that name a
+    // part by id or part path, and the material of each part. Split mode lists the part files
+    // it wrote in `partFiles`.
+    bool exportAssembly(const QString &path, const AssemblyDocument &assembly, const PartRegistry *registry = nullptr,
+                        AssemblyExportMode mode = AssemblyExportMode::Single, QStringList *partFiles = nullptr) const;
+    // Writes one STEP file per (path, shape) through a single configured writer and one
+    // reused document. Returns the number of files written; failures are logged.
+    int exportStepBatch(const std::vector<std::pair<QString, TopoDS_Shape>> &files) const;
     bool exportIges(const QString &path, const TopoDS_Shape &shape) const;
 };
 
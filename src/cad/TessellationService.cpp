@@ -0,0 +1,379 @@
+#include "TessellationService.h"
+#include "FeatureOps.h"
+#include "ShapeHash.h"
+#include "../utils/Logging.h"
+
+#include <BRepBuilderAPI_Copy.hxx>
+#include <BRepMesh_IncrementalMesh.hxx>
+#include <BRepPrimAPI_MakeBox.hxx>
+#include <BRep_Builder.hxx>
+#include <BRep_Tool.hxx>
+#include <Poly_Triangulation.hxx>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <QtConcurrent>
+#include <TopExp.hxx>
+#include <TopLoc_Location.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Face.hxx>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+constexpr char kMagic[8] = {'A', 'E', 'G', 'I', 'S', 'T', 'R', 'I'};
+constexpr quint32 kVersion = 2;
+constexpr qint64 kNodeBytes = 3 * sizeof(double);
+constexpr qint64 kTriangleBytes = 3 * sizeof(qint32);
+
+// Content hashes come from std::hash, which may differ between builds and platforms. The
+// hash of a fixed shape tells builds apart, so each gets its own subdirectory.
+const QString &subdirectory() {
+    static const QString name = QStringLiteral("v%1-%2")
+                                    .arg(kVersion)
+                                    .arg(static_cast<qulonglong>(ShapeHash::contentHash(BRepPrimAPI_MakeBox(1.0, 2.0, 3.0).Shape())),
+                                         16, 16, QLatin1Char('0'));
+    return name;
+}
+
+QString fileName(std::size_t content, const TessellationService::Parameters &parameters) {
+    std::size_t seed = content;
+    ShapeHash::combineValue(seed, parameters.linearDeflection);
+    ShapeHash::combineValue(seed, parameters.angularDeflection);
+    ShapeHash::combineValue(seed, parameters.relative);
+    ShapeHash::combineValue(seed, kVersion);
+    return QString::number(static_cast<qulonglong>(seed), 16).rightJustified(16, QLatin1Char('0')) + QStringLiteral(".tri");
+}
+
+void prepareStream(QDataStream &stream) {
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
+}
+
+// Header (magic, version, content hash, parameters, face count), every face's key, then per
+// face in TopExp::MapShapes order: node and triangle counts, UV flag, deflection, nodes in
+// the frame of the whole shape, UV nodes and 1-based triangle indices. Faces BRepMesh could
+// not mesh are stored with no nodes.
+bool writeMesh(const QString &path, std::size_t content, const TessellationService::Parameters &parameters,
+               const TopTools_IndexedMapOfShape &faces, const std::vector<ShapeHash::FaceKey> &keys) {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    QDataStream out(&file);
+    prepareStream(out);
+    out.writeRawData(kMagic, sizeof(kMagic));
+    out << kVersion << static_cast<quint64>(content) << parameters.linearDeflection << parameters.angularDeflection
+        << parameters.relative << static_cast<quint32>(faces.Extent());
+    for (const ShapeHash::FaceKey &key : keys) {
+        out << key.surface;
+        for (double bound : key.bounds) {
+            out << bound;
+        }
+        out << key.area;
+    }
+
+    for (int i = 1; i <= faces.Extent(); ++i) {
+        TopLoc_Location location;
+        const Handle(Poly_Triangulation) mesh = BRep_Tool::Triangulation(TopoDS::Face(faces(i)), location);
+        if (mesh.IsNull()) {
+            out << quint32(0) << quint32(0) << false << 0.0;
+            continue;
+        }
+        const gp_Trsf toShape = location.Transformation();
+        out << static_cast<quint32>(mesh->NbNodes()) << static_cast<quint32>(mesh->NbTriangles()) << mesh->HasUVNodes()
+            << mesh->Deflection();
+        for (Standard_Integer n = 1; n <= mesh->NbNodes(); ++n) {
+            const gp_Pnt node = mesh->Node(n).Transformed(toShape);
+            out << node.X() << node.Y() << node.Z();
+        }
+        if (mesh->HasUVNodes()) {
+            for (Standard_Integer n = 1; n <= mesh->NbNodes(); ++n) {
+                const gp_Pnt2d uv = mesh->UVNode(n);
+                out << uv.X() << uv.Y();
+            }
+        }
+        for (Standard_Integer t = 1; t <= mesh->NbTriangles(); ++t) {
+            Standard_Integer a = 0, b = 0, c = 0;
+            mesh->Triangle(t).Get(a, b, c);
+            out << static_cast<qint32>(a) << static_cast<qint32>(b) << static_cast<qint32>(c);
+        }
+    }
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+// Applies the file only when it parses completely and matches the shape; a partial or
+// foreign file leaves the faces untouched. A file that is used is touched, so modification
+// times order the cache by last use.
+bool readMesh(const QString &path, std::size_t content, const TessellationService::Parameters &parameters,
+              const TopTools_IndexedMapOfShape &faces, const std::vector<ShapeHash::FaceKey> &keys) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    QDataStream in(&file);
+    prepareStream(in);
+
+    char magic[sizeof(kMagic)];
+    if (in.readRawData(magic, sizeof(magic)) != sizeof(magic) || std::memcmp(magic, kMagic, sizeof(magic)) != 0) {
+        return false;
+    }
+    quint32 version = 0;
+    quint64 storedContent = 0;
+    double linear = 0.0;
+    double angular = 0.0;
+    bool relative = false;
+    quint32 faceCount = 0;
+    in >> version >> storedContent >> linear >> angular >> relative >> faceCount;
+    if (in.status() != QDataStream::Ok || version != kVersion || storedContent != content
+        || linear != parameters.linearDeflection || angular != parameters.angularDeflection
+        || relative != parameters.relative || faceCount != static_cast<quint32>(faces.Extent())) {
+        return false;
+    }
+    for (const ShapeHash::FaceKey &expected : keys) {
+        ShapeHash::FaceKey stored;
+        in >> stored.surface;
+        for (double &bound : stored.bounds) {
+            in >> bound;
+        }
+        in >> stored.area;
+        if (in.status() != QDataStream::Ok || !ShapeHash::sameFace(stored, expected)) return false;
+    }
+
+    std::vector<Handle(Poly_Triangulation)> meshes(faceCount);
+    for (quint32 i = 0; i < faceCount; ++i) {
+        quint32 nodes = 0;
+        quint32 triangles = 0;
+        bool hasUV = false;
+        double deflection = 0.0;
+        in >> nodes >> triangles >> hasUV >> deflection;
+        if (in.status() != QDataStream::Ok || static_cast<qint64>(nodes) * kNodeBytes > file.size()
+            || static_cast<qint64>(triangles) * kTriangleBytes > file.size()) {
+            return false;
+        }
+        if (nodes == 0) continue;
+
+        const gp_Trsf toFace = faces(static_cast<int>(i) + 1).Location().Transformation().Inverted();
+        Handle(Poly_Triangulation) mesh = new Poly_Triangulation(nodes, triangles, hasUV);
+        for (quint32 n = 1; n <= nodes; ++n) {
+            double x = 0.0, y = 0.0, z = 0.0;
+            in >> x >> y >> z;
+            mesh->SetNode(n, gp_Pnt(x, y, z).Transformed(toFace));
+        }
+        if (hasUV) {
+            for (quint32 n = 1; n <= nodes; ++n) {
+                double u = 0.0, v = 0.0;
+                in >> u >> v;
+                mesh->SetUVNode(n, gp_Pnt2d(u, v));
+            }
+        }
+        for (quint32 t = 1; t <= triangles; ++t) {
+            qint32 a = 0, b = 0, c = 0;
+            in >> a >> b >> c;
+            const qint32 last = static_cast<qint32>(nodes);
+            if (a < 1 || b < 1 || c < 1 || a > last || b > last || c > last) return false;
+            mesh->SetTriangle(t, Poly_Triangle(a, b, c));
+        }
+        if (in.status() != QDataStream::Ok) return false;
+        mesh->Deflection(deflection);
+        meshes[i] = mesh;
+    }
+
+    BRep_Builder builder;
+    for (quint32 i = 0; i < faceCount; ++i) {
+        if (!meshes[i].IsNull()) {
+            builder.UpdateFace(TopoDS::Face(faces(static_cast<int>(i) + 1)), meshes[i]);
+        }
+    }
+    file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+    return true;
+}
+
+struct Job {
+    TopoDS_Shape prototype;  // unlocated, forward
+    TopoDS_Shape meshed;
+};
+}
+
+TessellationService::TessellationService() {
+    const QString cache = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (!cache.isEmpty()) {
+        m_directory = QDir(cache).filePath(QStringLiteral("tessellation"));
+    }
+}
+
+TessellationService &TessellationService::instance() {
+    static TessellationService service;
+    return service;
+}
+
+void TessellationService::setCacheDirectory(const QString &directory) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_directory = directory;
+    m_preparedDirectory.clear();
+    m_usage = -1;
+}
+
+QString TessellationService::cacheDirectory() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_directory;
+}
+
+QString TessellationService::cachePath() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_directory.isEmpty() ? QString() : QDir(m_directory).filePath(subdirectory());
+}
+
+void TessellationService::setCapacity(qint64 bytes) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_capacity = bytes;
+    }
+    const QString path = cachePath();
+    if (!path.isEmpty()) trim(path, 0);
+}
+
+qint64 TessellationService::capacity() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_capacity;
+}
+
+void TessellationService::clear() {
+    const QString path = cachePath();
+    if (path.isEmpty()) return;
+    QDir dir(path);
+    for (const QString &name : dir.entryList({QStringLiteral("*.tri")}, QDir::Files)) {
+        dir.remove(name);
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_usage = -1;
+}
+
+TessellationService::Stats TessellationService::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void TessellationService::resetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats = {};
+}
+
+TopoDS_Shape TessellationService::tessellate(const TopoDS_Shape &shape, const Parameters &parameters) {
+    return tessellateAll({shape}, parameters).front();
+}
+
+std::vector<TopoDS_Shape> TessellationService::tessellateAll(const std::vector<TopoDS_Shape> &shapes,
+                                                             const Parameters &parameters) {
+    // Located repeats share their TShape, so each distinct piece is copied and meshed once.
+    std::vector<Job> jobs;
+    std::unordered_map<const TopoDS_TShape *, std::size_t> jobOf;
+    for (const auto &shape : shapes) {
+        if (!shape.IsNull() && jobOf.emplace(shape.TShape().get(), jobs.size()).second) {
+            jobs.push_back({shape.Located(TopLoc_Location()).Oriented(TopAbs_FORWARD), TopoDS_Shape()});
+        }
+    }
+    const bool parallelFaces = jobs.size() < static_cast<std::size_t>(QThread::idealThreadCount());
+    QtConcurrent::blockingMap(jobs, [this, &parameters, parallelFaces](Job &job) {
+        job.meshed = meshOne(job.prototype, parameters, parallelFaces);
+    });
+
+    std::vector<TopoDS_Shape> result(shapes.size());
+    for (std::size_t i = 0; i < shapes.size(); ++i) {
+        if (shapes[i].IsNull()) continue;
+        const TopoDS_Shape &meshed = jobs[jobOf.at(shapes[i].TShape().get())].meshed;
+        if (!meshed.IsNull()) {
+            result[i] = meshed.Located(shapes[i].Location()).Oriented(shapes[i].Orientation());
+        }
+    }
+    return result;
+}
+
+QString TessellationService::preparePath() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_directory.isEmpty()) return QString();
+    QDir root(m_directory);
+    const QString path = root.filePath(subdirectory());
+    if (m_preparedDirectory != m_directory) {
+        // Files from other formats or builds can never be read here again.
+        static const QRegularExpression versioned(QStringLiteral("^v\\d+-[0-9a-f]{16}$"));
+        for (const QString &name : root.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+            if (name != subdirectory() && versioned.match(name).hasMatch()) {
+                QDir(root.filePath(name)).removeRecursively();
+            }
+        }
+        for (const QString &name : root.entryList({QStringLiteral("*.tri")}, QDir::Files)) {
+            root.remove(name);
+        }
+        m_preparedDirectory = m_directory;
+        m_usage = -1;
+    }
+    return path;
+}
+
+void TessellationService::trim(const QString &path, qint64 written) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_usage >= 0) {
+        m_usage += written;
+        if (m_usage <= m_capacity) return;
+    }
+    const QFileInfoList files =
+        QDir(path).entryInfoList({QStringLiteral("*.tri")}, QDir::Files, QDir::Time | QDir::Reversed);
+    m_usage = 0;
+    for (const QFileInfo &file : files) {
+        m_usage += file.size();
+    }
+    for (const QFileInfo &file : files) {
+        if (m_usage <= m_capacity) break;
+        if (QFile::remove(file.filePath())) {
+            m_usage -= file.size();
+            ++m_stats.evicted;
+        }
+    }
+}
+
+TopoDS_Shape TessellationService::meshOne(const TopoDS_Shape &shape, const Parameters &parameters, bool parallelFaces) {
+    if (parameters.linearDeflection <= 0.0) return TopoDS_Shape();
+    // Neither geometry nor triangulations are copied, so the copy starts without a mesh.
+    const TopoDS_Shape copy = BRepBuilderAPI_Copy(shape, Standard_False, Standard_False).Shape();
+    TopTools_IndexedMapOfShape faces;
+    TopExp::MapShapes(copy, TopAbs_FACE, faces);
+    const QString directory = preparePath();
+    QString path;
+    std::size_t content = 0;
+    std::vector<ShapeHash::FaceKey> keys;
+    if (!directory.isEmpty()) {
+        content = ShapeHash::contentHash(copy);
+        keys = ShapeHash::faceKeys(faces);
+        path = QDir(directory).filePath(fileName(content, parameters));
+        if (readMesh(path, content, parameters, faces, keys)) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_stats.diskHits;
+            return copy;
+        }
+    }
+
+    BRepMesh_IncrementalMesh mesher(copy, parameters.linearDeflection, parameters.relative, parameters.angularDeflection,
+                                    parallelFaces && FeatureOps::executionPolicy().parallelMeshing);
+    if (!mesher.IsDone()) return TopoDS_Shape();
+
+    bool written = true;
+    if (!path.isEmpty()) {
+        written = QDir().mkpath(directory) && writeMesh(path, content, parameters, faces, keys);
+        if (written) {
+            trim(directory, QFileInfo(path).size());
+        } else {
+            Logging::warn(QStringLiteral("Could not write tessellation cache file %1").arg(path));
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_stats.meshed;
+    m_stats.writeFailures += written ? 0 : 1;
+    return copy;
+}
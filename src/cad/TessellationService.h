@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+#include <TopoDS_Shape.hxx>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Meshes shapes for every consumer (viewers, glTF export, analysis) and keeps the face
+// triangulations in a content-addressed cache on disk. Files are keyed by
+// ShapeHash::contentHash and the meshing parameters, so reopening a project, or rebuilding a
+// shape identically, reads the triangulations back instead of running BRepMesh again. Each
+// file also records every face's surface type, bounds and area, and is only used when those
+// match. The shapes passed in are never meshed: their faces may be shared with other shapes
+// and threads, and BRepMesh keeps any finer mesh it finds. Meshes go onto copies instead.
+class TessellationService {
+public:
+    struct Parameters {
+        double linearDeflection{0.1};
+        double angularDeflection{0.5};
+        bool relative{false};
+    };
+
+    struct Stats {
+        std::size_t diskHits{0};
+        std::size_t meshed{0};
+        std::size_t writeFailures{0};
+        std::size_t evicted{0};
+    };
+
+    static TessellationService &instance();
+
+    // A copy of `shape` with a triangulation on every face, from the cache when possible, or
+    // a null shape when meshing fails. The copy shares geometry with `shape`, not topology.
+    TopoDS_Shape tessellate(const TopoDS_Shape &shape, const Parameters &parameters);
+    // One copy per entry of `shapes`, in order. Located repeats of a piece share one meshed
+    // copy; distinct pieces are handled side by side on the thread pool, and a single piece
+    // lets BRepMesh spread its faces instead.
+    std::vector<TopoDS_Shape> tessellateAll(const std::vector<TopoDS_Shape> &shapes, const Parameters &parameters);
+
+    // Defaults to "tessellation" under the application's cache location. An empty
+    // directory keeps meshing but disables the disk cache.
+    void setCacheDirectory(const QString &directory);
+    QString cacheDirectory() const;
+    // Where the files are: a subdirectory of cacheDirectory() named for the file format and
+    // for this build's hashes. Other subdirectories are removed when it is first used.
+    QString cachePath() const;
+    // Least recently used files are removed once the cache holds more than this. 1 GiB by
+    // default.
+    void setCapacity(qint64 bytes);
+    qint64 capacity() const;
+    // Removes the cached files.
+    void clear();
+
+    Stats stats() const;
+    void resetStats();
+
+private:
+    TessellationService();
+    TopoDS_Shape meshOne(const TopoDS_Shape &shape, const Parameters &parameters, bool parallelFaces);
+    QString preparePath();
+    void trim(const QString &path, qint64 written);
+
+    mutable std::mutex m_mutex;
+    QString m_directory;
+    QString m_preparedDirectory;
+    qint64 m_capacity{qint64(1) << 30};
+    qint64 m_usage{-1};  // bytes in cachePath(), -1 until first counted
+    Stats m_stats;
+};
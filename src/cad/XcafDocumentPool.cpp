@@ -0,0 +1,224 @@
+#include "XcafDocumentPool.h"
+#include "../utils/Logging.h"
+
+#include <TDF_ChildIterator.hxx>
+#include <TDF_LabelSequence.hxx>
+#include <XCAFApp_Application.hxx>
+#include <TDF_Data.hxx>
+#include <XCAFDoc_ClippingPlaneTool.hxx>
+#include <XCAFDoc_ColorTool.hxx>
+#include <XCAFDoc_DimTolTool.hxx>
+#include <XCAFDoc_DocumentTool.hxx>
+#include <XCAFDoc_LayerTool.hxx>
+#include <XCAFDoc_MaterialTool.hxx>
+#include <XCAFDoc_NotesTool.hxx>
+#include <XCAFDoc_ViewTool.hxx>
+#include <XCAFDoc_VisMaterialTool.hxx>
+
+namespace {
+// The application keeps the list of open documents, so opening and closing is serialized.
+std::mutex &applicationMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+void forgetChildren(const TDF_Label &label) {
+    for (TDF_ChildIterator it(label); it.More(); it.Next()) {
+        it.Value().ForgetAllAttributes(Standard_True);
+    }
+}
+}
+
+XcafDocumentPool::Lease::Lease(XcafDocumentPool *pool, Handle(TDocStd_Document) document)
+    : m_pool(pool), m_document(std::move(document)) {}
+
+XcafDocumentPool::Lease::Lease(Lease &&other) noexcept : m_pool(other.m_pool), m_document(std::move(other.m_document)) {
+    other.m_pool = nullptr;
+    other.m_document.Nullify();
+}
+
+XcafDocumentPool::Lease &XcafDocumentPool::Lease::operator=(Lease &&other) noexcept {
+    if (this != &other) {
+        release();
+        m_pool = other.m_pool;
+        m_document = std::move(other.m_document);
+        other.m_pool = nullptr;
+        other.m_document.Nullify();
+    }
+    return *this;
+}
+
+XcafDocumentPool::Lease::~Lease() {
+    release();
+}
+
+Handle(XCAFDoc_ShapeTool) XcafDocumentPool::Lease::shapeTool() const {
+    return m_document.IsNull() ? Handle(XCAFDoc_ShapeTool)() : XCAFDoc_DocumentTool::ShapeTool(m_document->Main());
+}
+
+bool XcafDocumentPool::Lease::reset() {
+    return m_document.IsNull() || (m_pool ? m_pool->recycle(m_document) : emptyDocument(m_document));
+}
+
+void XcafDocumentPool::Lease::release() {
+    if (m_pool && !m_document.IsNull()) {
+        m_pool->giveBack(m_document);
+    }
+    m_pool = nullptr;
+    m_document.Nullify();
+}
+
+XcafDocumentPool::XcafDocumentPool(std::size_t capacity) : m_capacity(capacity) {}
+
+XcafDocumentPool::~XcafDocumentPool() {
+    clear();
+    if (m_leased > 0) {
+        Logging::warn(QStringLiteral("XCAF document pool destroyed with %1 documents still leased").arg(m_leased));
+    }
+}
+
+XcafDocumentPool &XcafDocumentPool::instance() {
+    static XcafDocumentPool pool;
+    return pool;
+}
+
+XcafDocumentPool::Lease XcafDocumentPool::acquire() {
+    Handle(TDocStd_Document) document;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_leased;
+        if (!m_idle.empty()) {
+            document = m_idle.back();
+            m_idle.pop_back();
+        }
+    }
+    if (document.IsNull()) {
+        Handle(XCAFApp_Application) app = XCAFApp_Application::GetApplication();
+        std::lock_guard<std::mutex> lock(applicationMutex());
+        app->NewDocument("MDTV-CAF", document);
+    }
+    return Lease(this, document);
+}
+
+void XcafDocumentPool::setCapacity(std::size_t capacity) {
+    std::vector<Handle(TDocStd_Document)> surplus;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_capacity = capacity;
+        while (m_idle.size() > m_capacity) {
+            surplus.push_back(m_idle.back());
+            m_idle.pop_back();
+        }
+    }
+    for (const auto &document : surplus) {
+        closeDocument(document);
+    }
+}
+
+void XcafDocumentPool::clear() {
+    std::vector<Handle(TDocStd_Document)> idle;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        idle.swap(m_idle);
+    }
+    for (const auto &document : idle) {
+        closeDocument(document);
+    }
+}
+
+void XcafDocumentPool::setRetirement(std::size_t maxUses, std::size_t maxLabels) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxUses = maxUses;
+    m_maxLabels = maxLabels;
+}
+
+std::size_t XcafDocumentPool::labelCount(const Handle(TDocStd_Document) &document) {
+    std::size_t count = 0;
+    for (TDF_ChildIterator it(document->GetData()->Root(), Standard_True); it.More(); it.Next()) {
+        ++count;
+    }
+    return count;
+}
+
+std::size_t XcafDocumentPool::idleCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_idle.size();
+}
+
+std::size_t XcafDocumentPool::leasedCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_leased;
+}
+
+void XcafDocumentPool::giveBack(const Handle(TDocStd_Document) &document) {
+    const bool reusable = recycle(document);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_leased;
+        if (reusable && m_idle.size() < m_capacity) {
+            m_idle.push_back(document);
+            return;
+        }
+    }
+    closeDocument(document);
+}
+
+bool XcafDocumentPool::recycle(const Handle(TDocStd_Document) &document) {
+    if (!emptyDocument(document)) return false;
+    std::size_t uses = 0;
+    std::size_t maxUses = 0;
+    std::size_t maxLabels = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uses = ++m_uses[document.get()];
+        maxUses = m_maxUses;
+        maxLabels = m_maxLabels;
+    }
+    return uses < maxUses && labelCount(document) <= maxLabels;
+}
+
+bool XcafDocumentPool::emptyDocument(const Handle(TDocStd_Document) &document) {
+    if (document->HasOpenCommand()) {
+        document->AbortCommand();
+    }
+    const TDF_Label main = document->Main();
+    Handle(XCAFDoc_ShapeTool) shapes = XCAFDoc_DocumentTool::ShapeTool(main);
+
+    // Free shapes go first; removing an assembly frees the parts it referenced.
+    TDF_LabelSequence labels;
+    for (;;) {
+        labels.Clear();
+        shapes->GetFreeShapes(labels);
+        bool removed = false;
+        for (Standard_Integer i = 1; i <= labels.Length(); ++i) {
+            removed = shapes->RemoveShape(labels.Value(i), Standard_True) || removed;
+        }
+        if (!removed) break;
+    }
+    labels.Clear();
+    shapes->GetShapes(labels);
+    if (!labels.IsEmpty()) return false;
+
+    forgetChildren(XCAFDoc_DocumentTool::ColorTool(main)->BaseLabel());
+    forgetChildren(XCAFDoc_DocumentTool::LayerTool(main)->BaseLabel());
+    forgetChildren(XCAFDoc_DocumentTool::MaterialTool(main)->BaseLabel());
+    forgetChildren(XCAFDoc_DocumentTool::VisMaterialTool(main)->BaseLabel());
+    // Readers keep GD&T and saved views by default, with the presentation shapes they hold.
+    forgetChildren(XCAFDoc_DocumentTool::DimTolTool(main)->BaseLabel());
+    forgetChildren(XCAFDoc_DocumentTool::ViewTool(main)->BaseLabel());
+    forgetChildren(XCAFDoc_DocumentTool::NotesTool(main)->Label());
+    forgetChildren(XCAFDoc_DocumentTool::ClippingPlaneTool(main)->BaseLabel());
+    document->ClearUndos();
+    document->ClearRedos();
+    return true;
+}
+
+void XcafDocumentPool::closeDocument(const Handle(TDocStd_Document) &document) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_uses.erase(document.get());
+    }
+    Handle(XCAFApp_Application) app = XCAFApp_Application::GetApplication();
+    std::lock_guard<std::mutex> lock(applicationMutex());
+    app->Close(document);
+}
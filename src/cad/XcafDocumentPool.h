@@ -0,0 +1,76 @@
+#pragma once
+
+#include <TDocStd_Document.hxx>
+#include <XCAFDoc_ShapeTool.hxx>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Owns the XCAF documents used by importers and exporters. A document is leased for one job
+// and handed back when the lease ends: it is emptied and kept for the next job, or closed
+// when the pool already holds `capacity` idle documents. Every document the pool opens is
+// closed again, so batch jobs no longer leave one open document per file in the application.
+// Emptying forgets attributes but OCAF never frees label nodes, so a document is also closed
+// once it has served `maxUses` jobs or holds more than `maxLabels` labels.
+class XcafDocumentPool {
+public:
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease &&other) noexcept;
+        Lease &operator=(Lease &&other) noexcept;
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+        ~Lease();
+
+        const Handle(TDocStd_Document) &document() const { return m_document; }
+        Handle(XCAFDoc_ShapeTool) shapeTool() const;
+        explicit operator bool() const { return !m_document.IsNull(); }
+
+        // Empties the document for the next job without giving it back. False when it could
+        // not be emptied or is due for retirement; the caller then acquires a new lease.
+        bool reset();
+        // Gives the document back early.
+        void release();
+
+    private:
+        friend class XcafDocumentPool;
+        Lease(XcafDocumentPool *pool, Handle(TDocStd_Document) document);
+
+        XcafDocumentPool *m_pool{nullptr};
+        Handle(TDocStd_Document) m_document;
+    };
+
+    explicit XcafDocumentPool(std::size_t capacity = 4);
+    ~XcafDocumentPool();
+
+    // Shared by all importers and exporters of the process.
+    static XcafDocumentPool &instance();
+
+    Lease acquire();
+
+    void setCapacity(std::size_t capacity);
+    void setRetirement(std::size_t maxUses, std::size_t maxLabels);
+    // Labels of every level under the document's root, emptied or not.
+    static std::size_t labelCount(const Handle(TDocStd_Document) &document);
+    // Closes the idle documents.
+    void clear();
+    std::size_t idleCount() const;
+    std::size_t leasedCount() const;
+
+private:
+    void giveBack(const Handle(TDocStd_Document) &document);
+    // Empties the document and counts the use; false when it must not be used again.
+    bool recycle(const Handle(TDocStd_Document) &document);
+    static bool emptyDocument(const Handle(TDocStd_Document) &document);
+    void closeDocument(const Handle(TDocStd_Document) &document);
+
+    mutable std::mutex m_mutex;
+    std::vector<Handle(TDocStd_Document)> m_idle;
+    std::unordered_map<const TDocStd_Document *, std::size_t> m_uses;
+    std::size_t m_capacity;
+    std::size_t m_leased{0};
+    std::size_t m_maxUses{64};
+    std::size_t m_maxLabels{100000};
+};
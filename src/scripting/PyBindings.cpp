@@ -3,7 +3,10 @@
 #include "../ai/AegisAIEngine.h"
 #include "../analysis/AnalysisManager.h"
 #include "../analysis/AnalysisTypes.h"
+#include "../cad/EdgeIndex.h"
 #include "../cad/FeatureOps.h"
+#include "../cad/PersistentNaming.h"
+#include "../cad/ShapeCache.h"
 #include "../ui/OccView.h"
 
 #include <array>
@@ -248,6 +251,122 @@ Args:
 Returns:
     Shape: A shape with filleted edges.
           )doc");
+    m.def("edge_count",
+          [](const TopoDS_Shape &shape) {
+              ensureShapeValid(shape, "shape");
+              return EdgeIndex::forShape(shape)->edgeCount();
+          },
+          py::arg("shape"),
+          R"doc(Return the number of distinct edges of a shape.
+
+Edge numbers accepted by ``fillet_edges`` and ``chamfer_edges`` range from 0 to ``edge_count(shape) - 1``.
+          )doc");
+    m.def("fillet_edges",
+          [](const TopoDS_Shape &shape, const std::vector<std::pair<int, double>> &edges) {
+              ensureShapeValid(shape, "shape");
+              const auto index = EdgeIndex::forShape(shape);
+              std::vector<FeatureOps::EdgeFillet> selection;
+              selection.reserve(edges.size());
+              for (const auto &entry : edges) {
+                  if (!index->contains(entry.first)) {
+                      throw py::index_error("edge index out of range");
+                  }
+                  requirePositive("radius", entry.second);
+                  selection.push_back({entry.first, entry.second});
+              }
+              return FeatureOps::fillet(shape, selection);
+          },
+          py::arg("shape"), py::arg("edges"),
+          R"doc(Fillet selected edges, each with its own radius.
+
+Args:
+    shape (Shape): Target shape; cannot be empty.
+    edges (list[tuple[int, float]]): ``(edge, radius)`` pairs; radii must be positive.
+
+Returns:
+    Shape: A shape with the selected edges filleted.
+          )doc");
+    m.def("chamfer_edges",
+          [](const TopoDS_Shape &shape, const std::vector<int> &edges, double distance) {
+              ensureShapeValid(shape, "shape");
+              requirePositive("distance", distance);
+              const auto index = EdgeIndex::forShape(shape);
+              for (int edge : edges) {
+                  if (!index->contains(edge)) {
+                      throw py::index_error("edge index out of range");
+                  }
+              }
+              return FeatureOps::chamfer(shape, edges, distance);
+          },
+          py::arg("shape"), py::arg("edges"), py::arg("distance"),
+          R"doc(Chamfer selected edges with a symmetric distance.
+
+Args:
+    shape (Shape): Target shape; cannot be empty.
+    edges (list[int]): Edge numbers as counted by ``edge_count``.
+    distance (float): Chamfer distance (> 0).
+
+Returns:
+    Shape: A shape with the selected edges chamfered.
+          )doc");
+    m.def("set_persistent_naming",
+          [](bool enabled) { PersistentNaming::setEnabled(enabled); },
+          py::arg("enabled"),
+          R"doc(Enable or disable sub-shape history recording for feature operations.
+
+Batch scripts that never query face/edge history can turn this off to skip the bookkeeping.
+
+Args:
+    enabled (bool): True to record history (default), False to skip it.
+          )doc");
+    m.def("persistent_naming_enabled", []() { return PersistentNaming::isEnabled(); },
+          R"doc(Return whether feature operations record sub-shape history.)doc");
+    m.def("set_execution_policy",
+          [](int threads, bool parallel_booleans, bool parallel_meshing, bool use_obb, double fuzzy_value) {
+              if (threads < 0) {
+                  throw py::value_error("threads must be zero or positive");
+              }
+              if (fuzzy_value < 0.0) {
+                  throw py::value_error("fuzzy_value must be zero or positive");
+              }
+              FeatureOps::ExecutionPolicy policy;
+              policy.threads = threads;
+              policy.parallelBooleans = parallel_booleans;
+              policy.parallelMeshing = parallel_meshing;
+              policy.useOBB = use_obb;
+              policy.fuzzyValue = fuzzy_value;
+              FeatureOps::setExecutionPolicy(policy);
+          },
+          py::arg("threads") = 0, py::arg("parallel_booleans") = true, py::arg("parallel_meshing") = true,
+          py::arg("use_obb") = true, py::arg("fuzzy_value") = 0.0,
+          R"doc(Configure OCCT's parallel modes for subsequent feature operations.
+
+Args:
+    threads (int): Worker threads; 0 uses one per hardware thread.
+    parallel_booleans (bool): Run boolean operations in parallel.
+    parallel_meshing (bool): Triangulate faces in parallel.
+    use_obb (bool): Use oriented bounding boxes to filter boolean interferences.
+    fuzzy_value (float): Additional boolean tolerance (>= 0); 0 keeps the default.
+          )doc");
+    m.def("shape_cache_stats",
+          []() {
+              const auto stats = ShapeCache::instance().stats();
+              py::dict result;
+              result["hits"] = stats.hits;
+              result["misses"] = stats.misses;
+              result["evictions"] = stats.evictions;
+              result["entries"] = stats.entries;
+              result["bytes"] = stats.bytes;
+              result["capacity_bytes"] = stats.capacityBytes;
+              return result;
+          },
+          R"doc(Return hit/miss counters and memory use of the feature result cache.
+
+Returns:
+    dict: ``hits``, ``misses``, ``evictions``, ``entries``, ``bytes`` and ``capacity_bytes``.
+          )doc");
+    m.def("clear_shape_cache", []() { ShapeCache::instance().clear(); },
+          R"doc(Drop every memoized feature result and reset the cache counters.)doc");
 
     if (view) {
         m.def("display",
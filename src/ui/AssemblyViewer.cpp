@@ -1,9 +1,12 @@
 #include "AssemblyViewer.h"
+#include "../cad/TessellationService.h"
 
 #include <AIS_Shape.hxx>
 #include <AIS_ConnectedInteractive.hxx>
 #include <Aspect_DisplayConnection.hxx>
 #include <OpenGl_GraphicDriver.hxx>
+#include <Prs3d_Drawer.hxx>
+#include <StdPrs_ToolTriangulatedShape.hxx>
 #include <TopoDS_Shape.hxx>
 #include <WNT_Window.hxx>
 #ifndef _WIN32
@@ -22,6 +25,7 @@
 #include <gp_Pnt.hxx>
 #include <BRepBndLib.hxx>
 #include <Bnd_Box.hxx>
+#include <map>
 
 AssemblyViewer::AssemblyViewer(QWidget *parent) : QWidget(parent) {
     setAttribute(Qt::WA_NoSystemBackground);
@@ -93,6 +97,10 @@ void AssemblyViewer::displayAssembly() {
     m_context->RemoveAll(false);
     m_cachedShapes.clear();
     auto frames = m_document->computeWorldFrames();
+    // New bases are meshed in one batch per deflection before anything is displayed, so
+    // instances connected to a base show its mesh.
+    std::map<std::pair<double, double>, std::vector<Handle(AIS_Shape)>> toMesh;
+    std::vector<Handle(AIS_InteractiveObject)> displayed;
     for (const auto &pair : m_document->nodes()) {
         const AssemblyNode &node = pair.second;
         if (node.shape.IsNull()) continue;
@@ -127,10 +135,30 @@ void AssemblyViewer::displayAssembly() {
         Handle(AIS_Shape) lodShape = Handle(AIS_Shape)::DownCast(toDisplay);
         if (!lodShape.IsNull()) {
             const double deflection = dist > 2500.0 ? 0.5 : 0.1;
-            lodShape->Attributes()->SetDeviationCoefficient(deflection);
+            const Handle(Prs3d_Drawer) &drawer = lodShape->Attributes();
+            drawer->SetDeviationCoefficient(deflection);
+            toMesh[{StdPrs_ToolTriangulatedShape::GetDeflection(node.shape, drawer), drawer->DeviationAngle()}].push_back(lodShape);
         }
 
-        m_context->Display(toDisplay, Standard_False);
+        displayed.push_back(toDisplay);
+    }
+
+    // Reopening the assembly reads these meshes from the disk cache.
+    for (const auto &group : toMesh) {
+        std::vector<TopoDS_Shape> shapes;
+        for (const auto &base : group.second) {
+            shapes.push_back(base->Shape());
+        }
+        const std::vector<TopoDS_Shape> meshed =
+            TessellationService::instance().tessellateAll(shapes, {group.first.first, group.first.second, false});
+        for (std::size_t i = 0; i < meshed.size(); ++i) {
+            if (meshed[i].IsNull()) continue;
+            group.second[i]->Set(meshed[i]);
+            group.second[i]->Attributes()->SetAutoTriangulation(Standard_False);
+        }
+    }
+    for (const auto &object : displayed) {
+        m_context->Display(object, Standard_False);
     }
     m_view->FitAll();
     update();
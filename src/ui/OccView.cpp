@@ -1,6 +1,8 @@
 #include "OccView.h"
 
 #include "AnalysisLegendOverlay.h"
+#include "../cad/PartRegistry.h"
+#include "../cad/TessellationService.h"
 
 #include <AIS_ColoredShape.hxx>
 #include <AIS_ConnectedInteractive.hxx>
@@ -25,7 +27,9 @@
 #include <Graphic3d_ClipPlane.hxx>
 #include <Graphic3d_GraphicDriver.hxx>
 #include <OpenGl_GraphicDriver.hxx>
+#include <Prs3d_Drawer.hxx>
 #include <Quantity_Color.hxx>
+#include <StdPrs_ToolTriangulatedShape.hxx>
 #include <TopoDS_Shape.hxx>
 #include <TopExp_Explorer.hxx>
 #include <TopAbs.hxx>
@@ -43,12 +47,22 @@
 #include <TColgp_Array1OfPnt.hxx>
 
 #include <QElapsedTimer>
+#include <QFutureWatcher>
 #include <QMouseEvent>
 #include <QResizeEvent>
 #include <QTimer>
 #include <QWheelEvent>
+#include <QtConcurrent>
 #include <algorithm>
 
+namespace {
+// The presentation that owns the mesh: the object itself, or what an instance is connected to.
+const AIS_InteractiveObject *baseOf(const Handle(AIS_InteractiveObject) &object) {
+    const Handle(AIS_ConnectedInteractive) instance = Handle(AIS_ConnectedInteractive)::DownCast(object);
+    return instance.IsNull() ? object.get() : instance->ConnectedTo().get();
+}
+}
+
 OccView::OccView(QWidget *parent) : QWidget(parent) {
     setAttribute(Qt::WA_NoSystemBackground);
     setAttribute(Qt::WA_PaintOnScreen);
@@ -90,8 +104,10 @@ void OccView::initializeViewer() {
 
 void OccView::displayShape(const TopoDS_Shape &shape) {
     if (!m_initialized) return;
+    m_partsGeneration = 0;
     m_parts.clear();
     m_cachedParts.clear();
+    m_awaitingMesh.clear();
     m_context->RemoveAll(false);
     Handle(AIS_Shape) aisShape = new AIS_Shape(shape);
     m_parts.emplace("active", aisShape);
@@ -103,6 +119,47 @@ void OccView::displayShape(const TopoDS_Shape &shape) {
 
 void OccView::displayPart(const QString &id, const TopoDS_Shape &shape, const Quantity_Color &color) {
     if (!m_initialized) return;
+    showPart(id, shape, color);
+    m_view->FitAll();
+    updateFrameStats(0.0);
+    update();
+}
+
+void OccView::syncParts(const PartRegistry &registry) {
+    if (!m_initialized) return;
+    const PartRegistry::Changes changes = registry.changesSince(m_partsGeneration);
+    m_partsGeneration = changes.generation;
+    if (changes.changed.empty() && changes.removed.empty()) return;
+    for (const QString &id : changes.removed) {
+        hidePart(id);
+    }
+    for (const QString &id : changes.changed) {
+        const PartRegistry::Entry *entry = registry.find(id);
+        if (entry && entry->visible && !entry->shape.isNull()) {
+            showPart(id, entry->shape.get(), Quantity_Color(0.8, 0.8, 0.8, Quantity_TOC_RGB));
+        } else {
+            hidePart(id);
+        }
+    }
+    m_view->FitAll();
+    updateFrameStats(0.0);
+    update();
+}
+
+void OccView::hidePart(const QString &id) {
+    auto it = m_parts.find(id);
+    if (it == m_parts.end()) return;
+    auto awaiting = m_awaitingMesh.find(baseOf(it->second));
+    if (awaiting != m_awaitingMesh.end()) {
+        auto &ids = awaiting->second;
+        ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+    }
+    m_context->Remove(it->second, Standard_False);
+    m_parts.erase(it);
+}
+
+void OccView::showPart(const QString &id, const TopoDS_Shape &shape, const Quantity_Color &color) {
+    hidePart(id);
     Handle(AIS_Shape) baseShape;
     const QString cacheKey = QString::number(reinterpret_cast<std::intptr_t>(shape.TShape().get()));
     auto cached = m_cachedParts.find(cacheKey);
@@ -126,6 +183,12 @@ void OccView::displayPart(const QString &id, const TopoDS_Shape &shape, const Qu
     }
 
     m_parts[id] = displayed;
+    auto awaiting = m_awaitingMesh.find(baseShape.get());
+    if (awaiting != m_awaitingMesh.end()) {
+        // The part appears together with its base once the base's mesh is back.
+        awaiting->second.push_back(id);
+        return;
+    }
 
     // Level of detail: relax deflection for far components
     Bnd_Box bbox;
@@ -141,19 +204,56 @@ void OccView::displayPart(const QString &id, const TopoDS_Shape &shape, const Qu
     const double deflection = std::clamp(lodFactor + densityPenalty + scalePenalty, 0.1, 2.5);
     Handle(AIS_Shape) lodShape = Handle(AIS_Shape)::DownCast(displayed);
     if (!lodShape.IsNull()) {
-        lodShape->Attributes()->SetDeviationCoefficient(deflection);
+        const Handle(Prs3d_Drawer) &drawer = lodShape->Attributes();
+        drawer->SetDeviationCoefficient(deflection);
+        // Mesh through the service at the deflection the presentation resolves to, so a part
+        // seen in an earlier session comes off the disk cache and AIS does not mesh it again.
+        // Hashing, the cache and BRepMesh run on the pool; the part is displayed once its
+        // meshed copy is back.
+        const TessellationService::Parameters parameters{StdPrs_ToolTriangulatedShape::GetDeflection(shape, drawer),
+                                                         drawer->DeviationAngle(), false};
+        m_awaitingMesh[lodShape.get()].push_back(id);
+        auto *watcher = new QFutureWatcher<TopoDS_Shape>(this);
+        connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, lodShape]() {
+            watcher->deleteLater();
+            showMeshedPart(lodShape, watcher->result());
+        });
+        watcher->setFuture(QtConcurrent::run(
+            [shape, parameters]() { return TessellationService::instance().tessellate(shape, parameters); }));
+        return;
     }
 
-    m_context->Display(displayed, Standard_True);
-    m_view->FitAll();
+    m_context->Display(displayed, Standard_False);
+}
+
+void OccView::showMeshedPart(const Handle(AIS_Shape) &base, const TopoDS_Shape &meshed) {
+    auto awaiting = m_awaitingMesh.find(base.get());
+    if (awaiting == m_awaitingMesh.end()) return;  // the view was cleared meanwhile
+    const std::vector<QString> ids = std::move(awaiting->second);
+    m_awaitingMesh.erase(awaiting);
+    if (!meshed.IsNull()) {
+        base->Set(meshed);
+        base->Attributes()->SetAutoTriangulation(Standard_False);
+    }
+    for (const QString &id : ids) {
+        auto part = m_parts.find(id);
+        if (part != m_parts.end() && baseOf(part->second) == base.get()) {
+            m_context->Display(part->second, Standard_False);
+        }
+    }
+    if (m_awaitingMesh.empty()) {
+        m_view->FitAll();
+    }
     updateFrameStats(0.0);
     update();
 }
 
 void OccView::clearView() {
     if (!m_initialized) return;
+    m_partsGeneration = 0;
     m_parts.clear();
     m_cachedParts.clear();
+    m_awaitingMesh.clear();
     clearToolpathPreview();
     m_context->RemoveAll(false);
     m_view->FitAll();
@@ -170,6 +270,13 @@ void OccView::setPartVisible(const QString &id, bool visible) {
     if (!m_initialized) return;
     auto it = m_parts.find(id);
     if (it == m_parts.end()) return;
+    auto awaiting = m_awaitingMesh.find(baseOf(it->second));
+    if (awaiting != m_awaitingMesh.end()) {
+        auto &ids = awaiting->second;
+        ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+        if (visible) ids.push_back(id);
+        return;
+    }
     if (visible) {
         m_context->Display(it->second, Standard_True);
     } else {
@@ -4,6 +4,7 @@
 #include <QWidget>
 #include <AIS_InteractiveContext.hxx>
 #include <AIS_PolyLine.hxx>
+#include <AIS_Shape.hxx>
 #include <Graphic3d_ClipPlane.hxx>
 #include <Quantity_Color.hxx>
 #include <TopoDS_Edge.hxx>
@@ -11,6 +12,7 @@
 #include <TopoDS_Shape.hxx>
 #include <V3d_View.hxx>
 #include <OpenGl_GraphicDriver.hxx>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <unordered_map>
@@ -20,6 +22,7 @@
 #include <gp_Pnt.hxx>
 
 class AnalysisLegendOverlay;
+class PartRegistry;
 #include <V3d_View.hxx>
 #include <memory>
 #include <unordered_map>
@@ -32,6 +35,8 @@ public:
 
     void displayShape(const TopoDS_Shape &shape);
     void displayPart(const QString &id, const TopoDS_Shape &shape, const Quantity_Color &color = Quantity_Color(0.8, 0.8, 0.8, Quantity_TOC_RGB));
+    // Redisplays only the parts changed or removed since the previous sync.
+    void syncParts(const PartRegistry &registry);
     void setPartVisible(const QString &id, bool visible);
     void setFeatureColor(const QString &id, const Quantity_Color &color);
     void clearView();
@@ -74,6 +79,9 @@ protected:
 
 private:
     void initializeViewer();
+    void showPart(const QString &id, const TopoDS_Shape &shape, const Quantity_Color &color);
+    void showMeshedPart(const Handle(AIS_Shape) &base, const TopoDS_Shape &meshed);
+    void hidePart(const QString &id);
     void updateClipPlanes();
     Quantity_Color interpolateColor(double t) const;
     void configureCulling();
@@ -90,6 +98,9 @@ private:
     QPoint m_lastPos;
     std::unordered_map<QString, Handle(AIS_InteractiveObject)> m_parts;
     std::unordered_map<QString, Handle(AIS_Shape)> m_cachedParts;
+    // Parts waiting for their base presentation's mesh to come back from the pool.
+    std::unordered_map<const AIS_InteractiveObject *, std::vector<QString>> m_awaitingMesh;
+    std::uint64_t m_partsGeneration{0};
     AnalysisLegendOverlay *m_legend{nullptr};
     bool m_camSelectFaces{false};
     bool m_camSelectEdges{false};
@@ -1,19 +1,76 @@
 #include <QtTest/QtTest>
 #include <QDir>
 #include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
 #include <QJsonObject>
 #include <QRegularExpression>
 #include <QTemporaryDir>
+#include <QThreadPool>
 #include <QTextStream>
+#include <QtEndian>
 
+#include <BRepAdaptor_Surface.hxx>
+#include <BRepBndLib.hxx>
+#include <BRepBuilderAPI_MakeFace.hxx>
+#include <BRepCheck_Analyzer.hxx>
+#include <BRep_Builder.hxx>
 #include <BRepGProp.hxx>
+#include <BRepPrimAPI_MakeBox.hxx>
+#include <BRepPrimAPI_MakeCylinder.hxx>
+#include <BRepTools.hxx>
+#include <BRep_Tool.hxx>
+#include <Bnd_Box.hxx>
 #include <GProp_GProps.hxx>
+#include <Geom_BezierSurface.hxx>
+#include <OSD_ThreadPool.hxx>
+#include <GeomAbs_SurfaceType.hxx>
+#include <Message_ProgressIndicator.hxx>
+#include <Message_ProgressScope.hxx>
+#include <Poly_Triangulation.hxx>
+#include <Precision.hxx>
+#include <STEPCAFControl_Reader.hxx>
+#include <STEPCAFControl_Writer.hxx>
+#include <STEPControl_Writer.hxx>
+#include <TColgp_Array2OfPnt.hxx>
+#include <TDataStd_Name.hxx>
+#include <TopAbs_ShapeEnum.hxx>
+#include <TopExp.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopLoc_Location.hxx>
+#include <TopTools_IndexedDataMapOfShapeListOfShape.hxx>
+#include <TopTools_ListIteratorOfListOfShape.hxx>
+#include <TopTools_ListOfShape.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Compound.hxx>
+#include <TopoDS_Solid.hxx>
+#include <XCAFDoc_DocumentTool.hxx>
+#include <XCAFDoc_MaterialTool.hxx>
+#include <XCAFDoc_ShapeTool.hxx>
+#include <gp_Trsf.hxx>
 
+#include <algorithm>
 #include <cmath>
+#include <future>
 
+#include "app/ProjectIO.h"
+#include "assembly/AssemblyDocument.h"
+#include "cad/BatchImporter.h"
+#include "cad/DesignTable.h"
+#include "cad/EdgeIndex.h"
 #include "cad/FeatureOps.h"
 #include "cad/GltfExporter.h"
+#include "cad/LazyShape.h"
+#include "cad/PartRegistry.h"
+#include "cad/ProfileBuilder.h"
+#include "cad/ShapeArchive.h"
+#include "cad/ShapeCache.h"
+#include "cad/ShapeHealing.h"
+#include "cad/ShapeHash.h"
+#include "cad/SketchEngine.h"
 #include "cad/StepIgesIO.h"
+#include "cad/TessellationService.h"
+#include "cad/XcafDocumentPool.h"
 #include "scripting/ScriptRunner.h"
 #include "utils/JsonHelpers.h"
 #include "utils/Settings.h"
@@ -22,13 +79,52 @@ class CoreTests : public QObject {
     Q_OBJECT
 
 private slots:
+    void initTestCase();
     void jsonHelpers_roundTrip();
     void settings_roundTrip();
     void jsonHelpers_benchmark();
     void step_roundTrip();
     void iges_roundTrip();
     void gltf_export();
+    void gltf_exportsLevelsOfDetail();
     void io_failure_logging();
+    void featureTree_incrementalReplay();
+    void persistentNaming_tracksFaceThroughUpstreamEdit();
+    void featureTree_sharesToolTreeAcrossThreads();
+    void featureTree_userBreakStopsToolTrees();
+    void sketchEngine_regeneratesNewestEditOnce();
+    void featureOps_cutManyMatchesSequentialCuts();
+    void featureOps_selectiveFillet();
+    void featureTree_followsSelectedEdgeThroughUpstreamEdit();
+    void featureOps_executionPolicyResizesPools();
+    void featureOps_booleanBenchmark_data();
+    void featureOps_booleanBenchmark();
+    void shapeCache_hitsOnEqualContent();
+    void sketch_solvesConstraintsIncrementally();
+    void sketch_buildsFaceWithHolesFromUnorderedSegments();
+    void sketch_keepsLoopWithStraySegmentAtCorner();
+    void designTable_regeneratesVariants();
+    void partRegistry_loadsShapesLazily();
+    void partRegistry_tracksChangesByGeneration();
+    void shapeArchive_roundTrip_data();
+    void shapeArchive_roundTrip();
+    void projectIO_readsPartsOnDemand();
+    void batchImporter_mergesFilesIntoOneDocument();
+    void step_streamsRootsIncrementally();
+    void step_streamsAssemblyComponents();
+    void step_importsAssemblyStructure();
+    void shapeHealing_healsDistinctPiecesOnce();
+    void shapeHealing_leavesSharedInputUntouched();
+    void shapeHealing_returnsRepairedPiece();
+    void xcafDocumentPool_reusesDocuments();
+    void xcafDocumentPool_retiresGrownDocuments();
+    void step_exportsAssemblyWithSharedParts();
+    void tessellationService_reusesDiskCache();
+    void tessellationService_evictsAndPurges();
+
+private:
+    // Every test that meshes goes through the service; keep its files out of the user's cache.
+    QTemporaryDir m_tessellationCache;
 };
 
 class ScriptingTests : public QObject {
@@ -55,6 +151,18 @@ QString tempFile(const QTemporaryDir &dir, const QString &name) {
                                .arg(expected)                                                                            \
                                .arg(delta)));                                                                            \
     } while (false)
+
+// Reports a user break from the start, as a cancelled regeneration does.
+class BreakingProgress : public Message_ProgressIndicator {
+public:
+    Standard_Boolean UserBreak() override { return Standard_True; }
+    void Show(const Message_ProgressScope &, const Standard_Boolean) override {}
+};
+}
+
+void CoreTests::initTestCase() {
+    QVERIFY(m_tessellationCache.isValid());
+    TessellationService::instance().setCacheDirectory(m_tessellationCache.path());
 }
 
 void CoreTests::jsonHelpers_roundTrip() {
@@ -142,10 +250,81 @@ void CoreTests::gltf_export() {
     GltfExporter exporter;
     const TopoDS_Shape box = FeatureOps::makeBox(4.0);
     QVERIFY(exporter.exportShape(path, box));
+    // Meshes go to copies; the caller's shape is left as it was.
+    QVERIFY(!BRepTools::Triangulation(box, 1e6));
 
     QFile file(path);
     QVERIFY(file.exists());
     QVERIFY(file.size() > 0);
+
+    // A GLB of two instances of one part holds a single mesh and starts with the GLB magic.
+    const TopoDS_Shape part = FeatureOps::makeCylinder(2.0, 5.0);
+    gp_Trsf shift;
+    shift.SetTranslation(gp_Vec(10.0, 0.0, 0.0));
+    BRep_Builder builder;
+    TopoDS_Compound pair;
+    builder.MakeCompound(pair);
+    builder.Add(pair, part);
+    builder.Add(pair, part.Moved(TopLoc_Location(shift)));
+    GltfExporter::Options options;
+    options.linearDeflection = 0.05;
+    const QString glbPath = tempFile(dir, QStringLiteral("pair.glb"));
+    QVERIFY(GltfExporter(options).exportShape(glbPath, pair));
+    QFile glb(glbPath);
+    QVERIFY(glb.open(QIODevice::ReadOnly));
+    const QByteArray bytes = glb.readAll();
+    QVERIFY(bytes.startsWith("glTF"));
+    const quint32 jsonLength = qFromLittleEndian<quint32>(bytes.constData() + 12);
+    const QJsonObject json = QJsonDocument::fromJson(bytes.mid(20, static_cast<int>(jsonLength))).object();
+    QCOMPARE(json.value("meshes").toArray().size(), 1);
+    int instances = 0;
+    for (const auto &node : json.value("nodes").toArray()) {
+        instances += node.toObject().contains("mesh") ? 1 : 0;
+    }
+    QCOMPARE(instances, 2);
+
+    // A finer mesh already on the part does not leak into a coarser export.
+    const TopoDS_Shape fine = FeatureOps::mesh(part, 0.005);
+    TopoDS_Compound finePair;
+    builder.MakeCompound(finePair);
+    builder.Add(finePair, fine);
+    builder.Add(finePair, fine.Moved(TopLoc_Location(shift)));
+    const QString finePath = tempFile(dir, QStringLiteral("fine.glb"));
+    QVERIFY(GltfExporter(options).exportShape(finePath, finePair));
+    QCOMPARE(QFileInfo(finePath).size(), QFileInfo(glbPath).size());
+    QVERIFY(BRepTools::Triangulation(fine, 0.005));
+}
+
+void CoreTests::gltf_exportsLevelsOfDetail() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const TopoDS_Shape shape = FeatureOps::makeCylinder(20.0, 10.0);
+    const QString manifestPath = GltfExporter().exportLods(tempFile(dir, QStringLiteral("wheel.glb")), shape);
+    QCOMPARE(manifestPath, tempFile(dir, QStringLiteral("wheel.lod.json")));
+
+    QFile manifestFile(manifestPath);
+    QVERIFY(manifestFile.open(QIODevice::ReadOnly));
+    const QJsonArray levels = QJsonDocument::fromJson(manifestFile.readAll()).object().value("levels").toArray();
+    QCOMPARE(levels.size(), 3);
+    for (int i = 0; i < levels.size(); ++i) {
+        const QJsonObject level = levels[i].toObject();
+        QCOMPARE(level.value("level").toInt(), i);
+        QVERIFY(QFile::exists(tempFile(dir, level.value("file").toString())));
+        QVERIFY(level.value("screenSpaceError").toDouble() > 0.0);
+        if (i > 0) {
+            const QJsonObject finer = levels[i - 1].toObject();
+            QVERIFY(level.value("geometricError").toDouble() > finer.value("geometricError").toDouble());
+            QVERIFY(level.value("triangles").toInt() <= finer.value("triangles").toInt());
+        }
+    }
+    QVERIFY(levels.first().toObject().value("triangles").toInt() > levels.last().toObject().value("triangles").toInt());
+
+    // A mesh the caller already had survives the export.
+    const TopoDS_Shape meshed = FeatureOps::mesh(shape, 0.5);
+    QVERIFY(!GltfExporter().exportLods(tempFile(dir, QStringLiteral("meshed.glb")), meshed).isEmpty());
+    QVERIFY(BRepTools::Triangulation(meshed, 0.5));
+    QVERIFY(!BRepTools::Triangulation(shape, 1e6));
 }
 
 void CoreTests::io_failure_logging() {
@@ -160,6 +339,1303 @@ void CoreTests::io_failure_logging() {
     QVERIFY(!exporter.exportShape(gltfPath, TopoDS_Shape()));
 }
 
+void CoreTests::featureTree_incrementalReplay() {
+    Sketch2D sketch;
+    sketch.addLine(gp_Pnt2d(0, 0), gp_Pnt2d(20, 0));
+    sketch.addLine(gp_Pnt2d(20, 0), gp_Pnt2d(20, 20));
+    sketch.addLine(gp_Pnt2d(20, 20), gp_Pnt2d(0, 20));
+    sketch.addLine(gp_Pnt2d(0, 20), gp_Pnt2d(0, 0));
+
+    FeatureTree tree;
+    tree.setProfile(sketch.toFace());
+    FeatureTree::Node extrude{FeatureTree::NodeType::Extrude, 10.0, gp_Ax1(), gp_Dir(0, 0, 1), TopoDS_Shape()};
+    FeatureTree::Node pocket{FeatureTree::NodeType::Cut, 0.0, gp_Ax1(), gp_Dir(0, 0, 1), FeatureOps::makeBox(5.0)};
+    FeatureTree::Node hole{FeatureTree::NodeType::Cut, 0.0, gp_Ax1(), gp_Dir(0, 0, 1), FeatureOps::makeCylinder(2.0, 30.0)};
+    tree.push(extrude);
+    tree.push(pocket);
+    tree.push(hole);
+
+    const TopoDS_Shape first = tree.replay();
+    QVERIFY(!first.IsNull());
+    QCOMPARE(tree.lastRecomputedCount(), std::size_t{3});
+
+    const TopoDS_Shape again = tree.replay();
+    QCOMPARE(tree.lastRecomputedCount(), std::size_t{0});
+    QVERIFY(again.IsSame(first));
+
+    // The two consecutive cuts run as one batched boolean, so editing the second redoes the batch.
+    hole.tool = FeatureOps::makeCylinder(3.0, 30.0);
+    tree.update(2, hole);
+    QVERIFY(!tree.replay().IsNull());
+    QCOMPARE(tree.lastRecomputedCount(), std::size_t{2});
+}
+
+void CoreTests::persistentNaming_tracksFaceThroughUpstreamEdit() {
+    Sketch2D sketch;
+    sketch.addLine(gp_Pnt2d(0, 0), gp_Pnt2d(20, 0));
+    sketch.addLine(gp_Pnt2d(20, 0), gp_Pnt2d(20, 20));
+    sketch.addLine(gp_Pnt2d(20, 20), gp_Pnt2d(0, 20));
+    sketch.addLine(gp_Pnt2d(0, 20), gp_Pnt2d(0, 0));
+    const TopoDS_Shape profile = sketch.toFace();
+
+    const auto boundsOf = [](const TopoDS_Shape &shape) {
+        Bnd_Box box;
+        BRepBndLib::Add(shape, box, false);
+        return box;
+    };
+    TopoDS_Shape front;
+    for (TopExp_Explorer it(profile, TopAbs_EDGE); it.More(); it.Next()) {
+        const Bnd_Box box = boundsOf(it.Current());
+        if (std::abs(box.CornerMax().Y()) < 1e-6) front = it.Current();
+    }
+    QVERIFY(!front.IsNull());
+
+    FeatureTree tree;
+    tree.setProfile(profile);
+    FeatureTree::Node extrude{FeatureTree::NodeType::Extrude, 10.0, gp_Ax1(), gp_Dir(0, 0, 1), TopoDS_Shape()};
+    // A notch through the front face, so the face is modified rather than carried over as is.
+    FeatureTree::Node notch{FeatureTree::NodeType::Cut, 0.0, gp_Ax1(), gp_Dir(0, 0, 1),
+                            BRepPrimAPI_MakeBox(gp_Pnt(8.0, -5.0, 4.0), 4.0, 10.0, 4.0).Shape()};
+    tree.push(extrude);
+    tree.push(notch);
+
+    // The face swept from the front edge, as it ends up in `result`.
+    const auto trackedFace = [&tree, &front](const TopoDS_Shape &result) {
+        std::vector<TopoDS_Face> faces;
+        const TopTools_ListOfShape tracked = tree.naming().track(front);
+        for (TopTools_ListIteratorOfListOfShape item(tracked); item.More(); item.Next()) {
+            const TopoDS_Shape &shape = item.Value();
+            if (shape.ShapeType() != TopAbs_FACE) continue;
+            for (TopExp_Explorer it(result, TopAbs_FACE); it.More(); it.Next()) {
+                if (it.Current().IsSame(shape)) {
+                    faces.push_back(TopoDS::Face(shape));
+                    break;
+                }
+            }
+        }
+        return faces;
+    };
+    const auto wireCount = [](const TopoDS_Face &face) {
+        int wires = 0;
+        for (TopExp_Explorer it(face, TopAbs_WIRE); it.More(); it.Next()) {
+            ++wires;
+        }
+        return wires;
+    };
+
+    const TopoDS_Shape first = tree.replay();
+    QVERIFY(!first.IsNull());
+    std::vector<TopoDS_Face> faces = trackedFace(first);
+    QCOMPARE(faces.size(), std::size_t{1});
+    VERIFY_WITH_TOLERANCE(boundsOf(faces.front()).CornerMax().Y(), 0.0, 1e-6);
+    VERIFY_WITH_TOLERANCE(boundsOf(faces.front()).CornerMax().Z(), 10.0, 1e-6);
+    QCOMPARE(wireCount(faces.front()), 2);
+
+    // Editing the extrusion rebuilds both nodes; the same edge now leads to the taller face.
+    extrude.value = 25.0;
+    tree.update(0, extrude);
+    const TopoDS_Shape second = tree.replay();
+    QVERIFY(!second.IsNull());
+    QCOMPARE(tree.lastRecomputedCount(), std::size_t{2});
+    faces = trackedFace(second);
+    QCOMPARE(faces.size(), std::size_t{1});
+    VERIFY_WITH_TOLERANCE(boundsOf(faces.front()).CornerMax().Y(), 0.0, 1e-6);
+    VERIFY_WITH_TOLERANCE(boundsOf(faces.front()).CornerMax().Z(), 25.0, 1e-6);
+    QCOMPARE(wireCount(faces.front()), 2);
+}
+
+void CoreTests::featureTree_sharesToolTreeAcrossThreads() {
+    Sketch2D toolSketch;
+    toolSketch.addLine(gp_Pnt2d(8, 8), gp_Pnt2d(12, 8));
+    toolSketch.addLine(gp_Pnt2d(12, 8), gp_Pnt2d(12, 12));
+    toolSketch.addLine(gp_Pnt2d(12, 12), gp_Pnt2d(8, 12));
+    toolSketch.addLine(gp_Pnt2d(8, 12), gp_Pnt2d(8, 8));
+    auto toolTree = std::make_shared<FeatureTree>();
+    toolTree->setProfile(toolSketch.toFace());
+    toolTree->push({FeatureTree::NodeType::Extrude, 30.0, gp_Ax1(), gp_Dir(0, 0, 1), TopoDS_Shape()});
+
+    Sketch2D sketch;
+    sketch.addLine(gp_Pnt2d(0, 0), gp_Pnt2d(20, 0));
+    sketch.addLine(gp_Pnt2d(20, 0), gp_Pnt2d(20, 20));
+    sketch.addLine(gp_Pnt2d(20, 20), gp_Pnt2d(0, 20));
+    sketch.addLine(gp_Pnt2d(0, 20), gp_Pnt2d(0, 0));
+    FeatureTree::Node cut{FeatureTree::NodeType::Cut, 0.0, gp_Ax1(), gp_Dir(0, 0, 1), TopoDS_Shape()};
+    cut.toolTree = toolTree;
+
+    // Two trees consume the same tool sub-feature and replay at the same time.
+    FeatureTree trees[2];
+    for (FeatureTree &tree : trees) {
+        tree.setProfile(sketch.toFace());
+        tree.push({FeatureTree::NodeType::Extrude, 10.0, gp_Ax1(), gp_Dir(0, 0, 1), TopoDS_Shape()});
+        tree.push(cut);
+    }
+    std::future<TopoDS_Shape> first = std::async(std::launch::async, [&trees]() { return trees[0].replay(); });
+    std::future<TopoDS_Shape> second = std::async(std::launch::async, [&trees]() { return trees[1].replay(); });
+
+    for (const TopoDS_Shape &result : {first.get(), second.get()}) {
+        QVERIFY(!result.IsNull());
+        QVERIFY(BRepCheck_Analyzer(result).IsValid());
+        GProp_GProps props;
+        BRepGProp::VolumeProperties(result, props);
+        VERIFY_WITH_TOLERANCE(props.Mass(), 20.0 * 20.0 * 10.0 - 4.0 * 4.0 * 10.0, 1e-6);
+    }
+    QVERIFY(!toolTree->replay().IsNull());
+    QCOMPARE(toolTree->lastRecomputedCount(), std::size_t{0});
+}
+
+void CoreTests::featureTree_userBreakStopsToolTrees() {
+    Sketch2D toolSketch;
+    toolSketch.addLine(gp_Pnt2d(8, 8), gp_Pnt2d(12, 8));
+    toolSketch.addLine(gp_Pnt2d(12, 8), gp_Pnt2d(12, 12));
+    toolSketch.addLine(gp_Pnt2d(12, 12), gp_Pnt2d(8, 12));
+    toolSketch.addLine(gp_Pnt2d(8, 12), gp_Pnt2d(8, 8));
+    auto toolTree = std::make_shared<FeatureTree>();
+    toolTree->setProfile(toolSketch.toFace());
+    toolTree->push({FeatureTree::NodeType::Extrude, 30.0, gp_Ax1(), gp_Dir(0, 0, 1), TopoDS_Shape()});
+
+    FeatureTree tree;
+    tree.setProfile(FeatureOps::makeBox(20.0));
+    FeatureTree::Node cut{FeatureTree::NodeType::Cut, 0.0, gp_Ax1(), gp_Dir(0, 0, 1), TopoDS_Shape()};
+    cut.toolTree = toolTree;
+    tree.push(cut);
+
+    Handle(BreakingProgress) indicator = new BreakingProgress();
+    QVERIFY(tree.replay(indicator->Start()).IsNull());
+    QCOMPARE(tree.lastRecomputedCount(), std::size_t{0});
+    // The tool sub-feature ran under the same range and stopped before building anything.
+    QCOMPARE(toolTree->lastRecomputedCount(), std::size_t{0});
+    QVERIFY(!tree.replay().IsNull());
+    QCOMPARE(toolTree->lastRecomputedCount(), std::size_t{1});
+}
+
+void CoreTests::sketchEngine_regeneratesNewestEditOnce() {
+    SketchEngine engine;
+    engine.sketch().addLine(gp_Pnt2d(0, 0), gp_Pnt2d(20, 0));
+    engine.sketch().addLine(gp_Pnt2d(20, 0), gp_Pnt2d(20, 20));
+    engine.sketch().addLine(gp_Pnt2d(20, 20), gp_Pnt2d(0, 20));
+    engine.sketch().addLine(gp_Pnt2d(0, 20), gp_Pnt2d(0, 0));
+    FeatureTree::Node extrude{FeatureTree::NodeType::Extrude, 10.0, gp_Ax1(), gp_Dir(0, 0, 1), TopoDS_Shape()};
+    engine.history().push(extrude);
+    engine.history().push({FeatureTree::NodeType::Fillet, 1.0, gp_Ax1(), gp_Dir(0, 0, 1), TopoDS_Shape()});
+
+    QSignalSpy regenerated(&engine, &SketchEngine::regenerated);
+    QSignalSpy progress(&engine, &SketchEngine::regenerationProgress);
+
+    const QFuture<TopoDS_Shape> stale = engine.regenerateAsync();
+    extrude.value = 25.0;
+    engine.history().update(0, extrude);
+    const QFuture<TopoDS_Shape> newest = engine.regenerateAsync();
+    QVERIFY(stale.isCanceled());
+    QVERIFY(!newest.isCanceled());
+
+    QTRY_COMPARE(regenerated.count(), 1);
+    const TopoDS_Shape shape = qvariant_cast<TopoDS_Shape>(regenerated.first().first());
+    QVERIFY(!shape.IsNull());
+    Bnd_Box box;
+    BRepBndLib::Add(shape, box, false);
+    VERIFY_WITH_TOLERANCE(box.CornerMax().Z(), 25.0, 1e-6);
+    QVERIFY(progress.count() > 0);
+
+    // The cancelled job finishes in the background without a second emission.
+    QTest::qWait(200);
+    QCOMPARE(regenerated.count(), 1);
+    QVERIFY(!engine.isRegenerating());
+}
+
+void CoreTests::featureOps_cutManyMatchesSequentialCuts() {
+    const TopoDS_Shape plate = FeatureOps::makeBox(40.0);
+    std::vector<TopoDS_Shape> holes;
+    TopoDS_Shape sequential = plate;
+    for (int i = 0; i < 4; ++i) {
+        gp_Trsf offset;
+        offset.SetTranslation(gp_Vec(8.0 + 8.0 * i, 20.0, -1.0));
+        const TopoDS_Shape hole = FeatureOps::makeCylinder(2.0, 42.0).Moved(TopLoc_Location(offset));
+        holes.push_back(hole);
+        sequential = FeatureOps::cut(sequential, hole);
+    }
+
+    const TopoDS_Shape batched = FeatureOps::cutMany(plate, holes);
+    QVERIFY(!batched.IsNull());
+
+    GProp_GProps propsSequential;
+    BRepGProp::VolumeProperties(sequential, propsSequential);
+    GProp_GProps propsBatched;
+    BRepGProp::VolumeProperties(batched, propsBatched);
+    VERIFY_WITH_TOLERANCE(propsBatched.Mass(), propsSequential.Mass(), 1e-6);
+}
+
+void CoreTests::featureOps_selectiveFillet() {
+    const TopoDS_Shape box = FeatureOps::makeBox(10.0);
+    const auto index = EdgeIndex::forShape(box);
+    QCOMPARE(index->edgeCount(), 12);
+    QVERIFY(EdgeIndex::forShape(box) == index);
+
+    const double radius = 1.0;
+    const TopoDS_Shape rounded = FeatureOps::fillet(box, {{0, radius}});
+    QVERIFY(!rounded.IsNull());
+
+    // One straight 10 mm edge loses a (1 - pi/4) r^2 strip along its length.
+    GProp_GProps props;
+    BRepGProp::VolumeProperties(rounded, props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), 1000.0 - 10.0 * radius * radius * (1.0 - M_PI / 4.0), 1e-3);
+}
+
+void CoreTests::featureTree_followsSelectedEdgeThroughUpstreamEdit() {
+    Sketch2D sketch;
+    sketch.addLine(gp_Pnt2d(0, 0), gp_Pnt2d(20, 0));
+    sketch.addLine(gp_Pnt2d(20, 0), gp_Pnt2d(20, 20));
+    sketch.addLine(gp_Pnt2d(20, 20), gp_Pnt2d(0, 20));
+    sketch.addLine(gp_Pnt2d(0, 20), gp_Pnt2d(0, 0));
+
+    FeatureTree tree;
+    tree.setProfile(sketch.toFace());
+    tree.push({FeatureTree::NodeType::Extrude, 10.0, gp_Ax1(), gp_Dir(0, 0, 1), TopoDS_Shape()});
+    // Starts out clear of the part, then becomes a corner notch that renumbers the edges.
+    FeatureTree::Node notch{FeatureTree::NodeType::Cut, 0.0, gp_Ax1(), gp_Dir(0, 0, 1),
+                            BRepPrimAPI_MakeBox(gp_Pnt(50.0, 50.0, -1.0), 10.0, 10.0, 12.0).Shape()};
+    tree.push(notch);
+    const TopoDS_Shape input = tree.replay();
+    QVERIFY(!input.IsNull());
+
+    // Select the front top edge (y = 0, z = 10) on the current input.
+    const auto index = EdgeIndex::forShape(input);
+    int frontTop = -1;
+    for (int e = 0; e < index->edgeCount(); ++e) {
+        Bnd_Box box;
+        BRepBndLib::Add(index->edge(e), box, false);
+        if (std::abs(box.CornerMax().Y()) < 1e-6 && std::abs(box.CornerMin().Z() - 10.0) < 1e-6) frontTop = e;
+    }
+    QVERIFY(frontTop >= 0);
+    FeatureTree::Node round{FeatureTree::NodeType::Fillet, 0.0, gp_Ax1(), gp_Dir(0, 0, 1), TopoDS_Shape()};
+    round.edges = {{frontTop, 1.0}};
+    tree.push(round);
+
+    const auto roundedFaces = [](const TopoDS_Shape &shape) {
+        std::vector<Bnd_Box> faces;
+        for (TopExp_Explorer it(shape, TopAbs_FACE); it.More(); it.Next()) {
+            if (BRepAdaptor_Surface(TopoDS::Face(it.Current())).GetType() != GeomAbs_Cylinder) continue;
+            Bnd_Box box;
+            BRepBndLib::Add(it.Current(), box, false);
+            faces.push_back(box);
+        }
+        return faces;
+    };
+    const auto checkFrontTop = [](const std::vector<Bnd_Box> &faces) {
+        QCOMPARE(faces.size(), std::size_t{1});
+        VERIFY_WITH_TOLERANCE(faces.front().CornerMin().Y(), 0.0, 1e-3);
+        VERIFY_WITH_TOLERANCE(faces.front().CornerMax().Z(), 10.0, 1e-3);
+        VERIFY_WITH_TOLERANCE(faces.front().CornerMin().X(), 0.0, 1e-3);
+        VERIFY_WITH_TOLERANCE(faces.front().CornerMax().X(), 20.0, 1e-3);
+    };
+
+    const TopoDS_Shape first = tree.replay();
+    QVERIFY(!first.IsNull());
+    checkFrontTop(roundedFaces(first));
+    if (QTest::currentTestFailed()) return;
+
+    notch.tool = BRepPrimAPI_MakeBox(gp_Pnt(15.0, 15.0, -1.0), 10.0, 10.0, 12.0).Shape();
+    tree.update(1, notch);
+    const TopoDS_Shape second = tree.replay();
+    QVERIFY(!second.IsNull());
+    QCOMPARE(tree.lastRecomputedCount(), std::size_t{2});
+    checkFrontTop(roundedFaces(second));
+}
+
+void CoreTests::featureOps_executionPolicyResizesPools() {
+    const FeatureOps::ExecutionPolicy previous = FeatureOps::executionPolicy();
+    FeatureOps::ExecutionPolicy policy = previous;
+    policy.threads = 2;
+    FeatureOps::setExecutionPolicy(policy);
+    QCOMPARE(QThreadPool::globalInstance()->maxThreadCount(), 2);
+    QCOMPARE(OSD_ThreadPool::DefaultPool()->NbThreads(), 2);
+
+    // Back to automatic sizing: the Qt pool returns to one thread per core.
+    policy.threads = 0;
+    FeatureOps::setExecutionPolicy(policy);
+    QCOMPARE(QThreadPool::globalInstance()->maxThreadCount(), QThread::idealThreadCount());
+    FeatureOps::setExecutionPolicy(previous);
+}
+
+void CoreTests::featureOps_booleanBenchmark_data() {
+    QTest::addColumn<bool>("parallel");
+    QTest::newRow("serial") << false;
+    QTest::newRow("parallel") << true;
+}
+
+void CoreTests::featureOps_booleanBenchmark() {
+    QFETCH(bool, parallel);
+    const FeatureOps::ExecutionPolicy previous = FeatureOps::executionPolicy();
+    FeatureOps::ExecutionPolicy policy = previous;
+    policy.parallelBooleans = parallel;
+    policy.parallelMeshing = parallel;
+    FeatureOps::setExecutionPolicy(policy);
+    ShapeCache::instance().setEnabled(false);
+
+    const TopoDS_Shape plate = FeatureOps::makeBox(80.0);
+    std::vector<TopoDS_Shape> holes;
+    for (int row = 0; row < 8; ++row) {
+        for (int col = 0; col < 8; ++col) {
+            gp_Trsf offset;
+            offset.SetTranslation(gp_Vec(5.0 + 10.0 * col, 5.0 + 10.0 * row, -1.0));
+            holes.push_back(FeatureOps::makeCylinder(2.0, 82.0).Moved(TopLoc_Location(offset)));
+        }
+    }
+
+    TopoDS_Shape result;
+    QBENCHMARK {
+        result = FeatureOps::cutMany(plate, holes);
+        QVERIFY(!FeatureOps::mesh(result, 0.5).IsNull());
+    }
+    FeatureOps::setExecutionPolicy(previous);
+    ShapeCache::instance().setEnabled(true);
+    QVERIFY(!result.IsNull());
+}
+
+void CoreTests::shapeCache_hitsOnEqualContent() {
+    auto &cache = ShapeCache::instance();
+    cache.clear();
+
+    const TopoDS_Shape first = BRepPrimAPI_MakeBox(20.0, 20.0, 20.0).Shape();
+    const TopoDS_Shape second = BRepPrimAPI_MakeBox(20.0, 20.0, 20.0).Shape();
+    QVERIFY(ShapeHash::identity(first) != ShapeHash::identity(second));
+    QCOMPARE(ShapeHash::contentHash(first), ShapeHash::contentHash(second));
+    QVERIFY(ShapeHash::contentHash(first) != ShapeHash::contentHash(FeatureOps::makeBox(21.0)));
+
+    const TopoDS_Shape tool = FeatureOps::makeCylinder(4.0, 30.0);
+    const TopoDS_Shape computed = FeatureOps::cut(first, tool);
+    const auto afterMiss = cache.stats();
+    const TopoDS_Shape reused = FeatureOps::cut(second, tool);
+    const auto afterHit = cache.stats();
+    QVERIFY(reused.IsSame(computed));
+    QCOMPARE(afterHit.hits, afterMiss.hits + 1);
+    QCOMPARE(afterHit.misses, afterMiss.misses);
+
+    // Meshing works on a copy, so the shared result stays untouched for its other holders.
+    const TopoDS_Shape meshed = FeatureOps::mesh(reused, 0.5);
+    QVERIFY(!meshed.IsNull());
+    QVERIFY(BRepTools::Triangulation(meshed, 0.5));
+    QVERIFY(!BRepTools::Triangulation(computed, 0.5));
+
+    // Two patches with the same corners, edge midpoints and centre share a fingerprint, but
+    // the bulge of the second changes its bounds and area, so it must not reuse the first.
+    const auto bezierFace = [](double bulge) {
+        TColgp_Array2OfPnt poles(1, 4, 1, 4);
+        for (int i = 1; i <= 4; ++i) {
+            for (int j = 1; j <= 4; ++j) {
+                poles(i, j) = gp_Pnt(10.0 * (i - 1), 10.0 * (j - 1), 0.0);
+            }
+        }
+        poles(2, 2).SetZ(bulge);
+        poles(2, 3).SetZ(-bulge);
+        return BRepBuilderAPI_MakeFace(new Geom_BezierSurface(poles), Precision::Confusion()).Shape();
+    };
+    const TopoDS_Shape flat = bezierFace(0.0);
+    const TopoDS_Shape bent = bezierFace(5.0);
+    QCOMPARE(ShapeHash::fingerprint(flat), ShapeHash::fingerprint(bent));
+    int computedFaces = 0;
+    const auto probe = [&cache, &computedFaces](const TopoDS_Shape &face) {
+        return cache.getOrCompute(ShapeCache::Key("probe").shape(face), [&face, &computedFaces] {
+            ++computedFaces;
+            return face;
+        });
+    };
+    QVERIFY(probe(flat).IsSame(flat));
+    QVERIFY(probe(bent).IsSame(bent));
+    QVERIFY(probe(bezierFace(5.0)).IsSame(bent));
+    QCOMPARE(computedFaces, 2);
+
+    cache.setCapacity(1);
+    QCOMPARE(cache.stats().entries, std::size_t{0});
+    QVERIFY(cache.stats().evictions > 0);
+    cache.setCapacity(std::size_t{256} * 1024 * 1024);
+    cache.clear();
+}
+
+void CoreTests::sketch_solvesConstraintsIncrementally() {
+    Sketch2D sketch;
+    const QString bottom = sketch.addLine(gp_Pnt2d(0.0, 0.0), gp_Pnt2d(10.3, 0.2));
+    const QString right = sketch.addLine(gp_Pnt2d(10.0, 0.1), gp_Pnt2d(10.2, 5.1));
+    const QString top = sketch.addLine(gp_Pnt2d(10.0, 5.0), gp_Pnt2d(-0.1, 5.2));
+    const QString left = sketch.addLine(gp_Pnt2d(0.1, 5.0), gp_Pnt2d(0.0, 0.3));
+    const QString hole = sketch.addCircle(gp_Pnt2d(30.0, 30.0), 2.0);
+    const QString loop[] = {bottom, right, top, left};
+    for (int i = 0; i < 4; ++i) {
+        sketch.addConstraint({SketchConstraint::Type::Coincident, loop[i], loop[(i + 1) % 4], 0.0});
+    }
+    sketch.addConstraint({SketchConstraint::Type::Perpendicular, bottom, right, 0.0});
+    sketch.addConstraint({SketchConstraint::Type::Parallel, bottom, top, 0.0});
+    sketch.addConstraint({SketchConstraint::Type::Parallel, right, left, 0.0});
+    sketch.addDimension({QStringLiteral("width"), bottom, 10.0});
+    sketch.addDimension({QStringLiteral("height"), right, 5.0});
+    sketch.addDimension({QStringLiteral("bore"), hole, 3.0});
+
+    const auto full = sketch.solve();
+    QVERIFY(full.converged);
+    QCOMPARE(full.clustersSolved, std::size_t{2});
+
+    const auto lengthOf = [&sketch](const QString &id) {
+        const SketchPrimitive prim = sketch.primitive(id);
+        return prim.start.Distance(prim.end);
+    };
+    VERIFY_WITH_TOLERANCE(lengthOf(bottom), 10.0, 1e-6);
+    VERIFY_WITH_TOLERANCE(lengthOf(top), 10.0, 1e-6);
+    VERIFY_WITH_TOLERANCE(lengthOf(left), 5.0, 1e-6);
+
+    sketch.updateDimension(QStringLiteral("width"), 20.0);
+    QVERIFY(sketch.lastSolve().converged);
+    QCOMPARE(sketch.lastSolve().clustersSolved, std::size_t{1});
+    VERIFY_WITH_TOLERANCE(lengthOf(top), 20.0, 1e-6);
+    VERIFY_WITH_TOLERANCE(sketch.primitive(hole).radius, 3.0, 1e-9);
+
+    // Handles to surviving primitives stay valid across removal; the removed one goes stale.
+    const SlotHandle stale = sketch.handleOf(left);
+    QVERIFY(sketch.removePrimitive(left));
+    QVERIFY(!sketch.geometry().handles.contains(stale));
+    QVERIFY(sketch.geometry().handles.contains(sketch.handleOf(hole)));
+    QCOMPARE(sketch.primitiveCount(), std::size_t{4});
+    VERIFY_WITH_TOLERANCE(sketch.primitive(hole).radius, 3.0, 1e-9);
+}
+
+void CoreTests::sketch_buildsFaceWithHolesFromUnorderedSegments() {
+    Sketch2D sketch;
+    // Outer 20 x 20 square, shuffled and with one segment reversed.
+    sketch.addLine(gp_Pnt2d(20.0, 20.0), gp_Pnt2d(0.0, 20.0));
+    sketch.addLine(gp_Pnt2d(0.0, 0.0), gp_Pnt2d(20.0, 0.0));
+    sketch.addLine(gp_Pnt2d(0.0, 0.0), gp_Pnt2d(0.0, 20.0));
+    sketch.addLine(gp_Pnt2d(20.0, 0.0), gp_Pnt2d(20.0, 20.0 + 1e-8));
+    // Square hole, also out of order.
+    sketch.addLine(gp_Pnt2d(8.0, 8.0), gp_Pnt2d(3.0, 8.0));
+    sketch.addLine(gp_Pnt2d(3.0, 3.0), gp_Pnt2d(8.0, 3.0));
+    sketch.addLine(gp_Pnt2d(3.0, 8.0), gp_Pnt2d(3.0, 3.0));
+    sketch.addLine(gp_Pnt2d(8.0, 3.0), gp_Pnt2d(8.0, 8.0));
+    sketch.addCircle(gp_Pnt2d(14.0, 14.0), 2.0);
+    // A separate island outside the plate.
+    sketch.addLine(gp_Pnt2d(30.0, 0.0), gp_Pnt2d(32.0, 0.0));
+    sketch.addLine(gp_Pnt2d(32.0, 0.0), gp_Pnt2d(31.0, 2.0));
+    sketch.addLine(gp_Pnt2d(31.0, 2.0), gp_Pnt2d(30.0, 0.0));
+
+    const auto profile = ProfileBuilder().build(sketch.geometry());
+    QCOMPARE(profile.loops, std::size_t{4});
+    QCOMPARE(profile.holes, std::size_t{2});
+    QCOMPARE(profile.openChains, std::size_t{0});
+    QCOMPARE(profile.shape.ShapeType(), TopAbs_COMPOUND);
+
+    GProp_GProps props;
+    BRepGProp::SurfaceProperties(sketch.toFace(), props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), 400.0 - 25.0 - 4.0 * M_PI + 2.0, 1e-6);
+}
+
+void CoreTests::sketch_keepsLoopWithStraySegmentAtCorner() {
+    Sketch2D sketch;
+    sketch.addLine(gp_Pnt2d(0.0, 0.0), gp_Pnt2d(20.0, 0.0));
+    sketch.addLine(gp_Pnt2d(20.0, 0.0), gp_Pnt2d(20.0, 20.0));
+    sketch.addLine(gp_Pnt2d(20.0, 20.0), gp_Pnt2d(0.0, 20.0));
+    sketch.addLine(gp_Pnt2d(0.0, 20.0), gp_Pnt2d(0.0, 0.0));
+    // Construction leftover hanging off a corner of the square.
+    sketch.addLine(gp_Pnt2d(30.0, 30.0), gp_Pnt2d(20.0, 20.0));
+
+    const auto profile = ProfileBuilder().build(sketch.geometry());
+    QCOMPARE(profile.loops, std::size_t{1});
+    QCOMPARE(profile.holes, std::size_t{0});
+    QCOMPARE(profile.openChains, std::size_t{1});
+
+    GProp_GProps props;
+    BRepGProp::SurfaceProperties(profile.shape, props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), 400.0, 1e-6);
+}
+
+void CoreTests::designTable_regeneratesVariants() {
+    Sketch2D sketch;
+    sketch.addLine(gp_Pnt2d(0, 0), gp_Pnt2d(20, 0));
+    sketch.addLine(gp_Pnt2d(20, 0), gp_Pnt2d(20, 20));
+    sketch.addLine(gp_Pnt2d(20, 20), gp_Pnt2d(0, 20));
+    sketch.addLine(gp_Pnt2d(0, 20), gp_Pnt2d(0, 0));
+
+    FeatureTree tree;
+    tree.push({FeatureTree::NodeType::Extrude, 10.0, gp_Ax1(), gp_Dir(0, 0, 1), TopoDS_Shape()});
+    tree.push({FeatureTree::NodeType::Fillet, 1.0, gp_Ax1(), gp_Dir(0, 0, 1), TopoDS_Shape()});
+
+    DesignTable table;
+    QVERIFY(table.parse(QStringLiteral("name,feature.0,feature.1\n"
+                                       "small,10,0.5\n"
+                                       "medium,10,1.0\n"
+                                       "large,10,2.0\n")));
+    QCOMPARE(table.variants().size(), std::size_t{3});
+
+    QTemporaryDir dir;
+    QVERIFY2(dir.isValid(), "Temporary directory should be valid");
+    DesignTableRunner runner(sketch, tree);
+    const auto results = runner.run(table, dir.path(), DesignTableRunner::Format::Brep);
+    QCOMPARE(runner.sharedPrefix(), std::size_t{1});
+    QCOMPARE(results.size(), std::size_t{3});
+
+    double previousVolume = 4000.0;
+    for (const auto &result : results) {
+        QVERIFY(result.ok);
+        QVERIFY(QFile::exists(result.path));
+        GProp_GProps props;
+        BRepGProp::VolumeProperties(result.shape, props);
+        QVERIFY(props.Mass() < previousVolume);
+        previousVolume = props.Mass();
+    }
+}
+
+void CoreTests::partRegistry_loadsShapesLazily() {
+    QTemporaryDir dir;
+    QVERIFY2(dir.isValid(), "Temporary directory should be valid");
+    const QString path = tempFile(dir, QStringLiteral("parts.aegisparts"));
+
+    PartRegistry source;
+    source.addPart(QStringLiteral("small"), FeatureOps::makeBox(10.0));
+    source.addPart(QStringLiteral("large"), FeatureOps::makeBox(20.0));
+    QVERIFY(source.save(path));
+
+    PartRegistry registry;
+    QVERIFY(registry.load(path));
+    const auto &parts = registry.parts();
+    QCOMPARE(parts.size(), std::size_t{2});
+    for (const auto &entry : parts) {
+        QVERIFY(!entry.shape.isNull());
+        QVERIFY(!entry.shape.isLoaded());
+    }
+
+    GProp_GProps props;
+    BRepGProp::VolumeProperties(parts[1].shape.get(), props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), 8000.0, 1e-6);
+    QVERIFY(parts[1].shape.isLoaded());
+    QVERIFY(!parts[0].shape.isLoaded());
+
+    // A budget below one part's size drops every decoded shape nobody holds back to its bytes.
+    LazyShape::setResidentBudget(1);
+    QVERIFY(!parts[1].shape.isLoaded());
+    {
+        // A shape still in use keeps its TShape, so caches keyed on its identity stay valid.
+        const TopoDS_Shape held = parts[0].shape.get();
+        QVERIFY(!held.IsNull());
+        LazyShape::setResidentBudget(1);
+        QVERIFY(parts[0].shape.isLoaded());
+        QVERIFY(parts[0].shape.get().IsSame(held));
+    }
+    LazyShape::setResidentBudget(1);
+    QVERIFY(!parts[0].shape.isLoaded());
+    GProp_GProps reloaded;
+    BRepGProp::VolumeProperties(parts[1].shape.get(), reloaded);
+    VERIFY_WITH_TOLERANCE(reloaded.Mass(), 8000.0, 1e-6);
+    LazyShape::setResidentBudget(std::size_t{256} * 1024 * 1024);
+}
+
+void CoreTests::partRegistry_tracksChangesByGeneration() {
+    PartRegistry registry;
+    const TopoDS_Shape box = FeatureOps::makeBox(1.0);
+    std::vector<std::pair<QString, TopoDS_Shape>> batch;
+    for (int i = 0; i < 2000; ++i) {
+        batch.emplace_back(QStringLiteral("part%1").arg(i), box);
+    }
+    const std::vector<QString> ids = registry.addParts(batch);
+    QCOMPARE(ids.size(), std::size_t{2000});
+    QCOMPARE(registry.parts().size(), std::size_t{2000});
+    QCOMPARE(registry.find(ids[1234])->name, QStringLiteral("part1234"));
+    QCOMPARE(registry.changesSince(0).changed.size(), std::size_t{2000});
+
+    const std::uint64_t seen = registry.generation();
+    QVERIFY(!registry.updatePart(QStringLiteral("missing"), box));
+    QVERIFY(!registry.contains(QStringLiteral("missing")));
+    QCOMPARE(registry.parts().size(), std::size_t{2000});
+
+    const TopoDS_Shape bigger = FeatureOps::makeBox(2.0);
+    QCOMPARE(registry.updateParts({{ids[3], bigger}, {ids[7], bigger}, {QStringLiteral("missing"), bigger}}), std::size_t{2});
+    QVERIFY(registry.setMaterial(ids[3], QStringLiteral("Steel"), 7850.0));
+    QVERIFY(registry.removePart(ids[5]));
+    QVERIFY(!registry.removePart(ids[5]));
+    QVERIFY(registry.setVisible(ids[9], false));
+
+    PartRegistry::Changes changes = registry.changesSince(seen);
+    std::sort(changes.changed.begin(), changes.changed.end());
+    std::vector<QString> expected{ids[3], ids[7], ids[9]};
+    std::sort(expected.begin(), expected.end());
+    QCOMPARE(changes.changed, expected);
+    QCOMPARE(changes.removed, std::vector<QString>{ids[5]});
+    QCOMPARE(changes.generation, registry.generation());
+    QVERIFY(registry.changesSince(changes.generation).changed.empty());
+
+    // The swap-removal keeps the index consistent for the part that moved.
+    QVERIFY(!registry.contains(ids[5]));
+    QCOMPARE(registry.find(ids[1999])->name, QStringLiteral("part1999"));
+    QCOMPARE(registry.parts().size(), std::size_t{1999});
+
+    // Many edits to the same part compact the log but still report it once.
+    const std::uint64_t beforeEdits = registry.generation();
+    for (int i = 0; i < 1000; ++i) {
+        registry.setMaterial(ids[11], QStringLiteral("Steel"), 7850.0 + i);
+    }
+    changes = registry.changesSince(beforeEdits);
+    QCOMPARE(changes.changed, std::vector<QString>{ids[11]});
+    QVERIFY(changes.removed.empty());
+    QCOMPARE(registry.changesSince(seen).removed, std::vector<QString>{ids[5]});
+}
+
+void CoreTests::shapeArchive_roundTrip_data() {
+    QTest::addColumn<int>("encoding");
+    QTest::newRow("binary") << static_cast<int>(LazyShape::Encoding::Binary);
+    QTest::newRow("compressed") << static_cast<int>(LazyShape::Encoding::CompressedBinary);
+}
+
+void CoreTests::shapeArchive_roundTrip() {
+    QFETCH(int, encoding);
+    QTemporaryDir dir;
+    QVERIFY2(dir.isValid(), "Temporary directory should be valid");
+    const QString path = tempFile(dir, QStringLiteral("shapes.bin"));
+
+    const TopoDS_Shape box = FeatureOps::makeBox(10.0);
+    const TopoDS_Shape cylinder = FeatureOps::makeCylinder(2.0, 5.0);
+    {
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        ShapeArchiveWriter writer(file, static_cast<LazyShape::Encoding>(encoding));
+        QJsonObject meta;
+        meta["name"] = QStringLiteral("box");
+        QVERIFY(writer.add(box, meta));
+        QVERIFY(writer.add(TopoDS_Shape()));
+        QVERIFY(writer.add(cylinder));
+        QJsonObject header;
+        header["parts"] = 3;
+        QVERIFY(writer.finish(header));
+    }
+
+    ShapeArchiveReader reader;
+    QVERIFY(reader.open(path));
+    QCOMPARE(reader.header().value("parts").toInt(), 3);
+    QCOMPARE(reader.entries().size(), std::size_t{3});
+    QCOMPARE(reader.entries()[0].meta.value("name").toString(), QStringLiteral("box"));
+    QCOMPARE(reader.entries()[1].size, qint64{0});
+    QVERIFY(reader.shape(1).isNull());
+
+    GProp_GProps props;
+    BRepGProp::VolumeProperties(reader.shape(0).get(), props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), 1000.0, 1e-6);
+    BRepGProp::VolumeProperties(reader.shape(2).get(), props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), M_PI * 4.0 * 5.0, 1e-6);
+
+    // Files written before the archive format still load.
+    const QString legacyPath = tempFile(dir, QStringLiteral("legacy.json"));
+    {
+        QJsonObject obj;
+        obj["id"] = QStringLiteral("legacy");
+        obj["name"] = QStringLiteral("box");
+        obj["brep"] = QString::fromLatin1(LazyShape::encode(box, LazyShape::Encoding::AsciiBrep).toBase64());
+        QFile file(legacyPath);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(QJsonDocument(QJsonArray{obj}).toJson());
+    }
+    PartRegistry registry;
+    QVERIFY(registry.load(legacyPath));
+    QCOMPARE(registry.activeId(), QStringLiteral("legacy"));
+    BRepGProp::VolumeProperties(registry.activeShape(), props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), 1000.0, 1e-6);
+}
+
+void CoreTests::projectIO_readsPartsOnDemand() {
+    QTemporaryDir dir;
+    QVERIFY2(dir.isValid(), "Temporary directory should be valid");
+    const QString path = tempFile(dir, QStringLiteral("sample.aegisproj"));
+
+    PartRegistry registry;
+    const QString boxId = registry.addPart(QStringLiteral("box"), FeatureOps::makeBox(10.0));
+    const QString cylinderId = registry.addPart(QStringLiteral("cylinder"), FeatureOps::makeCylinder(2.0, 5.0));
+    registry.setMaterial(boxId, QStringLiteral("Steel"), 7850.0);
+
+    ProjectSnapshot snapshot;
+    snapshot.parts = registry.parts();
+    snapshot.activeId = boxId;
+    snapshot.chatHistory = QStringList{QStringLiteral("hello"), QStringLiteral("world")};
+    ProjectIO io;
+    QVERIFY(io.saveProject(path, snapshot));
+
+    ProjectReader reader;
+    QVERIFY(reader.open(path));
+    QCOMPARE(reader.activeId(), boxId);
+    QCOMPARE(reader.partIds(), (QStringList{boxId, cylinderId}));
+    QCOMPARE(reader.chatHistory(), snapshot.chatHistory);
+    QVERIFY(!reader.assembly());
+    QVERIFY(!reader.part(QStringLiteral("missing")));
+
+    const auto box = reader.part(boxId);
+    QVERIFY(box);
+    QCOMPARE(box->material, QStringLiteral("Steel"));
+    QVERIFY(!box->shape.isNull());
+    QVERIFY(!box->shape.isLoaded());
+    GProp_GProps props;
+    BRepGProp::VolumeProperties(box->shape.get(), props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), 1000.0, 1e-6);
+
+    // Saving over the file copies parts that were never decoded straight from the old mapping.
+    const auto cylinder = reader.part(cylinderId);
+    QVERIFY(cylinder && !cylinder->shape.isLoaded());
+    ProjectSnapshot resaved;
+    resaved.parts = reader.parts();
+    resaved.activeId = cylinderId;
+    resaved.assembly = std::make_shared<AssemblyDocument>();
+    QVERIFY(io.saveProject(path, resaved));
+
+    // Handles from the replaced file, and the reader itself, keep working once it is closed:
+    // moving the new file away leaves nothing at the path to read from.
+    const QString moved = tempFile(dir, QStringLiteral("moved.aegisproj"));
+    QVERIFY(QFile::rename(path, moved));
+    QVERIFY(!cylinder->shape.isLoaded());
+    box->shape.release();
+    QVERIFY(!box->shape.isLoaded());
+    BRepGProp::VolumeProperties(box->shape.get(), props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), 1000.0, 1e-6);
+    BRepGProp::VolumeProperties(cylinder->shape.get(), props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), M_PI * 4.0 * 5.0, 1e-6);
+    const auto reread = reader.part(boxId);
+    QVERIFY(reread);
+    BRepGProp::VolumeProperties(reread->shape.get(), props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), 1000.0, 1e-6);
+    const ProjectSnapshot loaded = io.loadProject(moved);
+    QCOMPARE(loaded.parts.size(), std::size_t{2});
+    QCOMPARE(loaded.activeId, cylinderId);
+    QVERIFY(loaded.assembly);
+    QVERIFY(loaded.chatHistory.isEmpty());
+    BRepGProp::VolumeProperties(loaded.shape, props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), M_PI * 4.0 * 5.0, 1e-6);
+}
+
+void CoreTests::batchImporter_mergesFilesIntoOneDocument() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    StepIgesIO io;
+    const QStringList paths{tempFile(dir, QStringLiteral("a.step")), tempFile(dir, QStringLiteral("b.step")),
+                            tempFile(dir, QStringLiteral("c.igs"))};
+    QVERIFY(io.exportStep(paths[0], FeatureOps::makeBox(10.0)));
+    QVERIFY(io.exportStep(paths[1], FeatureOps::makeBox(20.0)));
+    QVERIFY(io.exportIges(paths[2], FeatureOps::makeCylinder(2.0, 5.0)));
+    const QString missing = tempFile(dir, QStringLiteral("missing.step"));
+
+    BatchImporter importer;
+    std::vector<BatchImporter::Result> results = importer.run(paths + QStringList{missing});
+    QCOMPARE(results.size(), std::size_t{4});
+    std::sort(results.begin(), results.end(), [](const auto &a, const auto &b) { return a.path < b.path; });
+
+    const double expected[] = {1000.0, 8000.0, M_PI * 4.0 * 5.0};
+    int roots = 0;
+    for (int i = 0; i < 3; ++i) {
+        QCOMPARE(results[i].path, paths[i]);
+        QVERIFY(results[i].ok);
+        GProp_GProps props;
+        BRepGProp::VolumeProperties(results[i].shape, props);
+        VERIFY_WITH_TOLERANCE(props.Mass(), expected[i], 1e-3);
+        roots += results[i].roots;
+    }
+    QCOMPARE(results[3].path, missing);
+    QVERIFY(!results[3].ok);
+
+    TDF_LabelSequence freeShapes;
+    XCAFDoc_DocumentTool::ShapeTool(importer.document()->Main())->GetFreeShapes(freeShapes);
+    QCOMPARE(freeShapes.Length(), roots);
+    GProp_GProps merged;
+    BRepGProp::VolumeProperties(StepIgesIO::freeShapes(importer.document()), merged);
+    VERIFY_WITH_TOLERANCE(merged.Mass(), expected[0] + expected[1] + expected[2], 1e-3);
+}
+
+void CoreTests::step_streamsRootsIncrementally() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    // Two separate transfers give the file two top-level products.
+    const QString path = tempFile(dir, QStringLiteral("roots.step"));
+    STEPControl_Writer writer;
+    QCOMPARE(writer.Transfer(FeatureOps::makeBox(10.0), STEPControl_AsIs), IFSelect_RetDone);
+    QCOMPARE(writer.Transfer(FeatureOps::makeCylinder(2.0, 5.0), STEPControl_AsIs), IFSelect_RetDone);
+    QCOMPARE(writer.Write(path.toStdString().c_str()), IFSelect_RetDone);
+
+    StepIgesIO io;
+    AssemblyDocument assembly;
+    std::vector<double> volumes;
+    const int delivered = io.importIncremental(path, [&](const StepIgesIO::ImportedRoot &root) {
+        GProp_GProps props;
+        BRepGProp::VolumeProperties(root.shape, props);
+        volumes.push_back(props.Mass());
+        AssemblyNode node;
+        node.id = QStringLiteral("root%1").arg(root.index);
+        node.parentId = QStringLiteral("root");
+        node.shape = root.shape;
+        return assembly.addNode(node) && root.count == 2;
+    });
+    QCOMPARE(delivered, 2);
+    QCOMPARE(volumes.size(), std::size_t{2});
+    VERIFY_WITH_TOLERANCE(volumes[0], 1000.0, 1e-3);
+    VERIFY_WITH_TOLERANCE(volumes[1], M_PI * 4.0 * 5.0, 1e-3);
+    QCOMPARE(assembly.nodes().size(), std::size_t{3});
+
+    // Returning false stops after the current root.
+    QCOMPARE(io.importIncremental(path, [](const StepIgesIO::ImportedRoot &) { return false; }), 1);
+
+    QFuture<StepIgesIO::ImportedRoot> future = io.importStreaming(path);
+    future.waitForFinished();
+    QCOMPARE(future.resultCount(), 2);
+    QVERIFY(!future.resultAt(0).shape.IsNull());
+    QCOMPARE(future.resultAt(1).count, 2);
+}
+
+void CoreTests::step_streamsAssemblyComponents() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    // One top-level assembly with two different parts, the second one moved.
+    const QString path = tempFile(dir, QStringLiteral("frame.step"));
+    {
+        XcafDocumentPool::Lease lease = XcafDocumentPool::instance().acquire();
+        Handle(XCAFDoc_ShapeTool) tool = lease.shapeTool();
+        const TDF_Label block = tool->AddShape(FeatureOps::makeBox(10.0), Standard_False);
+        TDataStd_Name::Set(block, "block");
+        const TDF_Label pin = tool->AddShape(FeatureOps::makeCylinder(2.0, 5.0), Standard_False);
+        TDataStd_Name::Set(pin, "pin");
+        const TDF_Label top = tool->NewShape();
+        TDataStd_Name::Set(top, "frame");
+        gp_Trsf shift;
+        shift.SetTranslation(gp_Vec(50.0, 0.0, 0.0));
+        tool->AddComponent(top, block, TopLoc_Location());
+        tool->AddComponent(top, pin, TopLoc_Location(shift));
+        tool->UpdateAssemblies();
+        STEPCAFControl_Writer writer;
+        writer.SetNameMode(true);
+        QVERIFY(writer.Transfer(lease.document(), STEPControl_AsIs));
+        QCOMPARE(writer.Write(path.toStdString().c_str()), IFSelect_RetDone);
+    }
+
+    // The assembly is split into its components, each delivered already placed.
+    StepIgesIO io;
+    std::vector<StepIgesIO::ImportedRoot> roots;
+    const int delivered = io.importIncremental(path, [&roots](const StepIgesIO::ImportedRoot &root) {
+        roots.push_back(root);
+        return true;
+    });
+    QCOMPARE(delivered, 2);
+    QCOMPARE(roots.size(), std::size_t{2});
+    std::sort(roots.begin(), roots.end(), [](const auto &a, const auto &b) { return a.name < b.name; });
+    QCOMPARE(roots[0].name, QStringLiteral("block"));
+    QCOMPARE(roots[1].name, QStringLiteral("pin"));
+    QCOMPARE(roots[1].count, 2);
+
+    GProp_GProps props;
+    BRepGProp::VolumeProperties(roots[0].shape, props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), 1000.0, 1e-3);
+    BRepGProp::VolumeProperties(roots[1].shape, props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), M_PI * 4.0 * 5.0, 1e-3);
+    Bnd_Box pinBox;
+    BRepBndLib::Add(roots[1].shape, pinBox, false);
+    VERIFY_WITH_TOLERANCE(0.5 * (pinBox.CornerMin().X() + pinBox.CornerMax().X()), 50.0, 1e-3);
+
+    QFuture<StepIgesIO::ImportedRoot> future = io.importStreaming(path);
+    future.waitForFinished();
+    QCOMPARE(future.resultCount(), 2);
+    QVERIFY(!future.resultAt(0).shape.IsNull());
+    QVERIFY(!future.resultAt(1).shape.IsNull());
+}
+
+void CoreTests::step_importsAssemblyStructure() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    // An assembly with two placed instances of one named bolt.
+    const QString path = tempFile(dir, QStringLiteral("fasteners.step"));
+    {
+        XcafDocumentPool::Lease lease = XcafDocumentPool::instance().acquire();
+        Handle(TDocStd_Document) doc = lease.document();
+        Handle(XCAFDoc_ShapeTool) tool = lease.shapeTool();
+        const TDF_Label bolt = tool->AddShape(FeatureOps::makeCylinder(2.0, 5.0), Standard_False);
+        TDataStd_Name::Set(bolt, "bolt");
+        const TDF_Label top = tool->NewShape();
+        TDataStd_Name::Set(top, "plate");
+        gp_Trsf shift;
+        shift.SetTranslation(gp_Vec(50.0, 0.0, 0.0));
+        tool->AddComponent(top, bolt, TopLoc_Location());
+        tool->AddComponent(top, bolt, TopLoc_Location(shift));
+        tool->UpdateAssemblies();
+        STEPCAFControl_Writer writer;
+        writer.SetNameMode(true);
+        QVERIFY(writer.Transfer(doc, STEPControl_AsIs));
+        QCOMPARE(writer.Write(path.toStdString().c_str()), IFSelect_RetDone);
+    }
+
+    AssemblyDocument assembly;
+    StepIgesIO io;
+    const QStringList ids = io.importAssembly(path, assembly);
+    QCOMPARE(ids.size(), 1);
+    const AssemblyNode *top = assembly.getNode(ids.first());
+    QVERIFY(top);
+    QCOMPARE(top->name, QStringLiteral("plate"));
+    QVERIFY(top->shape.IsNull());
+    QCOMPARE(top->children.size(), std::size_t{2});
+
+    const AssemblyNode *first = assembly.getNode(top->children[0]);
+    const AssemblyNode *second = assembly.getNode(top->children[1]);
+    QVERIFY(first && second);
+    QVERIFY(!first->shape.IsNull());
+    QVERIFY(first->shape.TShape() == second->shape.TShape());
+    const double offset = std::abs(first->localTransform.TranslationPart().X() - second->localTransform.TranslationPart().X());
+    VERIFY_WITH_TOLERANCE(offset, 50.0, 1e-6);
+
+    const auto frames = assembly.computeWorldFrames();
+    QVERIFY(frames.count(first->id) && frames.count(second->id));
+    QVERIFY(io.importAssembly(path, assembly).first() != ids.first());
+    QVERIFY(io.importAssembly(path, assembly, QStringLiteral("missing")).isEmpty());
+}
+
+void CoreTests::shapeHealing_healsDistinctPiecesOnce() {
+    // Two fused boxes leave coplanar split faces; the plain box appears as two instances.
+    gp_Trsf shift;
+    shift.SetTranslation(gp_Vec(10.0, 0.0, 0.0));
+    const TopoDS_Shape box = FeatureOps::makeBox(10.0);
+    const TopoDS_Shape fused = FeatureOps::fuseMany({box, box.Moved(TopLoc_Location(shift))});
+    gp_Trsf far;
+    far.SetTranslation(gp_Vec(100.0, 0.0, 0.0));
+    const TopoDS_Shape bolt = FeatureOps::makeBox(10.0);
+
+    BRep_Builder builder;
+    TopoDS_Compound input;
+    builder.MakeCompound(input);
+    builder.Add(input, fused);
+    builder.Add(input, bolt);
+    builder.Add(input, bolt.Moved(TopLoc_Location(far)));
+
+    ShapeHealing::Report report;
+    report.source = QStringLiteral("supplier.step");
+    const TopoDS_Shape healed = ShapeHealing().heal(input, &report);
+    QVERIFY(!healed.IsNull());
+    QVERIFY(BRepCheck_Analyzer(healed).IsValid());
+    QCOMPARE(report.source, QStringLiteral("supplier.step"));
+    QCOMPARE(report.pieces, 2);
+    QCOMPARE(report.rejected, 0);
+    QVERIFY(report.facesAfter <= report.facesBefore);
+    QCOMPARE(report.facesAfter, 12);
+    QVERIFY(report.maxToleranceAfter <= ShapeHealing().options().maxTolerance);
+    QVERIFY(report.toJson().value("pieces").toInt() == 2);
+
+    GProp_GProps props;
+    BRepGProp::VolumeProperties(healed, props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), 4000.0, 1e-3);
+}
+
+void CoreTests::shapeHealing_leavesSharedInputUntouched() {
+    // Two faces of one box are separate pieces that share an edge and its vertices.
+    const TopoDS_Shape box = FeatureOps::makeBox(10.0);
+    TopTools_IndexedDataMapOfShapeListOfShape edgeFaces;
+    TopExp::MapShapesAndAncestors(box, TopAbs_EDGE, TopAbs_FACE, edgeFaces);
+    const TopoDS_Edge shared = TopoDS::Edge(edgeFaces.FindKey(1));
+    const TopTools_ListOfShape &faces = edgeFaces.FindFromIndex(1);
+    QCOMPARE(faces.Extent(), 2);
+    const TopoDS_Vertex corner = TopExp::FirstVertex(shared);
+    BRep_Builder builder;
+    builder.UpdateVertex(corner, 0.5);
+
+    TopoDS_Compound input;
+    builder.MakeCompound(input);
+    builder.Add(input, faces.First());
+    builder.Add(input, faces.Last());
+
+    ShapeHealing::Report report;
+    const TopoDS_Shape healed = ShapeHealing().heal(input, &report);
+    QVERIFY(!healed.IsNull());
+    QCOMPARE(report.pieces, 2);
+    QVERIFY(report.maxToleranceAfter <= ShapeHealing().options().maxTolerance);
+    // The caps were applied to copies; the caller's shared vertex keeps its tolerance.
+    VERIFY_WITH_TOLERANCE(BRep_Tool::Tolerance(corner), 0.5, 1e-12);
+}
+
+void CoreTests::shapeHealing_returnsRepairedPiece() {
+    // An inside-out solid: ShapeFix turns the shell around without changing any count or
+    // tolerance, and the repaired piece must be the one returned.
+    const TopoDS_Shape box = FeatureOps::makeBox(10.0);
+    TopExp_Explorer shells(box, TopAbs_SHELL);
+    QVERIFY(shells.More());
+    BRep_Builder builder;
+    TopoDS_Solid inverted;
+    builder.MakeSolid(inverted);
+    builder.Add(inverted, shells.Current().Reversed());
+    GProp_GProps props;
+    BRepGProp::VolumeProperties(inverted, props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), -1000.0, 1e-3);
+
+    ShapeHealing::Report report;
+    const TopoDS_Shape healed = ShapeHealing().heal(inverted, &report);
+    QCOMPARE(report.rejected, 0);
+    QCOMPARE(report.healed, 1);
+    QCOMPARE(report.facesAfter, 6);
+    QVERIFY(BRepCheck_Analyzer(healed).IsValid());
+    BRepGProp::VolumeProperties(healed, props);
+    VERIFY_WITH_TOLERANCE(props.Mass(), 1000.0, 1e-3);
+}
+
+void CoreTests::xcafDocumentPool_reusesDocuments() {
+    XcafDocumentPool pool(1);
+    Handle(TDocStd_Document) first;
+    {
+        XcafDocumentPool::Lease lease = pool.acquire();
+        QVERIFY(lease);
+        first = lease.document();
+        lease.shapeTool()->AddShape(FeatureOps::makeBox(10.0));
+        QCOMPARE(pool.leasedCount(), std::size_t{1});
+    }
+    QCOMPARE(pool.leasedCount(), std::size_t{0});
+    QCOMPARE(pool.idleCount(), std::size_t{1});
+
+    XcafDocumentPool::Lease again = pool.acquire();
+    QVERIFY(again.document() == first);
+    TDF_LabelSequence shapes;
+    again.shapeTool()->GetShapes(shapes);
+    QVERIFY(shapes.IsEmpty());
+    {
+        // Over capacity: the second document is closed instead of kept.
+        XcafDocumentPool::Lease extra = pool.acquire();
+        QVERIFY(extra.document() != first);
+    }
+    QCOMPARE(pool.idleCount(), std::size_t{1});
+    again.release();
+    QCOMPARE(pool.idleCount(), std::size_t{1});
+    pool.clear();
+    QCOMPARE(pool.idleCount(), std::size_t{0});
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    std::vector<std::pair<QString, TopoDS_Shape>> files;
+    for (int i = 1; i <= 3; ++i) {
+        files.emplace_back(tempFile(dir, QStringLiteral("part%1.step").arg(i)), FeatureOps::makeBox(i * 10.0));
+    }
+    files.emplace_back(tempFile(dir, QStringLiteral("empty.step")), TopoDS_Shape());
+    StepIgesIO io;
+    QCOMPARE(io.exportStepBatch(files), 3);
+    for (int i = 0; i < 3; ++i) {
+        // Each file holds only its own shape, not the ones written before it.
+        GProp_GProps props;
+        BRepGProp::VolumeProperties(io.importFile(files[i].first), props);
+        VERIFY_WITH_TOLERANCE(props.Mass(), std::pow((i + 1) * 10.0, 3), 1e-3);
+    }
+    QVERIFY(!QFile::exists(files[3].first));
+}
+
+void CoreTests::xcafDocumentPool_retiresGrownDocuments() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString input = tempFile(dir, QStringLiteral("input.step"));
+    STEPControl_Writer stepWriter;
+    stepWriter.Transfer(FeatureOps::makeBox(10.0), STEPControl_AsIs);
+    QCOMPARE(stepWriter.Write(input.toStdString().c_str()), IFSelect_RetDone);
+    const QString output = tempFile(dir, QStringLiteral("output.step"));
+
+    // One import/export job through a leased document; returns the labels left after it.
+    auto cycle = [&](XcafDocumentPool &pool, Handle(TDocStd_Document) &used) {
+        XcafDocumentPool::Lease lease = pool.acquire();
+        used = lease.document();
+        STEPCAFControl_Reader reader;
+        reader.SetGDTMode(true);
+        if (reader.ReadFile(input.toStdString().c_str()) != IFSelect_RetDone || !reader.Transfer(lease.document())) {
+            return std::size_t{0};
+        }
+        STEPCAFControl_Writer writer;
+        writer.Transfer(lease.document(), STEPControl_AsIs);
+        writer.Write(output.toStdString().c_str());
+        return XcafDocumentPool::labelCount(lease.document());
+    };
+
+    // Emptying leaves label nodes behind, so a reused document keeps growing...
+    XcafDocumentPool pool(1);
+    pool.setRetirement(1000, 1000000);
+    Handle(TDocStd_Document) first;
+    Handle(TDocStd_Document) used;
+    const std::size_t once = cycle(pool, first);
+    QVERIFY(once > 0);
+    const std::size_t twice = cycle(pool, used);
+    QVERIFY(used == first);
+    QVERIFY(twice > once);
+
+    // ...until it is retired by its label count...
+    pool.setRetirement(1000, twice + (twice - once) / 2);
+    std::size_t most = 0;
+    int documents = 1;
+    Handle(TDocStd_Document) previous = first;
+    for (int i = 0; i < 20; ++i) {
+        most = std::max(most, cycle(pool, used));
+        documents += used == previous ? 0 : 1;
+        previous = used;
+    }
+    QVERIFY(documents > 1);
+    QVERIFY(most <= twice + 2 * (twice - once));
+
+    // ...or by its number of uses.
+    pool.clear();
+    pool.setRetirement(3, 1000000);
+    std::vector<Handle(TDocStd_Document)> sequence;
+    for (int i = 0; i < 6; ++i) {
+        cycle(pool, used);
+        sequence.push_back(used);
+    }
+    QVERIFY(sequence[0] == sequence[2]);
+    QVERIFY(sequence[3] != sequence[2]);
+    QVERIFY(sequence[3] == sequence[5]);
+    QCOMPARE(pool.leasedCount(), std::size_t{0});
+}
+
+void CoreTests::step_exportsAssemblyWithSharedParts() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    PartRegistry registry;
+    const QString boltId = registry.addPart(QStringLiteral("bolt"), FeatureOps::makeCylinder(2.0, 5.0));
+    const QString plateId = registry.addPart(QStringLiteral("plate"), FeatureOps::makeBox(10.0));
+    registry.setMaterial(boltId, QStringLiteral("Steel"), 7850.0);
+
+    // A plate holding four bolts: the bolts reference the registry part through partPath.
+    AssemblyDocument assembly;
+    AssemblyNode plate;
+    plate.id = plateId;
+    plate.parentId = QStringLiteral("root");
+    plate.name = QStringLiteral("plate");
+    QVERIFY(assembly.addNode(plate));
+    for (int i = 0; i < 4; ++i) {
+        AssemblyNode bolt;
+        bolt.id = QStringLiteral("bolt%1").arg(i);
+        bolt.parentId = plateId;
+        bolt.partPath = boltId;
+        bolt.localTransform.SetTranslation(gp_Vec(2.5 + 5.0 * (i % 2), 2.5 + 5.0 * (i / 2), 10.0));
+        QVERIFY(assembly.addNode(bolt));
+    }
+
+    StepIgesIO io;
+    const QString path = tempFile(dir, QStringLiteral("fixture.step"));
+    QStringList partFiles;
+    QVERIFY(io.exportAssembly(path, assembly, &registry, StepIgesIO::AssemblyExportMode::Split, &partFiles));
+    QCOMPARE(partFiles.size(), 2);
+    for (const QString &file : partFiles) {
+        QVERIFY(!io.importFile(file).IsNull());
+    }
+
+    // Reading it back gives four bolt instances sharing one geometry.
+    AssemblyDocument imported;
+    const QStringList ids = io.importAssembly(path, imported);
+    QCOMPARE(ids.size(), 1);
+    std::vector<TopoDS_Shape> bolts;
+    for (const auto &kv : imported.nodes()) {
+        if (kv.second.name.startsWith(QStringLiteral("bolt"))) {
+            bolts.push_back(kv.second.shape);
+        }
+    }
+    QCOMPARE(bolts.size(), std::size_t{4});
+    for (const auto &bolt : bolts) {
+        QVERIFY(!bolt.IsNull());
+        QVERIFY(bolt.TShape() == bolts.front().TShape());
+    }
+
+    XcafDocumentPool::Lease lease = XcafDocumentPool::instance().acquire();
+    QVERIFY(io.readInto(path, lease.document()));
+    Handle(XCAFDoc_MaterialTool) materials = XCAFDoc_DocumentTool::MaterialTool(lease.document()->Main());
+    TDF_LabelSequence materialLabels;
+    materials->GetMaterialLabels(materialLabels);
+    QStringList materialNames;
+    for (Standard_Integer i = 1; i <= materialLabels.Length(); ++i) {
+        Handle(TCollection_HAsciiString) name, description, densityName, densityType;
+        double density = 0.0;
+        if (XCAFDoc_MaterialTool::GetMaterial(materialLabels.Value(i), name, description, density, densityName, densityType)) {
+            materialNames.push_back(QString::fromUtf8(name->ToCString()));
+        }
+    }
+    QVERIFY(materialNames.contains(QStringLiteral("Steel")));
+}
+
+void CoreTests::tessellationService_reusesDiskCache() {
+    auto &service = TessellationService::instance();
+    service.clear();
+    service.resetStats();
+
+    auto triangles = [](const TopoDS_Shape &shape) {
+        std::vector<int> counts;
+        for (TopExp_Explorer it(shape, TopAbs_FACE); it.More(); it.Next()) {
+            TopLoc_Location location;
+            const Handle(Poly_Triangulation) mesh = BRep_Tool::Triangulation(TopoDS::Face(it.Current()), location);
+            counts.push_back(mesh.IsNull() ? 0 : mesh->NbTriangles());
+        }
+        return counts;
+    };
+
+    // The mesh goes onto a copy; the shape passed in stays unmeshed.
+    const TessellationService::Parameters parameters{0.05, 0.3, false};
+    const TopoDS_Shape shape = BRepPrimAPI_MakeCylinder(15.0, 40.0).Shape();
+    const TopoDS_Shape first = service.tessellate(shape, parameters);
+    QVERIFY(!first.IsNull());
+    QVERIFY(BRepTools::Triangulation(first, parameters.linearDeflection));
+    QVERIFY(!BRepTools::Triangulation(shape, 1e6));
+    const std::vector<int> meshed = triangles(first);
+    QCOMPARE(service.stats().meshed, std::size_t{1});
+    QCOMPARE(QDir(service.cachePath()).entryList({QStringLiteral("*.tri")}, QDir::Files).size(), 1);
+
+    // An identical rebuild is served from disk.
+    const TopoDS_Shape rebuilt = BRepPrimAPI_MakeCylinder(15.0, 40.0).Shape();
+    const TopoDS_Shape fromDisk = service.tessellate(rebuilt, parameters);
+    QCOMPARE(service.stats().diskHits, std::size_t{1});
+    QCOMPARE(service.stats().meshed, std::size_t{1});
+    QVERIFY(triangles(fromDisk) == meshed);
+    QVERIFY(BRepTools::Triangulation(fromDisk, parameters.linearDeflection));
+
+    // Other parameters are a different entry, and a finer mesh on the input is not kept.
+    const TopoDS_Shape coarse = service.tessellate(fromDisk, {0.5, 0.3, false});
+    QCOMPARE(service.stats().meshed, std::size_t{2});
+    QVERIFY(triangles(coarse) != meshed);
+
+    // Located repeats share one meshed copy and keep their own placement.
+    gp_Trsf shift;
+    shift.SetTranslation(gp_Vec(100.0, 0.0, 0.0));
+    const TopoDS_Shape moved = rebuilt.Moved(TopLoc_Location(shift));
+    const std::vector<TopoDS_Shape> all =
+        service.tessellateAll({rebuilt, moved, TopoDS_Shape(), FeatureOps::makeBox(5.0)}, parameters);
+    QCOMPARE(all.size(), std::size_t{4});
+    QVERIFY(all[0].TShape() == all[1].TShape());
+    QVERIFY(all[1].Location() == moved.Location());
+    QVERIFY(all[2].IsNull());
+    QVERIFY(BRepTools::Triangulation(all[3], parameters.linearDeflection));
+    QCOMPARE(service.stats().diskHits, std::size_t{2});
+    QCOMPARE(service.stats().meshed, std::size_t{3});
+
+    service.clear();
+    QVERIFY(QDir(service.cachePath()).entryList({QStringLiteral("*.tri")}, QDir::Files).isEmpty());
+}
+
+void CoreTests::tessellationService_evictsAndPurges() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    auto &service = TessellationService::instance();
+    const qint64 previousCapacity = service.capacity();
+
+    // Subdirectories left by another format or build are removed on first use.
+    const QString stale = dir.filePath(QStringLiteral("v1-0123456789abcdef"));
+    QVERIFY(QDir().mkpath(stale));
+    service.setCacheDirectory(dir.path());
+    service.resetStats();
+    const TessellationService::Parameters parameters{0.1, 0.5, false};
+    QVERIFY(!service.tessellate(FeatureOps::makeBox(10.0), parameters).IsNull());
+    QVERIFY(!QDir(stale).exists());
+    QVERIFY(service.cachePath().startsWith(dir.path()));
+
+    // Once over capacity, the least recently used file goes first.
+    QVERIFY(!service.tessellate(FeatureOps::makeCylinder(3.0, 8.0), parameters).IsNull());
+    QDir cache(service.cachePath());
+    const QFileInfoList files = cache.entryInfoList({QStringLiteral("*.tri")}, QDir::Files);
+    QCOMPARE(files.size(), 2);
+    {
+        QFile old(files.first().filePath());
+        QVERIFY(old.open(QIODevice::ReadOnly));
+        QVERIFY(old.setFileTime(QDateTime::currentDateTimeUtc().addDays(-1), QFileDevice::FileModificationTime));
+    }
+    service.setCapacity(std::max(files[0].size(), files[1].size()) + 1);
+    QCOMPARE(service.stats().evicted, std::size_t{1});
+    const QStringList left = cache.entryList({QStringLiteral("*.tri")}, QDir::Files);
+    QCOMPARE(left, QStringList{files[1].fileName()});
+
+    service.setCapacity(previousCapacity);
+    service.setCacheDirectory(m_tessellationCache.path());
+}
+
 void ScriptingTests::bindings_are_registered() {
     ScriptRunner runner;
     const QString result = runner.runSnippet(R"(import aegiscad